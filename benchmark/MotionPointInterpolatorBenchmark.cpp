@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Motion Point Interpolator Benchmark
+//
+// Times the work MotionPointInterpolator does for each plan and each
+// control tick: checking a received plan and handing it to the control
+// thread (processMotionPointArray), appending it to the queue
+// (appendMotionPointQueue), trimming the queue (trimMotionPointQueue),
+// and everything getTargetMotionPoint does in a tick, including appending
+// the plans received since the last tick.
+//
+// Plans are sent at a fixed rate, each holding the given number of 1 kHz
+// targets starting when it is sent, and control ticks fall halfway through
+// each control period. Every plan length is run at every plan rate and
+// control rate for the given number of simulated seconds. Times are per
+// call, less the cost of reading the clock.
+//
+// Usage: motion_point_interpolator_benchmark [simulated_seconds]
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "iarc7_motion/MotionPointInterpolator.hpp"
+
+namespace Iarc7Motion
+{
+
+// Friend of MotionPointInterpolator giving the benchmark its private
+// functions
+struct MotionPointInterpolatorBenchmark
+{
+    typedef MotionPointInterpolator Planner;
+
+    // Everything the control thread keeps between ticks
+    struct Targets
+    {
+        explicit Targets(size_t capacity)
+            : motion_points(capacity)
+        {
+        }
+
+        PlanHandoff pending_plans;
+        MotionPointQueue motion_points;
+        PolynomialTargets polynomial_targets;
+        PlanSplice plan_splice;
+        TargetCursor cursor;
+    };
+
+    static bool handOff(PlanHandoff& pending_plans,
+                        const MotionPointQueue::PlanConstPtr& plan,
+                        const ros::Time& time)
+    {
+        return Planner::handOffMotionPointArray(pending_plans, plan, time);
+    }
+
+    static bool append(MotionPointQueue& motion_points,
+                       const PendingPlan& pending_plan)
+    {
+        return Planner::appendMotionPointQueue(motion_points,
+                                               pending_plan.plan,
+                                               pending_plan.time);
+    }
+
+    static bool trim(MotionPointQueue& motion_points, const ros::Time& time)
+    {
+        return Planner::trimMotionPointQueue(motion_points, time);
+    }
+
+    // Same steps as getTargetMotionPoint
+    static bool targetMotionPoint(Targets& targets,
+                                  const VelocityProfileGenerator& generator,
+                                  const ros::Time& time,
+                                  MotionPointStamped& target_motion_point)
+    {
+        const bool applied = Planner::applyPendingPlans(targets.pending_plans,
+                                                        time,
+                                                        targets.motion_points,
+                                                        targets.polynomial_targets,
+                                                        targets.plan_splice,
+                                                        generator,
+                                                        InterpolationMode::LINEAR);
+
+        TrajectorySample target;
+        if (!Planner::sampleTargets(targets.motion_points,
+                                    targets.polynomial_targets,
+                                    targets.plan_splice,
+                                    time,
+                                    InterpolationMode::LINEAR,
+                                    targets.cursor,
+                                    target)) {
+            return false;
+        }
+
+        targets.plan_splice.last_target_ns = time.toNSec();
+        target.toMessage(target_motion_point);
+        return applied;
+    }
+
+    static size_t queueCapacity(double duration, double timestep)
+    {
+        return Planner::queueCapacity(duration, timestep);
+    }
+};
+
+} // End namespace Iarc7Motion
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+typedef MotionPointInterpolatorBenchmark Benchmark;
+
+const double kTimestep = 0.001;
+
+// Plan of num_points targets kTimestep apart starting at start, moving
+// along x at 1 m/s
+MotionPointQueue::PlanConstPtr makePlan(const ros::Time& start, int num_points)
+{
+    iarc7_msgs::MotionPointStampedArray::Ptr plan(
+            new iarc7_msgs::MotionPointStampedArray());
+    plan->motion_points.resize(num_points);
+    for (int i = 0; i < num_points; i++) {
+        MotionPointStamped& motion_point = plan->motion_points[i];
+        motion_point.header.frame_id = "map";
+        motion_point.header.stamp = start + ros::Duration(i * kTimestep);
+        motion_point.motion_point.pose.position.x = motion_point.header.stamp.toSec();
+        motion_point.motion_point.pose.position.z = 1.0;
+        motion_point.motion_point.twist.linear.x = 1.0;
+    }
+    return plan;
+}
+
+double nanoseconds(Clock::time_point begin, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+// Average cost of reading the clock, taken off every time
+double clockOverhead()
+{
+    const int reads = 100000;
+    double total = 0.0;
+    for (int i = 0; i < reads; i++) {
+        Clock::time_point begin = Clock::now();
+        total += nanoseconds(begin, Clock::now());
+    }
+    return total / reads;
+}
+
+// Average nanoseconds per call of each operation
+struct Result
+{
+    double hand_off_ns = 0.0;
+    double append_ns = 0.0;
+    double trim_ns = 0.0;
+    double tick_ns = 0.0;
+    bool ok = true;
+};
+
+Result run(int plan_points, double plan_rate, double control_rate, double duration)
+{
+    const double overhead = clockOverhead();
+    const ros::Time start(1000.0);
+    const ros::Duration plan_period(1.0 / plan_rate);
+    const ros::Duration control_period(1.0 / control_rate);
+    // Room for a whole plan plus the targets a control period behind it
+    const size_t capacity = Benchmark::queueCapacity(
+            plan_points * kTimestep + control_period.toSec(),
+            kTimestep);
+    const VelocityProfileGenerator generator((VelocityProfileSettings()));
+    const int ticks = static_cast<int>(duration * control_rate);
+
+    Result result;
+    int plans = 0;
+
+    // Each operation on its own
+    {
+        Benchmark::Targets targets(capacity);
+        result.ok = targets.motion_points.push_back(makePlan(start, 1), 0, 1)
+                 && result.ok;
+
+        ros::Time next_plan = start;
+        for (int tick = 0; tick < ticks; tick++) {
+            const ros::Time time = start + control_period * (tick + 0.5);
+            while (next_plan <= time) {
+                const MotionPointQueue::PlanConstPtr plan = makePlan(next_plan, plan_points);
+
+                Clock::time_point begin = Clock::now();
+                result.ok = Benchmark::handOff(targets.pending_plans, plan, next_plan)
+                         && result.ok;
+                Clock::time_point end = Clock::now();
+                result.hand_off_ns += nanoseconds(begin, end) - overhead;
+
+                PendingPlan pending_plan;
+                result.ok = targets.pending_plans.pop(pending_plan) && result.ok;
+                begin = Clock::now();
+                result.ok = Benchmark::append(targets.motion_points, pending_plan)
+                         && result.ok;
+                end = Clock::now();
+                result.append_ns += nanoseconds(begin, end) - overhead;
+
+                plans++;
+                next_plan += plan_period;
+            }
+
+            Clock::time_point begin = Clock::now();
+            result.ok = Benchmark::trim(targets.motion_points, time) && result.ok;
+            Clock::time_point end = Clock::now();
+            result.trim_ns += nanoseconds(begin, end) - overhead;
+        }
+    }
+
+    // Whole ticks, plans are handed off between them
+    {
+        Benchmark::Targets targets(capacity);
+        result.ok = targets.motion_points.push_back(makePlan(start, 1), 0, 1)
+                 && result.ok;
+
+        ros::Time next_plan = start;
+        for (int tick = 0; tick < ticks; tick++) {
+            const ros::Time time = start + control_period * (tick + 0.5);
+            while (next_plan <= time) {
+                result.ok = Benchmark::handOff(targets.pending_plans,
+                                               makePlan(next_plan, plan_points),
+                                               next_plan)
+                         && result.ok;
+                next_plan += plan_period;
+            }
+
+            MotionPointStamped target;
+            Clock::time_point begin = Clock::now();
+            result.ok = Benchmark::targetMotionPoint(targets, generator, time, target)
+                     && result.ok;
+            Clock::time_point end = Clock::now();
+            result.tick_ns += nanoseconds(begin, end) - overhead;
+        }
+    }
+
+    result.hand_off_ns /= plans;
+    result.append_ns /= plans;
+    result.trim_ns /= ticks;
+    result.tick_ns /= ticks;
+    return result;
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    const double duration = argc > 1 ? std::atof(argv[1]) : 5.0;
+    if (!(duration >= 0.1)) {
+        std::fprintf(stderr, "Usage: %s [simulated_seconds]\n", argv[0]);
+        return 2;
+    }
+
+    ros::Time::init();
+
+    const int plan_lengths[] = {10, 100, 1000, 10000};
+    const double plan_rates[] = {10.0, 50.0};
+    const double control_rates[] = {60.0, 1000.0};
+
+    std::printf("%.1f s simulated per run, 1 kHz targets, ns per call\n", duration);
+    std::printf("%7s %9s %12s %10s %10s %10s %10s\n",
+                "points", "plan_hz", "control_hz",
+                "hand_off", "append", "trim", "tick");
+
+    bool ok = true;
+    for (int plan_points : plan_lengths) {
+        for (double plan_rate : plan_rates) {
+            for (double control_rate : control_rates) {
+                const Result result = run(plan_points, plan_rate, control_rate, duration);
+                ok = ok && result.ok;
+                std::printf("%7d %9.0f %12.0f %10.1f %10.1f %10.1f %10.1f%s\n",
+                            plan_points,
+                            plan_rate,
+                            control_rate,
+                            result.hand_off_ns,
+                            result.append_ns,
+                            result.trim_ns,
+                            result.tick_ns,
+                            result.ok ? "" : "  (failed)");
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
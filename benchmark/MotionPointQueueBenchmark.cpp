@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Motion Point Queue Benchmark
+//
+// Times the motion point queue operations MotionPointInterpolator does each
+// control tick, trimming targets older than the current time and appending
+// new plans over the end of the queue, three ways: copying targets into a
+// std::vector, copying them as TrajectorySamples into a RingBuffer, and
+// queueing the plan messages by reference in a MotionPointQueue the way
+// the interpolator does now.
+//
+// The queue holds the given number of seconds of 1 kHz targets. Every tick
+// advances the time by 1 ms and every 40 ticks a new plan of the full
+// duration replaces the queued targets after its first point.
+//
+// Usage: motion_point_queue_benchmark [duration_seconds]
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#include "iarc7_motion/MotionPointInterpolator.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+const double kTimestep = 0.001;
+const int kTicksPerPlan = 40;
+
+bool stampLess(const MotionPointStamped& motion_point, const ros::Time& time)
+{
+    return motion_point.header.stamp < time;
+}
+
+// Trim and append as MotionPointInterpolator did on a std::vector
+void vectorTrim(MotionPointStampedArray& queue, const ros::Time& time)
+{
+    auto it = std::lower_bound(queue.begin(), queue.end(), time, stampLess);
+    if (it != queue.begin()) {
+        queue.erase(queue.begin(), std::prev(it, 1));
+    }
+}
+
+void vectorAppend(MotionPointStampedArray& queue,
+                  const MotionPointQueue::PlanConstPtr& plan)
+{
+    auto it = std::lower_bound(queue.begin(),
+                               queue.end(),
+                               plan->motion_points.front().header.stamp,
+                               stampLess);
+    queue.erase(it, queue.end());
+    std::for_each(plan->motion_points.begin(),
+                  plan->motion_points.end(),
+                  [&](auto i){ queue.emplace_back(i); });
+}
+
+bool sampleLess(const TrajectorySample& sample, int64_t time_ns)
+{
+    return sample.stamp_ns < time_ns;
+}
+
+// Trim and append on a RingBuffer, converting targets to samples as they
+// are queued
+void ringTrim(RingBuffer<TrajectorySample>& queue, const ros::Time& time)
+{
+    size_t index = queue.lowerBound(static_cast<int64_t>(time.toNSec()), sampleLess);
+    if (index != 0) {
+        queue.pop_front(index - 1);
+    }
+}
+
+bool ringAppend(RingBuffer<TrajectorySample>& queue,
+                const MotionPointQueue::PlanConstPtr& plan)
+{
+    queue.truncate(queue.lowerBound(
+            static_cast<int64_t>(plan->motion_points.front().header.stamp.toNSec()),
+            sampleLess));
+    for (const MotionPointStamped& motion_point : plan->motion_points) {
+        if (!queue.push_back(TrajectorySample::fromMessage(motion_point))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Trim and append as MotionPointInterpolator does on a MotionPointQueue
+void planTrim(MotionPointQueue& queue, const ros::Time& time)
+{
+    size_t index = queue.lowerBound(time);
+    if (index != 0) {
+        queue.pop_front(index - 1);
+    }
+}
+
+bool planAppend(MotionPointQueue& queue,
+                const MotionPointQueue::PlanConstPtr& plan)
+{
+    queue.truncate(queue.lowerBound(plan->motion_points.front().header.stamp));
+    return queue.push_back(plan, 0, plan->motion_points.size());
+}
+
+// Plan of num_points targets kTimestep apart starting at start
+MotionPointQueue::PlanConstPtr makePlan(const ros::Time& start, int num_points)
+{
+    iarc7_msgs::MotionPointStampedArray::Ptr plan(
+            new iarc7_msgs::MotionPointStampedArray());
+    plan->motion_points.resize(num_points);
+    for (int i = 0; i < num_points; i++) {
+        MotionPointStamped& motion_point = plan->motion_points[i];
+        motion_point.header.frame_id = "map";
+        motion_point.header.stamp = start + ros::Duration(i * kTimestep);
+        motion_point.motion_point.pose.position.z = 1.0 + 1e-3 * i;
+    }
+    return plan;
+}
+
+// Runs ticks control ticks with trim and append, returns nanoseconds per
+// tick spent in them
+template <class Queue, class Trim, class Append>
+double timePerTick(Queue& queue,
+                   const std::vector<MotionPointQueue::PlanConstPtr>& plans,
+                   int ticks,
+                   Trim trim,
+                   Append append)
+{
+    const ros::Time start = plans.front()->motion_points.front().header.stamp;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        ros::Time time = start + ros::Duration((tick + 0.5) * kTimestep);
+        if (tick % kTicksPerPlan == 0) {
+            append(queue, plans[tick / kTicksPerPlan]);
+        }
+        trim(queue, time);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count() / ticks;
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    const double duration = argc > 1 ? std::atof(argv[1]) : 5.0;
+    if (!(duration >= kTimestep)) {
+        std::fprintf(stderr, "Usage: %s [duration_seconds]\n", argv[0]);
+        return 2;
+    }
+
+    ros::Time::init();
+
+    const int plan_points = static_cast<int>(duration / kTimestep) + 1;
+    const int ticks = 20000;
+
+    // Plans are built up front so only the queue operations are timed
+    const ros::Time start(1000.0);
+    std::vector<MotionPointQueue::PlanConstPtr> plans;
+    for (int tick = 0; tick < ticks; tick += kTicksPerPlan) {
+        plans.push_back(makePlan(start + ros::Duration(tick * kTimestep),
+                                 plan_points));
+    }
+
+    MotionPointStampedArray vector_queue;
+    double vector_ns = timePerTick(vector_queue, plans, ticks, vectorTrim, vectorAppend);
+
+    RingBuffer<TrajectorySample> ring_queue(plan_points + 1);
+    bool ring_ok = true;
+    double ring_ns = timePerTick(ring_queue, plans, ticks, ringTrim,
+        [&ring_ok](RingBuffer<TrajectorySample>& queue,
+                   const MotionPointQueue::PlanConstPtr& plan) {
+            ring_ok = ringAppend(queue, plan) && ring_ok;
+        });
+
+    MotionPointQueue plan_queue(plan_points + 1);
+    bool plan_ok = true;
+    double plan_ns = timePerTick(plan_queue, plans, ticks, planTrim,
+        [&plan_ok](MotionPointQueue& queue,
+                   const MotionPointQueue::PlanConstPtr& plan) {
+            plan_ok = planAppend(queue, plan) && plan_ok;
+        });
+
+    if (!ring_ok || !plan_ok
+            || vector_queue.size() != ring_queue.size()
+            || vector_queue.size() != plan_queue.size()
+            || static_cast<int64_t>(vector_queue.back().header.stamp.toNSec())
+                   != ring_queue.back().stamp_ns
+            || vector_queue.back().header.stamp != plan_queue.back().header.stamp) {
+        std::fprintf(stderr, "Queues differ after the run\n");
+        return 1;
+    }
+
+    std::printf("%.3f s of 1 kHz motion points (%d per plan), %d ticks, "
+                "plan every %d ticks\n",
+                duration, plan_points, ticks, kTicksPerPlan);
+    std::printf("std::vector      %10.1f ns/tick\n", vector_ns);
+    std::printf("RingBuffer       %10.1f ns/tick\n", ring_ns);
+    std::printf("MotionPointQueue %10.1f ns/tick\n", plan_ns);
+    return 0;
+}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Polynomial Benchmark
+//
+// Times thrust_to_voltage evaluation three ways: the per coefficient
+// std::pow sum ThrustModel used to do on a std::vector, Polynomial's
+// scalar Horner evaluation, and Polynomial's batch evaluation.
+//
+// Usage: polynomial_benchmark [num_points]
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "iarc7_motion/Polynomial.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// Coefficients from param/thrust_models/thrust_model_1.9.yaml
+const std::vector<double> kThrustToVoltage = {5.8088274948944845,
+                                              -12.279167938928392,
+                                              17.316436473713267,
+                                              1.1308578342038291};
+
+double powerSum(const std::vector<double>& coefficients, double thrust)
+{
+    double sum = 0;
+    for(unsigned int i = 0; i < coefficients.size(); i++) {
+        double inc = coefficients[i]*std::pow(thrust, coefficients.size()-1-i);
+        sum += inc;
+    }
+    return sum;
+}
+
+// Runs function over the inputs enough times to take a measurable amount
+// of time, returns nanoseconds per point
+template <class Function>
+double timePerPoint(const std::vector<double>& thrusts,
+                    std::vector<double>& voltages,
+                    Function function)
+{
+    const int repetitions = std::max(1, 20000000 / static_cast<int>(thrusts.size()));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        function(thrusts, voltages);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count()
+         / (static_cast<double>(repetitions) * thrusts.size());
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    const int num_points = argc > 1 ? std::atoi(argv[1]) : 1024;
+    if (num_points < 1) {
+        std::fprintf(stderr, "Usage: %s [num_points]\n", argv[0]);
+        return 2;
+    }
+
+    Polynomial polynomial;
+    if (!polynomial.setCoefficients(kThrustToVoltage.data(),
+                                    kThrustToVoltage.size())) {
+        return 1;
+    }
+
+    std::vector<double> thrusts(num_points);
+    std::vector<double> voltages(num_points);
+    for (int i = 0; i < num_points; i++) {
+        thrusts[i] = 0.9 * i / num_points;
+    }
+
+    double pow_ns = timePerPoint(thrusts, voltages,
+        [](const std::vector<double>& in, std::vector<double>& out) {
+            for (size_t i = 0; i < in.size(); i++) {
+                out[i] = powerSum(kThrustToVoltage, in[i]);
+            }
+        });
+    double pow_checksum = voltages[num_points / 2];
+
+    double horner_ns = timePerPoint(thrusts, voltages,
+        [&polynomial](const std::vector<double>& in, std::vector<double>& out) {
+            for (size_t i = 0; i < in.size(); i++) {
+                out[i] = polynomial(in[i]);
+            }
+        });
+    double horner_checksum = voltages[num_points / 2];
+
+    double batch_ns = timePerPoint(thrusts, voltages,
+        [&polynomial](const std::vector<double>& in, std::vector<double>& out) {
+            polynomial.evaluate(in.data(), out.data(), in.size());
+        });
+    double batch_checksum = voltages[num_points / 2];
+
+    std::printf("%d coefficients, %d points\n", polynomial.size(), num_points);
+    std::printf("std::pow sum     %8.3f ns/point (%.12f)\n", pow_ns, pow_checksum);
+    std::printf("Horner scalar    %8.3f ns/point (%.12f)\n", horner_ns, horner_checksum);
+    std::printf("Horner batch     %8.3f ns/point (%.12f)\n", batch_ns, batch_checksum);
+    return 0;
+}
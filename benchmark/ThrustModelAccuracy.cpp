@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Accuracy
+//
+// Replays thrust stand logs from scripts/thrust_model_v2/Dynamic/*FullTest
+// through a thrust model and reports how far the model's predictions are
+// from the recorded thrust.
+//
+// Usage: thrust_model_accuracy <model.yaml> <log.txt>...
+//
+// The models fit to each log are in
+// scripts/thrust_model_v2/Dynamic/DynamicModelData, e.g. EmaxFullTest's
+// dynamic_6x4.5x2_prop_back_r1.txt was fit as
+// EmaxDynamic/6x4.5x2_dynamic_prop_back_r1.txt.output.yaml
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <vector>
+
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/ThrustModelReplay.hpp"
+#include "iarc7_motion/ThrustModelYaml.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+void printStats(const char* name,
+                const char* unit,
+                const ThrustModelReplay::ErrorStats& stats)
+{
+    std::printf("  %-16s %7d samples  rms %.4f  mean %+.4f  p95 %.4f  max %.4f %s\n",
+                name,
+                stats.samples,
+                stats.rms,
+                stats.mean,
+                stats.p95,
+                stats.max,
+                unit);
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <model.yaml> <log.txt>...\n", argv[0]);
+        return 2;
+    }
+
+    ThrustModelYaml::Model yaml_model;
+    if (!ThrustModelYaml::load(argv[1], yaml_model)) {
+        return 1;
+    }
+
+    // Mass only scales accelerations, which replay doesn't use
+    ThrustModel model;
+    model.loadModel(yaml_model.contents(), 1.0);
+
+    int failures = 0;
+    for (int i = 2; i < argc; i++) {
+        std::vector<ThrustModelReplay::Segment> segments;
+        if (!ThrustModelReplay::loadLog(argv[i], segments)) {
+            std::fprintf(stderr, "No samples in %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+
+        ThrustModelReplay::Result result = ThrustModelReplay::replay(model, segments);
+        std::printf("%s (%zu segments)\n", argv[i], segments.size());
+        printStats("dynamic thrust", "kg", result.dynamic_thrust);
+        printStats("steady voltage", "V", result.steady_voltage);
+    }
+    return failures == 0 ? 0 : 1;
+}
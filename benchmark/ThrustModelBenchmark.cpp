@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Benchmark
+//
+// Times the thrust model calls made by the controllers for each model
+// given: voltageFromThrust with and without the lookup table,
+// get_voltage_for_thrust, loading a model, and the 6dof mixer path of
+// QuadVelocityController (one vertical and four side motors).
+//
+// Usage: thrust_model_benchmark <model.yaml>...
+//
+// e.g. thrust_model_benchmark param/thrust_models/*.yaml
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/ThrustModelYaml.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// Calls timed together, so clock overhead is small compared to the call
+constexpr int kCallsPerBatch = 64;
+constexpr int kBatches = 4000;
+
+// Same as the defaults in ThrustModelData::loadModel
+constexpr int kLookupTableStartPoints = 64;
+constexpr int kLookupTableDesiredPoints = 256;
+
+constexpr double kModelMass = 2.85;
+
+struct Timing
+{
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+// Runs function kCallsPerBatch times per batch, returns ns per call over
+// the batches
+template <class Function>
+Timing timeCalls(Function function, int batches = kBatches)
+{
+    std::vector<double> ns_per_call(batches);
+    for (int i = 0; i < batches; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < kCallsPerBatch; j++) {
+            function(i * kCallsPerBatch + j);
+        }
+        auto end = std::chrono::steady_clock::now();
+        ns_per_call[i] = std::chrono::duration<double, std::nano>(end - start).count()
+                       / kCallsPerBatch;
+    }
+
+    Timing timing;
+    double sum = 0.0;
+    for (double ns : ns_per_call) {
+        sum += ns;
+    }
+    timing.mean = sum / batches;
+
+    std::sort(ns_per_call.begin(), ns_per_call.end());
+    timing.p50 = ns_per_call[static_cast<size_t>(0.50 * (batches - 1))];
+    timing.p90 = ns_per_call[static_cast<size_t>(0.90 * (batches - 1))];
+    timing.p99 = ns_per_call[static_cast<size_t>(0.99 * (batches - 1))];
+    timing.max = ns_per_call.back();
+    return timing;
+}
+
+void printTiming(const char* name, const Timing& timing, double checksum)
+{
+    std::printf("  %-28s %9.1f %9.1f %9.1f %9.1f %9.1f  (%.6f)\n",
+                name,
+                timing.mean,
+                timing.p50,
+                timing.p90,
+                timing.p99,
+                timing.max,
+                checksum);
+}
+
+// Accelerations sweeping up and down through the range a controller
+// commands, so consecutive calls start from different thrusts
+std::vector<double> makeAccels(double max_thrust, int num_props)
+{
+    const int num_accels = 997;
+    const double max_accel = 9.81 * max_thrust * num_props / kModelMass;
+
+    std::vector<double> accels(num_accels);
+    for (int i = 0; i < num_accels; i++) {
+        double fraction = static_cast<double>((i * 389) % num_accels) / num_accels;
+        accels[i] = fraction * max_accel;
+    }
+    return accels;
+}
+
+void benchmarkModel(const std::string& path, const ThrustModelYaml::Model& model)
+{
+    const ThrustModelFile::Contents contents = model.contents();
+
+    ThrustModel scan_model;
+    scan_model.loadModel(contents, kModelMass);
+
+    ThrustModel table_model = scan_model;
+    table_model.buildLookupTable(kLookupTableStartPoints,
+                                 kLookupTableDesiredPoints);
+
+    const std::vector<double> vertical_accels = makeAccels(model.thrust_max, 4);
+    const std::vector<double> side_accels = makeAccels(model.thrust_max, 1);
+    const int num_accels = vertical_accels.size();
+
+    std::printf("%s (%dx%d mapping, %zu coefficients)\n",
+                path.c_str(),
+                model.num_thrust_points,
+                model.num_voltage_points,
+                model.thrust_to_voltage.size());
+    std::printf("  %-28s %9s %9s %9s %9s %9s  ns/call\n",
+                "", "mean", "p50", "p90", "p99", "max");
+
+    double checksum = 0.0;
+    Timing timing = timeCalls([&](int i) {
+        checksum += scan_model.voltageFromThrust(vertical_accels[i % num_accels], 4, 0.0);
+    });
+    printTiming("voltageFromThrust scan", timing, checksum);
+
+    checksum = 0.0;
+    timing = timeCalls([&](int i) {
+        checksum += table_model.voltageFromThrust(vertical_accels[i % num_accels], 4, 0.0);
+    });
+    printTiming("voltageFromThrust table", timing, checksum);
+
+    checksum = 0.0;
+    timing = timeCalls([&](int i) {
+        checksum += scan_model.get_voltage_for_thrust(
+                model.thrust_max * (i % num_accels) / num_accels);
+    });
+    printTiming("get_voltage_for_thrust", timing, checksum);
+
+    // Vertical motors plus a batch of the four side motors per tick, as
+    // QuadVelocityController::update does with the 6dof mixer
+    double side_start_thrusts[4] = {0.0, 0.0, 0.0, 0.0};
+    checksum = 0.0;
+    timing = timeCalls([&](int i) {
+        const double accels[4] = {side_accels[i % num_accels],
+                                  side_accels[(i + 250) % num_accels],
+                                  side_accels[(i + 500) % num_accels],
+                                  side_accels[(i + 750) % num_accels]};
+        double voltages[4];
+        table_model.voltagesFromThrusts(accels, 1, 0.0, side_start_thrusts, voltages, 4);
+        checksum += voltages[0] + voltages[1] + voltages[2] + voltages[3]
+                  + table_model.voltageFromThrust(vertical_accels[i % num_accels], 4, 0.0);
+    });
+    printTiming("6dof mixer tick", timing, checksum);
+
+    // Loading allocates and builds the table, far fewer batches are enough
+    checksum = 0.0;
+    timing = timeCalls([&](int) {
+        ThrustModel loaded;
+        loaded.loadModel(contents, kModelMass);
+        checksum += loaded.get_voltage_for_thrust(0.0);
+    }, 50);
+    printTiming("loadModel", timing, checksum);
+
+    checksum = 0.0;
+    timing = timeCalls([&](int) {
+        ThrustModel loaded;
+        loaded.loadModel(contents, kModelMass);
+        loaded.buildLookupTable(kLookupTableStartPoints,
+                                kLookupTableDesiredPoints);
+        checksum += loaded.get_voltage_for_thrust(0.0);
+    }, 5);
+    printTiming("loadModel + lookup table", timing, checksum);
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <model.yaml>...\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        ThrustModelYaml::Model model;
+        if (!ThrustModelYaml::load(argv[i], model)) {
+            std::fprintf(stderr, "Skipping %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+        benchmarkModel(argv[i], model);
+    }
+    return failures == argc - 1 ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Control Loop Timer
+//
+// Paces the low level motion control loop with absolute deadlines on the
+// monotonic clock and keeps the period, jitter and deadline miss counts of
+// every tick. Also sets up the scheduling of the thread the loop runs on.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef CONTROL_LOOP_TIMER_HPP
+#define CONTROL_LOOP_TIMER_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <ros/ros.h>
+
+#include "gtest/gtest_prod.h"
+
+namespace Iarc7Motion
+{
+
+struct ControlThreadSettings
+{
+    // Runs the control loop on its own timer, with callbacks that aren't
+    // needed by the update serviced on another thread
+    bool enabled = false;
+
+    // SCHED_FIFO priority of the control thread, 1 to 99, 0 keeps the
+    // normal scheduler
+    int priority = 0;
+
+    // CPU the control thread is pinned to, -1 for any
+    int cpu = -1;
+
+    // Locks all current and future memory of the process into RAM
+    bool lock_memory = false;
+
+    // Loads the settings under prefix from nh, keeping the defaults for
+    // any that aren't set
+    static ControlThreadSettings load(const ros::NodeHandle& nh,
+                                      const std::string& prefix);
+
+    // Applies priority, cpu and lock_memory to the calling thread. Threads
+    // it starts afterwards inherit the priority and cpu. Returns false if
+    // the system refuses any of them.
+    bool __attribute__((warn_unused_result)) applyToCurrentThread() const;
+};
+
+// Timing of the ticks so far, times are nanoseconds on CLOCK_MONOTONIC
+struct ControlLoopStats
+{
+    // Deadline of the next tick
+    int64_t deadline_ns = 0;
+
+    // When the last tick woke up
+    int64_t wake_ns = 0;
+
+    // Time between the last two wake ups
+    int64_t period_ns = 0;
+
+    // How late the last tick woke up after its deadline
+    int64_t jitter_ns = 0;
+
+    // Time from the last wake up until the loop went back to sleep
+    int64_t work_ns = 0;
+
+    uint64_t ticks = 0;
+
+    // Deadlines skipped because the loop was still working at them
+    uint64_t deadline_misses = 0;
+};
+
+class ControlLoopTimer
+{
+public:
+    // Starts timing, the first deadline is one period from now
+    explicit ControlLoopTimer(double frequency);
+
+    ControlLoopTimer() = delete;
+    ~ControlLoopTimer() = default;
+
+    // Sleeps until the next deadline. Deadlines that already passed are
+    // counted as misses and skipped, so ticks stay on the same phase.
+    void sleep();
+
+    const ControlLoopStats& stats() const
+    {
+        return stats_;
+    }
+
+    // Current CLOCK_MONOTONIC time
+    static int64_t monotonicNs();
+
+private:
+    // Bookkeeping done when the loop goes to sleep at sleep_ns: records the
+    // work time and moves the deadline past sleep_ns
+    static void beginSleep(int64_t period_ns,
+                           int64_t sleep_ns,
+                           ControlLoopStats& stats);
+
+    // Bookkeeping done when the loop wakes at wake_ns for the deadline
+    static void endSleep(int64_t period_ns,
+                         int64_t wake_ns,
+                         ControlLoopStats& stats);
+
+    const int64_t period_ns_;
+    ControlLoopStats stats_;
+
+    FRIEND_TEST(ControlLoopTimerTests, testDeadlines);
+};
+
+} // End namespace Iarc7Motion
+
+#endif // CONTROL_LOOP_TIMER_HPP
@@ -11,9 +11,10 @@
 
 #include <ros/ros.h>
 
-#include "ros_utils/LinearMsgInterpolator.hpp"
 #include "ros_utils/SafeTransformWrapper.hpp"
 
+#include "iarc7_motion/StateSnapshot.hpp"
+
 // ROS message headers
 #include "iarc7_msgs/BoolStamped.h"
 #include "iarc7_msgs/MotionPointStamped.h"
@@ -43,9 +44,9 @@ public:
     bool __attribute__((warn_unused_result)) prepareForTakeover(
         const ros::Time& time);
 
-    // Used to get a uav control message
+    // Used to get a uav control message for the state at state.stamp
     bool __attribute__((warn_unused_result)) getTargetMotionPoint(
-        const ros::Time& time,
+        const StateSnapshot& state,
         iarc7_msgs::MotionPointStamped& target_twist);
 
     /// Waits until this object is ready to begin normal operation
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Latency Histogram
+//
+// Counts how long a stage of the control loop takes in log-linear buckets,
+// as in an HDR histogram: every power of two nanoseconds is split into
+// kSubBuckets equal buckets, so each bucket is within 1 / kSubBuckets of
+// the values it holds from a nanosecond up to kMaxExponent. Recording is a
+// handful of instructions and never takes a lock, and another thread can
+// read the counts at any time.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_LATENCY_HISTOGRAM_HPP_
+#define IARC7_MOTION_LATENCY_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Iarc7Motion
+{
+
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int64_t kSubBuckets = int64_t(1) << kSubBucketBits;
+
+    // Values from 2^kMaxExponent ns, about 18 minutes, go in the last
+    // bucket
+    static constexpr int kMaxExponent = 40;
+
+    // Values below kSubBuckets get a bucket each, then kSubBuckets for
+    // every power of two up to kMaxExponent
+    static constexpr size_t kNumBuckets
+        = kSubBuckets * (kMaxExponent - kSubBucketBits + 2);
+
+    typedef std::array<uint64_t, kNumBuckets> Counts;
+
+    LatencyHistogram()
+    {
+        for (std::atomic<uint64_t>& count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram(const LatencyHistogram& rhs) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram& rhs) = delete;
+
+    // Counts a stage that took duration_ns. Only one thread may record
+    // into a histogram.
+    void record(int64_t duration_ns)
+    {
+        std::atomic<uint64_t>& count = counts_[bucketIndex(duration_ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    // Copies the counts recorded so far. Safe from any thread, a record
+    // running at the same time may or may not be included.
+    void snapshot(Counts& counts) const
+    {
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Bucket a value goes in, negative values count as zero
+    static size_t bucketIndex(int64_t value)
+    {
+        if (value < kSubBuckets) {
+            return value < 0 ? 0 : static_cast<size_t>(value);
+        }
+
+        const int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+        if (exponent > kMaxExponent) {
+            return kNumBuckets - 1;
+        }
+
+        const int shift = exponent - kSubBucketBits;
+        const int64_t sub_bucket = (value >> shift) - kSubBuckets;
+        return static_cast<size_t>(kSubBuckets * (shift + 1) + sub_bucket);
+    }
+
+    // Largest value that goes in bucket index
+    static int64_t bucketUpperBound(size_t index)
+    {
+        if (index < static_cast<size_t>(kSubBuckets)) {
+            return static_cast<int64_t>(index);
+        }
+
+        const int shift = static_cast<int>(index / kSubBuckets) - 1;
+        const int64_t sub_bucket = static_cast<int64_t>(index % kSubBuckets);
+        return ((kSubBuckets + sub_bucket + 1) << shift) - 1;
+    }
+
+    // Sum of counts
+    static uint64_t total(const Counts& counts)
+    {
+        uint64_t sum = 0;
+        for (uint64_t count : counts) {
+            sum += count;
+        }
+        return sum;
+    }
+
+    // Upper bound of the bucket holding the given fraction, 0 to 1, of the
+    // counted values, 0 if nothing is counted. A fraction of 1 gives the
+    // maximum.
+    static int64_t percentile(const Counts& counts, double fraction)
+    {
+        const uint64_t count = total(counts);
+        if (count == 0) {
+            return 0;
+        }
+
+        // Rank of the value, counting from 1
+        uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+        rank = rank < 1 ? 1 : rank > count ? count : rank;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return bucketUpperBound(i);
+            }
+        }
+        return bucketUpperBound(kNumBuckets - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kNumBuckets> counts_;
+};
+
+// Records the time from construction to destruction, or to stop if that
+// comes first, in a histogram
+class ScopedLatencyTimer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit ScopedLatencyTimer(LatencyHistogram& histogram)
+        : histogram_(histogram),
+          start_(Clock::now()),
+          running_(true)
+    {
+    }
+
+    ~ScopedLatencyTimer()
+    {
+        stop();
+    }
+
+    ScopedLatencyTimer(const ScopedLatencyTimer& rhs) = delete;
+    ScopedLatencyTimer& operator=(const ScopedLatencyTimer& rhs) = delete;
+
+    // Records the time so far, later calls do nothing
+    void stop()
+    {
+        if (running_) {
+            running_ = false;
+            histogram_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start_).count());
+        }
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    const Clock::time_point start_;
+    bool running_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_LATENCY_HISTOGRAM_HPP_
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Latency Monitor
+//
+// Periodically publishes the 50th and 99th percentile and the maximum of
+// each registered LatencyHistogram over the last report period, as a
+// diagnostic_msgs::DiagnosticArray. Reports are built on the monitor's own
+// thread, which only reads the histograms, so the threads recording into
+// them are never held up.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_LATENCY_MONITOR_HPP_
+#define IARC7_MOTION_LATENCY_MONITOR_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+#include "diagnostic_msgs/DiagnosticArray.h"
+
+#include "iarc7_motion/LatencyHistogram.hpp"
+
+#include "gtest/gtest_prod.h"
+
+namespace Iarc7Motion
+{
+
+class LatencyMonitor
+{
+public:
+    // Reads the report period from the latency_report_period param
+    LatencyMonitor(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+
+    LatencyMonitor() = delete;
+    ~LatencyMonitor() = default;
+
+    LatencyMonitor(const LatencyMonitor& rhs) = delete;
+    LatencyMonitor& operator=(const LatencyMonitor& rhs) = delete;
+
+    // Reports histogram under name. The histogram must outlive the
+    // monitor. Stages can only be added before start.
+    void addStage(const std::string& name, const LatencyHistogram& histogram);
+
+    // Starts publishing reports
+    void start();
+
+private:
+    struct Stage
+    {
+        std::string name;
+        const LatencyHistogram* histogram;
+
+        // Counts at the last report
+        std::unique_ptr<LatencyHistogram::Counts> reported;
+    };
+
+    // Fills status with the percentiles of the values stage recorded since
+    // its last report
+    static void reportStage(Stage& stage,
+                            LatencyHistogram::Counts& counts,
+                            diagnostic_msgs::DiagnosticStatus& status);
+
+    void publishReport(const ros::WallTimerEvent& event);
+
+    const ros::WallDuration report_period_;
+
+    std::vector<Stage> stages_;
+
+    // Counts read for a report, kept to avoid allocating every report
+    std::unique_ptr<LatencyHistogram::Counts> counts_;
+
+    diagnostic_msgs::DiagnosticArray report_;
+
+    ros::Publisher report_publisher_;
+
+    // Reports are built from this queue by report_spinner_'s thread
+    ros::CallbackQueue report_callback_queue_;
+    ros::NodeHandle report_nh_;
+    ros::WallTimer report_timer_;
+    ros::AsyncSpinner report_spinner_;
+
+    bool started_;
+
+    FRIEND_TEST(LatencyHistogramTests, testReportStage);
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_LATENCY_MONITOR_HPP_
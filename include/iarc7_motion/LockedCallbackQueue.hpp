@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Locked Callback Queue
+//
+// Callback queue for subscribers whose data is read from another thread.
+// Each callback is added to a shared ros::CallbackQueue, serviced by a
+// spinner, and is run with a mutex held. Readers take the same mutex, and
+// can wait on a condition variable that is notified after every callback.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_LOCKED_CALLBACK_QUEUE_HPP_
+#define IARC7_MOTION_LOCKED_CALLBACK_QUEUE_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <boost/make_shared.hpp>
+
+#include <ros/callback_queue.h>
+#include <ros/callback_queue_interface.h>
+
+namespace Iarc7Motion
+{
+
+class LockedCallbackQueue : public ros::CallbackQueueInterface
+{
+public:
+    LockedCallbackQueue() = delete;
+
+    // Callbacks go on queue and are run with mutex held, called is
+    // notified after each of them
+    LockedCallbackQueue(ros::CallbackQueue& queue,
+                        std::mutex& mutex,
+                        std::condition_variable& called)
+        : queue_(queue),
+          mutex_(mutex),
+          called_(called),
+          call_count_(0)
+    {
+    }
+
+    ~LockedCallbackQueue() = default;
+
+    // Don't allow the copy constructor or assignment.
+    LockedCallbackQueue(const LockedCallbackQueue& rhs) = delete;
+    LockedCallbackQueue& operator=(const LockedCallbackQueue& rhs) = delete;
+
+    void addCallback(const ros::CallbackInterfacePtr& callback,
+                     uint64_t owner_id = 0) override
+    {
+        queue_.addCallback(boost::make_shared<LockedCallback>(callback, *this),
+                           owner_id);
+    }
+
+    void removeByID(uint64_t owner_id) override
+    {
+        queue_.removeByID(owner_id);
+    }
+
+    // Number of callbacks run successfully, read with the mutex held
+    size_t callCount() const
+    {
+        return call_count_;
+    }
+
+private:
+    class LockedCallback : public ros::CallbackInterface
+    {
+    public:
+        LockedCallback(const ros::CallbackInterfacePtr& callback,
+                       LockedCallbackQueue& queue)
+            : callback_(callback),
+              queue_(queue)
+        {
+        }
+
+        CallResult call() override
+        {
+            CallResult result;
+            {
+                std::lock_guard<std::mutex> lock(queue_.mutex_);
+                result = callback_->call();
+                if (result == Success) {
+                    queue_.call_count_++;
+                }
+            }
+            queue_.called_.notify_all();
+            return result;
+        }
+
+        bool ready() override
+        {
+            return callback_->ready();
+        }
+
+    private:
+        const ros::CallbackInterfacePtr callback_;
+        LockedCallbackQueue& queue_;
+    };
+
+    ros::CallbackQueue& queue_;
+    std::mutex& mutex_;
+    std::condition_variable& called_;
+    size_t call_count_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_LOCKED_CALLBACK_QUEUE_HPP_
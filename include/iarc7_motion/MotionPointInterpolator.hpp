@@ -11,12 +11,25 @@
 #define MOTION_POINT_INTERPOLATOR_H
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest_prod.h"
 
 #include "iarc7_msgs/MotionPointStampedArray.h"
 #include "iarc7_msgs/MotionPoint.h"
+#include "iarc7_motion/PolynomialTrajectory.h"
+#include "iarc7_motion/VelocityGoal.h"
+
+#include "iarc7_motion/MotionPointQueue.hpp"
+#include "iarc7_motion/PolynomialTrajectory.hpp"
+#include "iarc7_motion/SpscQueue.hpp"
+#include "iarc7_motion/TrajectorySample.hpp"
+#include "iarc7_motion/VelocityProfileGenerator.hpp"
 
 using iarc7_msgs::MotionPointStamped;
 using geometry_msgs::Pose;
@@ -29,13 +42,102 @@ namespace Iarc7Motion
 // Typdef the vector template to a shorter name for ease of typing
 typedef std::vector<MotionPointStamped> MotionPointStampedArray;
 
+// How targets are interpolated between two motion points.
+// LINEAR interpolates every field on its own.
+// CUBIC fits a cubic to the positions and velocities at both ends.
+// QUINTIC fits a quintic to the positions, velocities and accelerations at
+// both ends.
+// For CUBIC and QUINTIC the velocity and acceleration targets are the
+// derivatives of the position polynomial, so the targets stay consistent
+// with each other between coarsely spaced motion points.
+enum class InterpolationMode { LINEAR,
+                               CUBIC,
+                               QUINTIC };
+
+// Plan received by the subscriber and the time it was received, waiting
+// to be appended to the motion point queue by the control thread. Exactly
+// one of plan, polynomial_plan and velocity_goal is set.
+struct PendingPlan
+{
+    MotionPointQueue::PlanConstPtr plan;
+    std::shared_ptr<const PolynomialTrajectory> polynomial_plan;
+    iarc7_motion::VelocityGoal::ConstPtr velocity_goal;
+    ros::Time time;
+};
+
+// Polynomial trajectory being followed instead of the motion point queue.
+// It is followed from its start until end_ns, when a dense plan received
+// after it takes over.
+struct PolynomialTargets
+{
+    std::shared_ptr<const PolynomialTrajectory> trajectory;
+    int64_t end_ns = std::numeric_limits<int64_t>::max();
+};
+
+// Where the last target was found in the motion point queue and the
+// polynomial trajectory. Looking up targets at increasing times from here
+// finds each one in O(1), as when the control loop samples every tick or
+// a batch of times is sampled at once. Checked before it is used, so after
+// the targets change it only makes the next lookup slower.
+struct TargetCursor
+{
+    // Index of the first queued motion point at or after the last time
+    size_t motion_point = 0;
+
+    // Index of the polynomial trajectory segment the last time was in
+    size_t segment = 0;
+};
+
+// Size of the jumps in the targets where plans were spliced in, before
+// blending. Jumps are the norms of the differences in the position,
+// velocity and acceleration targets.
+struct SpliceMetrics
+{
+    uint64_t splices = 0;
+
+    double last_position_jump = 0.0;
+    double last_velocity_jump = 0.0;
+    double last_accel_jump = 0.0;
+
+    double max_position_jump = 0.0;
+    double max_velocity_jump = 0.0;
+    double max_accel_jump = 0.0;
+};
+
+// Blends out the jump in the targets where a plan replaces the targets
+// being followed. The old targets minus the new ones at the splice are
+// added to the new targets and brought to zero over blend_duration_ns
+// along a quintic, so the position, velocity and acceleration targets
+// stay continuous and consistent with each other.
+struct PlanSplice
+{
+    // Zero appends plans without blending
+    int64_t blend_duration_ns = 0;
+
+    // Old minus new targets at the splice, which is at offset.stamp_ns
+    TrajectorySample offset = TrajectorySample();
+
+    // Blending stops here, before the first splice there is none
+    int64_t blend_end_ns = std::numeric_limits<int64_t>::min();
+
+    // Time of the last target given to the controller. Splices are only
+    // blended and measured while the controller is following the
+    // targets, so the first plan after takeoff is taken as it is.
+    int64_t last_target_ns = std::numeric_limits<int64_t>::min();
+
+    SpliceMetrics metrics;
+};
+
+// Handoff from the plan callback thread to the control thread
+typedef SpscQueue<PendingPlan, 16> PlanHandoff;
+
 class MotionPointInterpolator
 {
 public:
     MotionPointInterpolator() = delete;
 
     // Require construction with a node handle
-    MotionPointInterpolator(ros::NodeHandle& nh);
+    MotionPointInterpolator(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
 
     ~MotionPointInterpolator() = default;
 
@@ -44,50 +146,230 @@ public:
     MotionPointInterpolator& operator=(const MotionPointInterpolator& rhs) = delete;
 
     // Called by a class user to get a target motion point
-    // Makes the call to trim the queue during the class
+    // Appends any plans received since the last call and
+    // makes the call to trim the queue during the class
     // Interpolates if there is more than one twist
     void getTargetMotionPoint(
                     const ros::Time& current_time,
                     MotionPointStamped& target_motion_point);
 
+    // Appends any plans received since the last call and trims the
+    // targets before current_time. Call on every control tick, whatever
+    // is flying the quad, so the handoff from the plan thread never fills
+    // and the newest plan is the one followed.
+    void takePlans(const ros::Time& current_time);
+
+    // Targets at each of times, which must be increasing, as of the last
+    // call to getTargetMotionPoint. Nothing is trimmed or appended, so
+    // this can be called any number of times per tick, from the control
+    // thread only. The queue is swept once from the last target. Returns
+    // false if any time has no valid target, the times before it are
+    // filled in.
+    bool __attribute__((warn_unused_result)) getTargetMotionPoints(
+                    const std::vector<ros::Time>& times,
+                    std::vector<MotionPointStamped>& target_motion_points) const;
+
 private:
     // Used to allow unit tests to call private functions
     FRIEND_TEST(MotionPointInterpolatorTests, testTrimMotionPointQueue);
     FRIEND_TEST(MotionPointInterpolatorTests, testAppendMotionPointQueue);
+    FRIEND_TEST(MotionPointInterpolatorTests, testInterpolateMotionPoints);
+    FRIEND_TEST(MotionPointInterpolatorTests, testInterpolateMotionPointsHermite);
+    FRIEND_TEST(MotionPointInterpolatorTests, testMotionPointQueueWraparound);
+    FRIEND_TEST(MotionPointInterpolatorTests, testAppendMotionPointQueueOverflow);
+    FRIEND_TEST(MotionPointInterpolatorTests, testPlanHandoffStress);
+    FRIEND_TEST(MotionPointInterpolatorTests, testPolynomialTargets);
+    FRIEND_TEST(MotionPointInterpolatorTests, testVelocityGoal);
+    FRIEND_TEST(MotionPointInterpolatorTests, testFutureVelocityGoal);
+    FRIEND_TEST(MotionPointInterpolatorTests, testTakePlansWithoutSampling);
+    FRIEND_TEST(MotionPointInterpolatorTests, testPlanSplice);
+    FRIEND_TEST(MotionPointInterpolatorTests, testTargetLookahead);
+    FRIEND_TEST(MotionPointInterpolatorTests, testRandomPlans);
+
+    // Used to allow the benchmark to time private functions
+    friend struct MotionPointInterpolatorBenchmark;
 
-    // Receive a new list of velocities commands and call appendVelocityQueue to insert them into the queue
+    // Receive a new list of velocities commands and hand it to the control thread.
+    // Runs on the plan callback thread.
     void processMotionPointArray(
         const iarc7_msgs::MotionPointStampedArray::ConstPtr& message);
 
+    // Checks message is a valid plan and hands it to the control thread,
+    // received at time. Returns false if the plan is rejected or
+    // pending_plans is full.
+    static bool handOffMotionPointArray(
+        PlanHandoff& pending_plans,
+        const iarc7_msgs::MotionPointStampedArray::ConstPtr& message,
+        const ros::Time& time);
+
+    // Receive a polynomial trajectory, convert it and hand it to the control
+    // thread. Runs on the plan callback thread.
+    void processPolynomialTrajectory(
+        const iarc7_motion::PolynomialTrajectory::ConstPtr& message);
+
+    // Receive a velocity goal and hand it to the control thread, which
+    // generates its profile. Runs on the plan callback thread.
+    void processVelocityGoal(
+        const iarc7_motion::VelocityGoal::ConstPtr& message);
+
     // Trim the velocity queue so that there aren't old velocities in the queue
     static bool trimMotionPointQueue(
-        MotionPointStampedArray& motion_points,
+        MotionPointQueue& motion_points,
         const ros::Time& time);
 
     // Append velocity targets to the velocity queue. If the velocity targets are older than the newest velocity target queued
-    // the queued velocity targets are discarded
+    // the queued velocity targets are discarded. The plan is queued by
+    // reference, none of its targets are copied. If the queue can't hold
+    // all of its targets the last ones are dropped and false is returned.
     static bool appendMotionPointQueue(
-        MotionPointStampedArray& current_motion_points,
-        const MotionPointStampedArray& new_motion_points,
+        MotionPointQueue& current_motion_points,
+        const MotionPointQueue::PlanConstPtr& new_plan,
         const ros::Time& time);
 
-    // Takes two twists and interpolates between their values
-    // using linear interpolation
-    static bool interpolateMotionPoints(MotionPointStamped& begin,
-                                        MotionPointStamped& end,
-                                        MotionPointStamped& interpolated,
-                                        ros::Time time);
+    // Makes trajectory the polynomial targets, discarding queued motion
+    // points from its start on. The oldest motion point is always kept so
+    // the queue is never empty.
+    static void appendPolynomialTrajectory(
+        MotionPointQueue& motion_points,
+        PolynomialTargets& polynomial_targets,
+        const std::shared_ptr<const PolynomialTrajectory>& trajectory);
+
+    // Makes the velocity profile for goal the polynomial targets. The
+    // profile starts from the targets at the goal's stamp, or at the oldest
+    // queued motion point if that is later. Returns false if there is no
+    // valid start or the goal is invalid.
+    static bool applyVelocityGoal(
+        MotionPointQueue& motion_points,
+        PolynomialTargets& polynomial_targets,
+        const PlanSplice& plan_splice,
+        const VelocityProfileGenerator& velocity_profile_generator,
+        InterpolationMode mode,
+        const iarc7_motion::VelocityGoal& goal);
+
+    // Appends every plan waiting in pending_plans in the order they were
+    // received. A dense plan ends the polynomial targets where it starts.
+    // Velocity goals are interpolated from the targets with mode. The
+    // jump each plan makes in the targets at time is blended out and
+    // recorded in plan_splice.
+    // Returns false if any of them could not be appended.
+    static bool applyPendingPlans(
+        PlanHandoff& pending_plans,
+        const ros::Time& time,
+        MotionPointQueue& motion_points,
+        PolynomialTargets& polynomial_targets,
+        PlanSplice& plan_splice,
+        const VelocityProfileGenerator& velocity_profile_generator,
+        InterpolationMode mode);
+
+    // Trims the motion point queue to time and releases the polynomial
+    // trajectory once a dense plan has taken over from it
+    static void trimTargets(MotionPointQueue& motion_points,
+                            PolynomialTargets& polynomial_targets,
+                            const ros::Time& time);
+
+    // Target at time from the polynomial targets if they cover it, otherwise
+    // interpolated from the motion point queue, which is trimmed. Returns
+    // false if there is no valid target.
+    // The lookup starts from cursor, which is moved to time.
+    static bool sampleTargets(MotionPointQueue& motion_points,
+                              PolynomialTargets& polynomial_targets,
+                              const PlanSplice& plan_splice,
+                              const ros::Time& time,
+                              InterpolationMode mode,
+                              TargetCursor& cursor,
+                              TrajectorySample& target);
+
+    // Same target as sampleTargets without trimming or releasing anything
+    static bool peekTargets(const MotionPointQueue& motion_points,
+                            const PolynomialTargets& polynomial_targets,
+                            const PlanSplice& plan_splice,
+                            const ros::Time& time,
+                            InterpolationMode mode,
+                            TargetCursor& cursor,
+                            TrajectorySample& target);
+
+    // Same as peekTargets at each of times, which must be increasing, in
+    // one sweep from cursor. targets is resized to hold them all. Returns
+    // false if times are out of order or any time has no valid target.
+    static bool peekTargets(const MotionPointQueue& motion_points,
+                            const PolynomialTargets& polynomial_targets,
+                            const PlanSplice& plan_splice,
+                            const std::vector<ros::Time>& times,
+                            InterpolationMode mode,
+                            TargetCursor& cursor,
+                            std::vector<TrajectorySample>& targets);
+
+    // Records the jump from before, the target at time before a plan was
+    // appended, to the target now and starts blending it out
+    static void spliceTargets(const MotionPointQueue& motion_points,
+                              const PolynomialTargets& polynomial_targets,
+                              const TrajectorySample& before,
+                              const ros::Time& time,
+                              InterpolationMode mode,
+                              PlanSplice& plan_splice);
 
-    // Interpolate between arbitrary values and waypoints
-    // x is to be between 0-1 if the interpolation is to
-    // range from start to end.
-    static double interpolate(double x, double start, double end);
+    // Takes two samples and interpolates between their values
+    // using the given mode, time_ns is in nanoseconds
+    static bool interpolateMotionPoints(
+            const TrajectorySample& begin,
+            const TrajectorySample& end,
+            TrajectorySample& interpolated,
+            int64_t time_ns,
+            InterpolationMode mode = InterpolationMode::LINEAR);
+
+    // Mode named by the motion_point_interpolation param, one of
+    // "linear", "cubic" or "quintic"
+    static InterpolationMode interpolationModeFromName(const std::string& name);
+
+    // Number of targets that can be queued, the number of targets in
+    // duration seconds spaced timestep apart plus the target before the
+    // current time
+    static size_t queueCapacity(double duration, double timestep);
+
+    // How targets are interpolated between queued motion points
+    const InterpolationMode interpolation_mode_;
+
+    // Builds the profiles for velocity goals. Only used by the control
+    // thread.
+    const VelocityProfileGenerator velocity_profile_generator_;
+
+    // Plans received and not yet appended to motion_point_targets_
+    PlanHandoff pending_plans_;
+
+    // Plan callbacks are run from this queue by plan_spinner_'s thread, so
+    // receiving a plan never delays the control loop
+    ros::CallbackQueue plan_callback_queue_;
 
     // Subscriber for motion point targets
     ros::Subscriber motion_points_subscriber_;
 
-    // Queue of motion points with timestamps.
-    MotionPointStampedArray motion_point_targets_;
+    // Subscriber for polynomial trajectory targets
+    ros::Subscriber polynomial_trajectory_subscriber_;
+
+    // Subscriber for velocity goals
+    ros::Subscriber velocity_goal_subscriber_;
+
+    ros::AsyncSpinner plan_spinner_;
+
+    // Queue of motion points with timestamps, converted to
+    // TrajectorySamples as they are interpolated. Only used by the
+    // control thread.
+    MotionPointQueue motion_point_targets_;
+
+    // Polynomial trajectory followed instead of motion_point_targets_ while
+    // it covers the current time. Only used by the control thread.
+    PolynomialTargets polynomial_targets_;
+
+    // Blending of the jumps between plans. Only used by the control
+    // thread.
+    PlanSplice plan_splice_;
+
+    // Where the last target given to the controller was found. Only used
+    // by the control thread.
+    TargetCursor target_cursor_;
+
+    // Publishes the jumps in SpliceMetrics of every splice
+    ros::Publisher splice_debug_publisher_;
 };
 
 } // End namespace Iarc7Motion
@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Motion Point Queue
+//
+// Time ordered queue of motion point targets that keeps the plan messages
+// they arrived in instead of copies of the targets. Each plan is held by
+// shared pointer along with the range of its targets still queued, so
+// queueing a plan is O(1) in its length and targets are only read when
+// they are needed.
+//
+// Targets are indexed as one sequence across all queued plans, with the
+// same operations as RingBuffer.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_MOTION_POINT_QUEUE_HPP_
+#define IARC7_MOTION_MOTION_POINT_QUEUE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+
+#include <ros/ros.h>
+
+#include "iarc7_msgs/MotionPointStampedArray.h"
+
+#include "iarc7_motion/RingBuffer.hpp"
+
+namespace Iarc7Motion
+{
+
+class MotionPointQueue
+{
+public:
+    typedef iarc7_msgs::MotionPointStampedArray::ConstPtr PlanConstPtr;
+
+    MotionPointQueue() = default;
+
+    // Holds up to capacity targets. Every queued plan has at least one
+    // target queued, so that many plans at most.
+    explicit MotionPointQueue(size_t capacity)
+        : plans_(capacity),
+          capacity_(capacity)
+    {
+    }
+
+    // Maximum number of queued targets
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    size_t planCapacity() const
+    {
+        return plans_.capacity();
+    }
+
+    size_t numPlans() const
+    {
+        return plans_.size();
+    }
+
+    // Number of queued targets
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // Index 0 is the oldest target. Walks the queued plans, which are
+    // only ever a few, so this is cheap near either end of the queue.
+    const iarc7_msgs::MotionPointStamped& operator[](size_t i) const
+    {
+        ROS_ASSERT(i < size_);
+        for (size_t plan = 0; ; plan++) {
+            const PlanSpan& span = plans_[plan];
+            if (i < span.end - span.begin) {
+                return span.plan->motion_points[span.begin + i];
+            }
+            i -= span.end - span.begin;
+        }
+    }
+
+    const iarc7_msgs::MotionPointStamped& front() const
+    {
+        ROS_ASSERT(size_ > 0);
+        return plans_.front().plan->motion_points[plans_.front().begin];
+    }
+
+    const iarc7_msgs::MotionPointStamped& back() const
+    {
+        ROS_ASSERT(size_ > 0);
+        return plans_.back().plan->motion_points[plans_.back().end - 1];
+    }
+
+    // Queues targets [begin, end) of plan after the queued targets. The
+    // targets must not be older than the last queued target. Returns
+    // false and leaves the queue unchanged if they don't all fit.
+    bool __attribute__((warn_unused_result)) push_back(const PlanConstPtr& plan,
+                                                       size_t begin,
+                                                       size_t end)
+    {
+        ROS_ASSERT(plan && begin <= end && end <= plan->motion_points.size());
+        if (begin == end) {
+            return true;
+        }
+
+        if (end - begin > capacity_ - size_) {
+            return false;
+        }
+
+        PlanSpan span;
+        span.plan = plan;
+        span.begin = begin;
+        span.end = end;
+        const bool pushed = plans_.push_back(span);
+        ROS_ASSERT(pushed);
+
+        size_ += end - begin;
+        return true;
+    }
+
+    // Removes count targets from the front, plans with no targets left
+    // are released
+    void pop_front(size_t count)
+    {
+        ROS_ASSERT(count <= size_);
+        size_ -= count;
+
+        while (count > 0) {
+            PlanSpan& span = plans_.front();
+            const size_t span_size = span.end - span.begin;
+            if (count < span_size) {
+                span.begin += count;
+                break;
+            }
+
+            count -= span_size;
+            span.plan.reset();
+            plans_.pop_front();
+        }
+    }
+
+    // Removes targets from the back until there are at most size left
+    void truncate(size_t size)
+    {
+        while (size_ > size) {
+            PlanSpan& span = plans_.back();
+            const size_t span_size = span.end - span.begin;
+            const size_t excess = size_ - size;
+            if (excess < span_size) {
+                span.end -= excess;
+                size_ = size;
+                break;
+            }
+
+            size_ -= span_size;
+            span.plan.reset();
+            plans_.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        truncate(0);
+    }
+
+    // Index of the first target stamped at or after time, or size() if
+    // there is none
+    size_t lowerBound(const ros::Time& time) const
+    {
+        size_t index = 0;
+        for (size_t plan = 0; plan < plans_.size(); plan++) {
+            const PlanSpan& span = plans_[plan];
+            const auto& motion_points = span.plan->motion_points;
+
+            if (motion_points[span.end - 1].header.stamp < time) {
+                index += span.end - span.begin;
+                continue;
+            }
+
+            auto it = std::lower_bound(
+                    motion_points.begin() + span.begin,
+                    motion_points.begin() + span.end,
+                    time,
+                    [](auto& motion_point, auto& time) {
+                        return motion_point.header.stamp < time;
+                    });
+            return index + (it - (motion_points.begin() + span.begin));
+        }
+        return index;
+    }
+
+    // Same as lowerBound(time), found in O(1) when hint is the result or
+    // one or two targets before it, as when looking up increasing times.
+    // Any other hint falls back to the search.
+    size_t lowerBound(const ros::Time& time, size_t hint) const
+    {
+        if (hint <= size_ && (hint == 0 || (*this)[hint - 1].header.stamp < time)) {
+            for (int step = 0; step < 3; step++, hint++) {
+                if (hint == size_ || !((*this)[hint].header.stamp < time)) {
+                    return hint;
+                }
+            }
+        }
+        return lowerBound(time);
+    }
+
+private:
+    // Targets [begin, end) of a plan message
+    struct PlanSpan
+    {
+        PlanConstPtr plan;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    RingBuffer<PlanSpan> plans_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_MOTION_POINT_QUEUE_HPP_
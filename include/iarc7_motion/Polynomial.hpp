@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Polynomial
+//
+// Fixed capacity polynomial evaluated with Horner's scheme. Coefficients
+// are stored highest order first, the same order as thrust_to_voltage in
+// the thrust model files.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_POLYNOMIAL_HPP_
+#define IARC7_MOTION_POLYNOMIAL_HPP_
+
+#include <algorithm>
+#include <cmath>
+
+namespace Iarc7Motion
+{
+
+class Polynomial
+{
+public:
+    static constexpr int kMaxCoefficients = 8;
+
+    Polynomial() = default;
+
+    // Returns false and leaves the polynomial unchanged if there are no
+    // coefficients or more than kMaxCoefficients
+    bool __attribute__((warn_unused_result)) setCoefficients(
+            const double* coefficients,
+            int num_coefficients)
+    {
+        if (num_coefficients < 1 || num_coefficients > kMaxCoefficients) {
+            return false;
+        }
+
+        std::copy(coefficients, coefficients + num_coefficients, coefficients_);
+        num_coefficients_ = num_coefficients;
+        return true;
+    }
+
+    int size() const
+    {
+        return num_coefficients_;
+    }
+
+    const double* data() const
+    {
+        return coefficients_;
+    }
+
+    double operator()(double x) const
+    {
+        double result = coefficients_[0];
+        for (int i = 1; i < num_coefficients_; i++) {
+            result = multiplyAdd(result, x, coefficients_[i]);
+        }
+        return result;
+    }
+
+    // Evaluates the polynomial at each of xs. Points are taken kLanes at
+    // a time with the coefficient loop outside a fixed width lane loop,
+    // which compilers vectorize without needing -O3.
+    void evaluate(const double* xs, double* results, int num_points) const
+    {
+        int first = 0;
+        for (; first + kLanes <= num_points; first += kLanes) {
+            double lanes[kLanes];
+            for (int k = 0; k < kLanes; k++) {
+                lanes[k] = coefficients_[0];
+            }
+            for (int i = 1; i < num_coefficients_; i++) {
+                const double coefficient = coefficients_[i];
+                for (int k = 0; k < kLanes; k++) {
+                    lanes[k] = multiplyAdd(lanes[k], xs[first + k], coefficient);
+                }
+            }
+            for (int k = 0; k < kLanes; k++) {
+                results[first + k] = lanes[k];
+            }
+        }
+        for (; first < num_points; first++) {
+            results[first] = (*this)(xs[first]);
+        }
+    }
+
+private:
+    // Points per pass of evaluate, a multiple of the vector width
+    static constexpr int kLanes = 4;
+
+    // Fused where the target has a fast fma, otherwise std::fma would be a
+    // slow library call
+    static double multiplyAdd(double a, double b, double c)
+    {
+#ifdef FP_FAST_FMA
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    double coefficients_[kMaxCoefficients] = {0.0};
+    int num_coefficients_ = 1;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_POLYNOMIAL_HPP_
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Polynomial Trajectory
+//
+// Piecewise polynomial trajectory sampled directly by the motion point
+// interpolator. Built from an iarc7_motion::PolynomialTrajectory message,
+// each segment keeps the position polynomial of every axis along with its
+// first two derivatives so a sample is a handful of Horner evaluations.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_POLYNOMIAL_TRAJECTORY_HPP_
+#define IARC7_MOTION_POLYNOMIAL_TRAJECTORY_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include "iarc7_motion/PolynomialTrajectory.h"
+
+#include "iarc7_motion/Polynomial.hpp"
+#include "iarc7_motion/TrajectorySample.hpp"
+
+namespace Iarc7Motion
+{
+
+class PolynomialTrajectory
+{
+public:
+    PolynomialTrajectory() = default;
+
+    // Converts message, returns false and leaves the trajectory empty if
+    // the message is not a valid trajectory: it must have at least one
+    // segment, segment start times must be increasing, durations must be
+    // positive, and every polynomial must have between 1 and
+    // Polynomial::kMaxCoefficients coefficients (yaw rate may be empty).
+    bool __attribute__((warn_unused_result)) fromMessage(
+            const iarc7_motion::PolynomialTrajectory& message)
+    {
+        segments_.clear();
+
+        if (message.segments.empty()) {
+            ROS_ERROR("PolynomialTrajectory has no segments");
+            return false;
+        }
+
+        segments_.reserve(message.segments.size());
+        for (size_t i = 0; i < message.segments.size(); i++) {
+            const iarc7_motion::PolynomialTrajectorySegment& segment
+                = message.segments[i];
+
+            const std::vector<double>* coefficients[3] = {&segment.x,
+                                                          &segment.y,
+                                                          &segment.z};
+            Polynomial positions[3];
+            for (int axis = 0; axis < 3; axis++) {
+                if (!positions[axis].setCoefficients(coefficients[axis]->data(),
+                                                     coefficients[axis]->size())) {
+                    ROS_ERROR("PolynomialTrajectory segment %lu has %lu coefficients "
+                              "on axis %d, must have 1 to %d",
+                              static_cast<unsigned long>(i),
+                              static_cast<unsigned long>(coefficients[axis]->size()),
+                              axis,
+                              Polynomial::kMaxCoefficients);
+                    segments_.clear();
+                    return false;
+                }
+            }
+
+            // Default polynomial is zero
+            Polynomial yaw_rate;
+            if (!segment.yaw_rate.empty()
+                    && !yaw_rate.setCoefficients(segment.yaw_rate.data(),
+                                                 segment.yaw_rate.size())) {
+                ROS_ERROR("PolynomialTrajectory segment %lu has %lu yaw rate "
+                          "coefficients, must have at most %d",
+                          static_cast<unsigned long>(i),
+                          static_cast<unsigned long>(segment.yaw_rate.size()),
+                          Polynomial::kMaxCoefficients);
+                segments_.clear();
+                return false;
+            }
+
+            const int64_t start_ns = segment.start_time.toNSec();
+            if (!(segment.duration > 0.0)
+                    || !appendSegment(start_ns,
+                                      start_ns + std::llround(segment.duration * 1e9),
+                                      positions,
+                                      yaw_rate)) {
+                ROS_ERROR("PolynomialTrajectory segment %lu has duration %f or "
+                          "starts before the one before it",
+                          static_cast<unsigned long>(i),
+                          segment.duration);
+                segments_.clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Adds a segment from start_ns to end_ns following positions, the
+    // position polynomial of each axis in seconds since start_ns, and
+    // yaw_rate. Returns false and leaves the trajectory unchanged if the
+    // segment does not start after the last one or does not end after it
+    // starts.
+    bool __attribute__((warn_unused_result)) appendSegment(
+            int64_t start_ns,
+            int64_t end_ns,
+            const Polynomial positions[3],
+            const Polynomial& yaw_rate)
+    {
+        if (end_ns <= start_ns
+                || (!segments_.empty() && start_ns <= segments_.back().start_ns)) {
+            return false;
+        }
+
+        Segment segment;
+        segment.start_ns = start_ns;
+        segment.end_ns = end_ns;
+        for (int axis = 0; axis < 3; axis++) {
+            segment.polynomials[TrajectorySample::kPositionX + axis] = positions[axis];
+            differentiate(positions[axis],
+                          segment.polynomials[TrajectorySample::kVelocityX + axis]);
+            differentiate(segment.polynomials[TrajectorySample::kVelocityX + axis],
+                          segment.polynomials[TrajectorySample::kAccelX + axis]);
+        }
+        segment.polynomials[TrajectorySample::kYawRate] = yaw_rate;
+
+        segments_.push_back(segment);
+        return true;
+    }
+
+    void clear()
+    {
+        segments_.clear();
+    }
+
+    bool empty() const
+    {
+        return segments_.empty();
+    }
+
+    // Start of the first segment in nanoseconds
+    int64_t startNs() const
+    {
+        ROS_ASSERT(!segments_.empty());
+        return segments_.front().start_ns;
+    }
+
+    // End of the last segment in nanoseconds
+    int64_t endNs() const
+    {
+        ROS_ASSERT(!segments_.empty());
+        return segments_.back().end_ns;
+    }
+
+    // Samples the trajectory at time_ns. Each segment is followed until the
+    // next one starts, or until its end if that comes first, after which
+    // the targets at its end are held the same as the last point of a dense
+    // plan. Returns false if time_ns is before the first segment.
+    bool sample(int64_t time_ns, TrajectorySample& sample) const
+    {
+        size_t segment = 0;
+        return this->sample(time_ns, sample, segment);
+    }
+
+    // Same as sample, starting from segment, the index of the segment the
+    // last sample was in, which is then set to the one this sample is in.
+    // Sampling increasing times finds each segment in O(1). Any segment
+    // works, a wrong one only falls back to searching every segment.
+    bool sample(int64_t time_ns, TrajectorySample& sample, size_t& segment) const
+    {
+        if (segments_.empty() || time_ns < segments_.front().start_ns) {
+            return false;
+        }
+
+        if (!(segment < segments_.size() && segments_[segment].start_ns <= time_ns)) {
+            segment = 0;
+        }
+
+        // Next segment is usually the one, otherwise search the rest
+        if (!inSegment(segment, time_ns) && !inSegment(++segment, time_ns)) {
+            auto next = std::upper_bound(
+                    segments_.begin() + segment,
+                    segments_.end(),
+                    time_ns,
+                    [](int64_t time, const Segment& segment) {
+                        return time < segment.start_ns;
+                    });
+            segment = std::prev(next) - segments_.begin();
+        }
+
+        const Segment& current = segments_[segment];
+        const double t = (std::min(time_ns, current.end_ns) - current.start_ns) * 1e-9;
+        for (int i = 0; i < TrajectorySample::kSize; i++) {
+            sample.values[i] = current.polynomials[i](t);
+        }
+        sample.stamp_ns = time_ns;
+        return true;
+    }
+
+private:
+    struct Segment
+    {
+        int64_t start_ns = 0;
+        int64_t end_ns = 0;
+
+        // Polynomials of seconds since start for each field of a sample
+        Polynomial polynomials[TrajectorySample::kSize];
+    };
+
+    // True if segment is followed at time_ns, which is not before its start
+    bool inSegment(size_t segment, int64_t time_ns) const
+    {
+        return segment + 1 >= segments_.size()
+            || time_ns < segments_[segment + 1].start_ns;
+    }
+
+    // Sets result to the derivative of polynomial
+    static void differentiate(const Polynomial& polynomial, Polynomial& result)
+    {
+        double derivative[Polynomial::kMaxCoefficients] = {0.0};
+        const int order = polynomial.size() - 1;
+        for (int i = 0; i < order; i++) {
+            derivative[i] = polynomial.data()[i] * (order - i);
+        }
+
+        // A constant polynomial is one coefficient, always fits
+        const bool set = result.setCoefficients(derivative, std::max(order, 1));
+        ROS_ASSERT(set);
+    }
+
+    std::vector<Segment> segments_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_POLYNOMIAL_TRAJECTORY_HPP_
@@ -10,6 +10,8 @@
 #ifndef QUAD_VELOCITY_CONTROLLER_H
 #define QUAD_VELOCITY_CONTROLLER_H
 
+#include <memory>
+
 #include <ros/ros.h>
 
 //Bad Header
@@ -21,21 +23,20 @@
 #pragma GCC diagnostic pop
 //End Bad Header
 
+#include "iarc7_motion/LatencyHistogram.hpp"
+#include "iarc7_motion/LatencyMonitor.hpp"
 #include "iarc7_motion/PidController.hpp"
-#include "iarc7_motion/ThrustModel.hpp"
-#include "ros_utils/LinearMsgInterpolator.hpp"
-#include "ros_utils/SafeTransformWrapper.hpp"
+#include "iarc7_motion/StateInterpolator.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
+#include "iarc7_motion/StaticThrustModel.hpp"
+#include "iarc7_motion/ThrustModelEstimator.hpp"
 
-#include "geometry_msgs/AccelWithCovarianceStamped.h"
 #include "geometry_msgs/Transform.h"
-#include "geometry_msgs/TransformStamped.h"
 #include "geometry_msgs/TwistStamped.h"
 #include "geometry_msgs/Vector3.h"
 #include "geometry_msgs/Vector3Stamped.h"
-#include "iarc7_msgs/Float64Stamped.h"
 #include "iarc7_msgs/OrientationThrottleStamped.h"
 #include "iarc7_msgs/MotionPointStamped.h"
-#include "nav_msgs/Odometry.h"
 #include "std_msgs/Float32.h"
 
 namespace Iarc7Motion
@@ -52,10 +53,8 @@ public:
                            double roll_pid_settings[6],
                            double (&position_p)[3],
                            double yaw_p,
-                           const ThrustModel& thrust_model,
+                           const VerticalThrustModel& thrust_model,
                            const ThrustModel& thrust_model_side,
-                           const ros::Duration& battery_timeout,
-                           ros::NodeHandle& nh,
                            ros::NodeHandle& private_nh);
 
     ~QuadVelocityController() = default;
@@ -67,32 +66,56 @@ public:
     // Set a target velocity for the PID loops
     void setTargetVelocity(iarc7_msgs::MotionPointStamped motion_point);
 
-    // Use a new thrust model
-    void setThrustModel(const ThrustModel& thrust_model);
+    // Use a new thrust model, takes effect on the next update. Safe to
+    // call from any thread while update is running.
+    void setThrustModel(const VerticalThrustModel& thrust_model);
+
+    // Vertical thrust model in use, including the correction learned in
+    // flight when thrust model adaptation is enabled. A model set since
+    // the last update is returned in place of the current one.
+    VerticalThrustModel getThrustModel() const;
 
     // Require checking of the returned value.
-    // Used to update all PID loops according to a time delta that is passed in.
+    // Used to update all PID loops with the state at state.stamp.
     // Return the uav_command it wants sent to the flight controller.
     bool __attribute__((warn_unused_result)) update(
-        const ros::Time& time,
+        const StateSnapshot& state,
         iarc7_msgs::OrientationThrottleStamped& uav_command,
         bool xy_passthrough_mode=false,
         double a_x=0,
         double a_y=0);
 
-    /// Waits until this object is ready to begin normal operation
-    bool __attribute__((warn_unused_result)) waitUntilReady();
+    /// Waits until this object is ready to begin normal operation, with
+    /// state_interpolator already ready
+    bool __attribute__((warn_unused_result)) waitUntilReady(
+        const StateInterpolator& state_interpolator);
 
     /// Prepares this controller as appropriate for taking over control from another controller
     bool __attribute__((warn_unused_result)) prepareForTakeover();
 
+    /// Reports the time each stage of update takes through monitor
+    void addLatencyStages(LatencyMonitor& monitor) const;
+
 private:
     /// Looks at setpoint_ and sets our pid controller setpoints accordinly
     /// based on our current yaw
-    void updatePidSetpoints(double current_yaw, const Eigen::VectorXd& odometry);
+    void updatePidSetpoints(double current_yaw, const OdometryVector& odometry);
 
     double yawFromQuaternion(const geometry_msgs::Quaternion& rotation);
 
+    /// Copy of thrust_model with the correction learned in flight applied
+    /// when thrust model adaptation is enabled
+    VerticalThrustModel withLearnedCorrection(
+            const VerticalThrustModel& thrust_model) const;
+
+    /// Feeds the thrust model estimator with this tick's measured
+    /// acceleration and commanded voltage, and applies its correction
+    void updateThrustModelEstimate(const ros::Time& time,
+                                   const tf2::Vector3& accel,
+                                   double col_height,
+                                   double commanded_voltage,
+                                   bool thrust_saturated);
+
     static void commandForAccel(const Eigen::Vector3d& accel,
                                           double& pitch,
                                           double& roll,
@@ -105,13 +128,21 @@ private:
     PidController vx_pid_;
     PidController vy_pid_;
 
-    ThrustModel thrust_model_;
-    ThrustModel thrust_model_front_;
-    ThrustModel thrust_model_back_;
-    ThrustModel thrust_model_left_;
-    ThrustModel thrust_model_right_;
+    VerticalThrustModel thrust_model_;
 
-    ros_utils::SafeTransformWrapper transform_wrapper_;
+    // Model installed by setThrustModel, swapped in atomically at the
+    // start of update. Models share their tables, so this holds a pointer
+    // and a start thrust rather than a copy of the tables.
+    std::shared_ptr<const VerticalThrustModel> pending_thrust_model_;
+
+    // The 6dof mixer's side motors share one model, each keeping its own
+    // start thrust. Ordered front, back, left, right.
+    ThrustModel thrust_model_side_;
+    double side_start_thrusts_[4];
+
+    // Fits a correction to the vertical thrust model in flight
+    const bool thrust_model_adaptation_enabled_;
+    ThrustModelEstimator thrust_model_estimator_;
 
     // The current setpoint
     iarc7_msgs::MotionPointStamped setpoint_;
@@ -128,25 +159,6 @@ private:
     // Last time an update was successful
     ros::Time last_update_time_;
 
-    // Max allowed timeout waiting for first velocity and transform
-    const ros::Duration startup_timeout_;
-
-    // Max allowed timeout waiting for velocities and transforms
-    const ros::Duration update_timeout_;
-
-    ros_utils::LinearMsgInterpolator<
-        geometry_msgs::AccelWithCovarianceStamped,
-        tf2::Vector3>
-            accel_interpolator_;
-    ros_utils::LinearMsgInterpolator<
-        iarc7_msgs::Float64Stamped,
-        double>
-            battery_interpolator_;
-    ros_utils::LinearMsgInterpolator<
-        nav_msgs::Odometry,
-        Eigen::VectorXd>
-            odom_interpolator_;
-
     // Min allowed requested thrust in m/s^2
     double min_thrust_;
 
@@ -168,6 +180,15 @@ private:
 
     // Flag for whether or not level flight is active
     bool level_flight_active_;
+
+    // Time taken by the whole of update and by each of its stages
+    struct StageLatencies
+    {
+        LatencyHistogram update;
+        LatencyHistogram pid;
+        LatencyHistogram thrust_model;
+    };
+    StageLatencies latencies_;
 };
 
 }
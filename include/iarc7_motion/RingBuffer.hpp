@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Ring Buffer
+//
+// Fixed capacity double ended queue over preallocated storage. Removing
+// elements from either end is O(1) and never moves the other elements,
+// and elements are copy assigned into slots that already exist, so once
+// constructed the buffer does not allocate.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_RING_BUFFER_HPP_
+#define IARC7_MOTION_RING_BUFFER_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <ros/ros.h>
+
+namespace Iarc7Motion
+{
+
+template <class T>
+class RingBuffer
+{
+public:
+    RingBuffer() = default;
+
+    explicit RingBuffer(size_t capacity)
+        : slots_(capacity)
+    {
+    }
+
+    // Reallocates the storage, dropping all elements
+    void setCapacity(size_t capacity)
+    {
+        slots_.assign(capacity, T());
+        head_ = 0;
+        size_ = 0;
+    }
+
+    size_t capacity() const
+    {
+        return slots_.size();
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    bool full() const
+    {
+        return size_ == slots_.size();
+    }
+
+    // Index 0 is the front of the queue
+    T& operator[](size_t i)
+    {
+        ROS_ASSERT(i < size_);
+        return slots_[slot(i)];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        ROS_ASSERT(i < size_);
+        return slots_[slot(i)];
+    }
+
+    T& front()
+    {
+        return (*this)[0];
+    }
+
+    const T& front() const
+    {
+        return (*this)[0];
+    }
+
+    T& back()
+    {
+        return (*this)[size_ - 1];
+    }
+
+    const T& back() const
+    {
+        return (*this)[size_ - 1];
+    }
+
+    // Returns false and leaves the buffer unchanged if it is full
+    bool __attribute__((warn_unused_result)) push_back(const T& value)
+    {
+        if (full()) {
+            return false;
+        }
+
+        slots_[slot(size_)] = value;
+        size_++;
+        return true;
+    }
+
+    void pop_back()
+    {
+        ROS_ASSERT(size_ > 0);
+        size_--;
+    }
+
+    // Removes count elements from the front
+    void pop_front(size_t count = 1)
+    {
+        ROS_ASSERT(count <= size_);
+        head_ = slot(count);
+        size_ -= count;
+    }
+
+    // Removes elements from the back until there are at most size left
+    void truncate(size_t size)
+    {
+        if (size < size_) {
+            size_ = size;
+        }
+    }
+
+    void clear()
+    {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    // Index of the first element for which less(element, value) is false,
+    // or size() if there is none. Same as std::lower_bound, the elements
+    // must be partitioned by less.
+    template <class Value, class Less>
+    size_t lowerBound(const Value& value, Less less) const
+    {
+        size_t first = 0;
+        size_t count = size_;
+        while (count > 0) {
+            const size_t step = count / 2;
+            if (less((*this)[first + step], value)) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+private:
+    // Storage slot of the element at index i
+    size_t slot(size_t i) const
+    {
+        const size_t s = head_ + i;
+        return s >= slots_.size() ? s - slots_.size() : s;
+    }
+
+    std::vector<T> slots_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_RING_BUFFER_HPP_
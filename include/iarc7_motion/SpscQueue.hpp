@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Single Producer Single Consumer Queue
+//
+// Fixed capacity queue for handing values from one thread to another.
+// push and pop are wait free: each is a bounded number of steps and never
+// takes a lock, so neither thread can be stalled by the other. Only one
+// thread may push and only one thread may pop.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_SPSC_QUEUE_HPP_
+#define IARC7_MOTION_SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace Iarc7Motion
+{
+
+template <class T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 1, "SpscQueue must hold at least one value");
+
+public:
+    SpscQueue() = default;
+
+    SpscQueue(const SpscQueue& rhs) = delete;
+    SpscQueue& operator=(const SpscQueue& rhs) = delete;
+
+    // Producer only. Returns false and leaves the queue unchanged if it
+    // is full.
+    bool __attribute__((warn_unused_result)) push(T value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+        if (next == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty. The slot is
+    // cleared so the queue does not keep the value alive.
+    bool pop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(slots_[head]);
+        slots_[head] = T();
+        head_.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot when called while the other thread is running
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire)
+            == tail_.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    // One slot is always left empty to tell a full queue from an empty one
+    static constexpr size_t kSlots = Capacity + 1;
+
+    // Keeps the indices on separate cache lines so the two threads do not
+    // keep invalidating each other's line
+    static constexpr size_t kCacheLineSize = 64;
+
+    static size_t increment(size_t index)
+    {
+        return index + 1 == kSlots ? 0 : index + 1;
+    }
+
+    T slots_[kSlots];
+
+    // Next slot to pop, written by the consumer
+    std::atomic<size_t> head_{0};
+    char head_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+
+    // Next slot to push, written by the producer
+    std::atomic<size_t> tail_{0};
+    char tail_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_SPSC_QUEUE_HPP_
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// State Interpolator
+//
+// Subscribes to the state estimates the controllers need and interpolates
+// all of them, along with the transforms, to the time of each control
+// update as a StateSnapshot. The estimates are received on a thread of
+// its own, so they never delay the control loop.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef STATE_INTERPOLATOR_HPP
+#define STATE_INTERPOLATOR_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+#include "iarc7_motion/LatencyHistogram.hpp"
+#include "iarc7_motion/LatencyMonitor.hpp"
+#include "iarc7_motion/LockedCallbackQueue.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
+#include "ros_utils/LinearMsgInterpolator.hpp"
+#include "ros_utils/SafeTransformWrapper.hpp"
+
+#include "geometry_msgs/AccelWithCovarianceStamped.h"
+#include "geometry_msgs/TransformStamped.h"
+#include "iarc7_msgs/Float64Stamped.h"
+#include "nav_msgs/Odometry.h"
+
+namespace Iarc7Motion
+{
+
+class StateInterpolator
+{
+public:
+    StateInterpolator() = delete;
+
+    StateInterpolator(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+
+    ~StateInterpolator() = default;
+
+    // Don't allow the copy constructor or assignment.
+    StateInterpolator(const StateInterpolator& rhs) = delete;
+    StateInterpolator& operator=(const StateInterpolator& rhs) = delete;
+
+    /// Waits until every estimate and transform has been received
+    bool __attribute__((warn_unused_result)) waitUntilReady();
+
+    /// Time of the newest estimate received, valid once ready
+    ros::Time getLastUpdateTime() const;
+
+    /// Fills snapshot with the state at time, waiting up to the update
+    /// timeout for estimates that haven't reached time yet. Returns false
+    /// if any of them can't be found, snapshot is then partly filled.
+    bool __attribute__((warn_unused_result)) getSnapshot(
+        const ros::Time& time,
+        StateSnapshot& snapshot);
+
+    /// Reports the time each lookup in getSnapshot takes through monitor
+    void addLatencyStages(LatencyMonitor& monitor) const;
+
+private:
+    // Copy of nh whose subscriptions add their callbacks to queue
+    static ros::NodeHandle callbackNodeHandle(const ros::NodeHandle& nh,
+                                              ros::CallbackQueueInterface& queue);
+
+    // Looks up the transform from parent to child at time into transform
+    bool __attribute__((warn_unused_result)) getTransform(
+        const std::string& parent,
+        const std::string& child,
+        const ros::Time& time,
+        geometry_msgs::Transform& transform);
+
+    ros_utils::SafeTransformWrapper transform_wrapper_;
+
+    // Filled by each transform lookup, kept so its frame ids aren't
+    // reallocated every update
+    geometry_msgs::TransformStamped transform_stamped_;
+
+    // Max allowed timeout waiting for first estimates and transforms
+    const ros::Duration startup_timeout_;
+
+    // Max allowed timeout waiting for estimates and transforms
+    const ros::Duration update_timeout_;
+
+    // Estimates are received on spinner_'s thread. Each interpolator's
+    // callbacks run with mutex_ held, which is also held while reading
+    // them, and callback_called_ is notified after each one.
+    ros::CallbackQueue callback_queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable callback_called_;
+    LockedCallbackQueue accel_queue_;
+    LockedCallbackQueue battery_queue_;
+    LockedCallbackQueue odom_queue_;
+    ros::NodeHandle accel_nh_;
+    ros::NodeHandle battery_nh_;
+    ros::NodeHandle odom_nh_;
+
+    ros_utils::LinearMsgInterpolator<
+        geometry_msgs::AccelWithCovarianceStamped,
+        tf2::Vector3>
+            accel_interpolator_;
+    ros_utils::LinearMsgInterpolator<
+        iarc7_msgs::Float64Stamped,
+        double>
+            battery_interpolator_;
+    ros_utils::LinearMsgInterpolator<
+        nav_msgs::Odometry,
+        OdometryVector>
+            odom_interpolator_;
+
+    // Stopped before the interpolators it calls into are destroyed
+    ros::AsyncSpinner spinner_;
+
+    // Time taken by the whole of getSnapshot and by each of its lookups
+    struct StageLatencies
+    {
+        LatencyHistogram snapshot;
+        LatencyHistogram odometry;
+        LatencyHistogram battery;
+        LatencyHistogram accel;
+        LatencyHistogram transforms;
+    };
+    StageLatencies latencies_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // STATE_INTERPOLATOR_HPP
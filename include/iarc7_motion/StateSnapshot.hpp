@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// State Snapshot
+//
+// Everything the controllers know about the quad at the time of a control
+// update, gathered once per update by StateInterpolator so every
+// controller works from the same view of the state.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef STATE_SNAPSHOT_HPP
+#define STATE_SNAPSHOT_HPP
+
+#include <ros/ros.h>
+
+//Bad Header
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+//End Bad Header
+
+#include "tf2/LinearMath/Vector3.h"
+
+#include "geometry_msgs/Transform.h"
+#include "nav_msgs/Odometry.h"
+
+namespace Iarc7Motion
+{
+
+// Velocity then position in the map frame, x, y, z each. Fixed size so
+// converting, buffering and interpolating odometry never allocates, and
+// unaligned so it can be stored in std containers without an aligned
+// allocator.
+typedef Eigen::Matrix<double, 6, 1, Eigen::DontAlign> OdometryVector;
+
+inline OdometryVector odometryFromMessage(const nav_msgs::Odometry& msg)
+{
+    OdometryVector v;
+    v << msg.twist.twist.linear.x,
+         msg.twist.twist.linear.y,
+         msg.twist.twist.linear.z,
+         msg.pose.pose.position.x,
+         msg.pose.pose.position.y,
+         msg.pose.pose.position.z;
+    return v;
+}
+
+struct StateSnapshot
+{
+    // Time everything is interpolated to
+    ros::Time stamp;
+
+    // Velocity and position from odometry/filtered
+    OdometryVector odometry = OdometryVector::Zero();
+
+    // Acceleration in the map frame from accel/filtered (m/s^2)
+    tf2::Vector3 accel;
+
+    // Motor battery voltage (V)
+    double battery_voltage = 0.0;
+
+    // Rotation of the quad relative to level_quad
+    geometry_msgs::Transform level_quad_to_quad;
+
+    // Position of the quad's center of lift in the map frame
+    geometry_msgs::Transform map_to_center_of_lift;
+
+    // Position and heading of the quad in the map frame
+    geometry_msgs::Transform map_to_level_quad;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // STATE_SNAPSHOT_HPP
@@ -0,0 +1,293 @@
+#ifndef IARC7_MOTION_STATIC_THRUST_MODEL_HPP_
+#define IARC7_MOTION_STATIC_THRUST_MODEL_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string>
+#include <type_traits>
+
+#include <ros/ros.h>
+
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/ThrustModelFile.hpp"
+
+#ifdef IARC7_MOTION_STATIC_THRUST_MODEL
+// Generated at configure time, see CMakeLists.txt
+#include "iarc7_motion/StaticThrustModelData.hpp"
+#endif
+
+namespace Iarc7Motion {
+
+// Thrust model whose data is baked in at compile time. Data is a struct
+// generated by scripts/thrust_model_v2/Dynamic/convert_model_yaml_to_constexpr.py
+// holding the model as constexpr tables.
+//
+// Behaves like ThrustModel without a lookup table, but the mapping
+// dimensions are compile time constants so the scan over the voltage_to_jerk
+// rows can be unrolled and vectorized. Only model_mass is read at runtime.
+template <class Data>
+class StaticThrustModel
+{
+  public:
+    static constexpr int num_coefficients = Data::num_coefficients;
+    static constexpr int num_thrust_points = Data::num_thrust_points;
+    static constexpr int num_voltage_points = Data::num_voltage_points;
+    static constexpr int num_height_points = Data::num_height_points;
+
+    static_assert(num_coefficients >= 1,
+                  "thrust_to_voltage must have at least one coefficient");
+    static_assert(num_thrust_points >= 2 && num_voltage_points >= 2,
+                  "voltage_to_jerk mapping must be at least 2x2");
+    static_assert(num_height_points != 1,
+                  "ground effect needs at least two heights");
+
+    double response_lag = Data::response_lag;
+
+    StaticThrustModel() {
+
+    }
+
+    StaticThrustModel(ros::NodeHandle& nh, std::string model_name) {
+        loadModel(nh, model_name);
+    }
+
+    void loadModel(ros::NodeHandle& nh, std::string model_name) {
+        double model_mass;
+        ROS_ASSERT(nh.getParam("model_mass", model_mass));
+        loadModel(model_mass);
+
+        // The model on the parameter server is unused, but a mismatch means
+        // the node was built for another platform
+        double param_response_lag;
+        if (nh.getParam(model_name + "/response_lag", param_response_lag)
+                && param_response_lag != response_lag) {
+            ROS_WARN("Thrust model %s on the parameter server differs from "
+                     "the one compiled into this node, using the compiled model",
+                     model_name.c_str());
+        } else {
+            ROS_INFO("Using thrust model %s compiled into this node",
+                     model_name.c_str());
+        }
+    }
+
+    void loadModel(double model_mass) {
+        this->model_mass = model_mass;
+        start_thrust = 0.0;
+        initialized = true;
+    }
+
+    // Model in the layout of a compiled thrust model file, the arrays
+    // point into the constexpr tables
+    static ThrustModelFile::Contents getContents() {
+        ThrustModelFile::Contents contents;
+        contents.response_lag = Data::response_lag;
+        contents.small_thrust_epsilon = Data::small_thrust_epsilon;
+        contents.thrust_min = Data::thrust_min;
+        contents.thrust_max = Data::thrust_max;
+        contents.voltage_min = Data::voltage_min;
+        contents.voltage_max = Data::voltage_max;
+        contents.num_coefficients = num_coefficients;
+        contents.num_thrust_points = num_thrust_points;
+        contents.num_voltage_points = num_voltage_points;
+        contents.thrust_to_voltage = thrust_to_voltage_.data();
+        contents.start_thrusts = start_thrusts_.data();
+        contents.voltages = voltages_.data();
+        contents.end_thrusts = end_thrusts_.data();
+        contents.num_height_points = num_height_points;
+        contents.height_min = Data::height_min;
+        contents.height_max = Data::height_max;
+        contents.thrust_ratios = num_height_points > 0 ? thrust_ratios_.data() : nullptr;
+        return contents;
+    }
+
+    // Same as ThrustModel::setVoltageCorrection
+    void setVoltageCorrection(double scale, double offset) {
+        voltage_scale = scale;
+        voltage_offset = offset;
+    }
+
+    double getVoltageScale() const {
+        return voltage_scale;
+    }
+
+    double getVoltageOffset() const {
+        return voltage_offset;
+    }
+
+    double thrustForAcceleration(double acceleration, int num_props) const {
+        ROS_ASSERT(initialized);
+        return model_mass * (acceleration / 9.81) / static_cast<double>(num_props);
+    }
+
+    // Same as ThrustModelData::groundEffectRatio
+    static double groundEffectRatio(double height) {
+        return interpolateThrustRatio(
+                height,
+                std::integral_constant<bool, (num_height_points > 0)>());
+    }
+
+    double voltageFromThrust(double acceleration, int num_props, double height) {
+        ROS_ASSERT(initialized);
+
+        double desired_thrust = thrustForAcceleration(acceleration, num_props);
+
+        if(std::abs(desired_thrust) < small_thrust_epsilon_) {
+            start_thrust = desired_thrust;
+            return 0.0;
+        }
+
+        const double ratio = groundEffectRatio(height);
+
+        if(std::abs(desired_thrust - start_thrust) < small_thrust_epsilon_){
+            start_thrust = desired_thrust;
+            return get_voltage_for_thrust(desired_thrust / ratio);
+        }
+
+        double voltage = scanVoltageFromThrust(start_thrust / ratio,
+                                               desired_thrust / ratio);
+
+        start_thrust = desired_thrust;
+        return correctVoltage(voltage);
+    }
+
+    double get_voltage_for_thrust(double thrust) const {
+        double sum = thrust_to_voltage_[0];
+        for (int i = 1; i < num_coefficients; i++) {
+            sum = sum * thrust + thrust_to_voltage_[i];
+        }
+        return correctVoltage(sum);
+    }
+
+  private:
+    static constexpr double small_thrust_epsilon_ = Data::small_thrust_epsilon;
+    static constexpr double voltage_min_ = Data::voltage_min;
+    static constexpr double voltage_max_ = Data::voltage_max;
+    static constexpr double start_thrust_increment_
+        = (Data::thrust_max - Data::thrust_min) / (num_thrust_points - 1);
+
+    static constexpr std::array<double, num_coefficients> thrust_to_voltage_
+        = Data::thrust_to_voltage();
+    static constexpr std::array<double, num_thrust_points> start_thrusts_
+        = Data::start_thrusts();
+    static constexpr std::array<double, num_thrust_points * num_voltage_points> voltages_
+        = Data::voltages();
+    static constexpr std::array<double, num_thrust_points * num_voltage_points> end_thrusts_
+        = Data::end_thrusts();
+    static constexpr std::array<double, num_height_points> thrust_ratios_
+        = Data::thrust_ratios();
+
+    double model_mass = 0.0;
+    double start_thrust = 0.0;
+    bool initialized = false;
+
+    double voltage_scale = 1.0;
+    double voltage_offset = 0.0;
+
+    double correctVoltage(double voltage) const {
+        return voltage > 0.0
+             ? std::max(voltage_scale * voltage + voltage_offset, 0.0)
+             : voltage;
+    }
+
+    // Without ground effect there is no table to index
+    static double interpolateThrustRatio(double, std::false_type) {
+        return 1.0;
+    }
+
+    static double interpolateThrustRatio(double height, std::true_type) {
+        constexpr double height_step = (Data::height_max - Data::height_min)
+                                     / (num_height_points - 1);
+        double index = (height - Data::height_min) / height_step;
+        if (!(index > 0.0)) {
+            return thrust_ratios_.front();
+        }
+        if (index >= num_height_points - 1) {
+            return thrust_ratios_.back();
+        }
+
+        int bottom = static_cast<int>(index);
+        double fraction = index - bottom;
+        return thrust_ratios_[bottom]
+             + fraction * (thrust_ratios_[bottom+1] - thrust_ratios_[bottom]);
+    }
+
+    // Same scan as ThrustModelData::scanVoltageFromThrust. The whole
+    // interpolated row is computed first in a fixed length loop, then
+    // searched for the first end thrust reaching desired_thrust.
+    static double scanVoltageFromThrust(double start_thrust,
+                                        double desired_thrust) {
+        int bottom_thrust_index = std::min(std::max(static_cast<int>(std::floor(start_thrust / start_thrust_increment_)), 0), num_thrust_points-2);
+
+        const double bottom_start_thrust = start_thrusts_[bottom_thrust_index];
+        const double top_start_thrust = start_thrusts_[bottom_thrust_index + 1];
+        const double* bottom_thrusts = &end_thrusts_[bottom_thrust_index * num_voltage_points];
+        const double* top_thrusts = bottom_thrusts + num_voltage_points;
+
+        start_thrust = std::min(std::max(start_thrust, start_thrusts_.front()),
+                                start_thrusts_.back());
+        double fraction = (start_thrust - bottom_start_thrust)
+                        / (top_start_thrust - bottom_start_thrust);
+
+        double final_thrusts[num_voltage_points];
+        for (int i = 0; i < num_voltage_points; i++) {
+            final_thrusts[i] = bottom_thrusts[i]
+                             + fraction * (top_thrusts[i] - bottom_thrusts[i]);
+        }
+
+        if (final_thrusts[0] >= desired_thrust) {
+            return 0.0;
+        }
+
+        int i = 1;
+        while (i < num_voltage_points && final_thrusts[i] < desired_thrust) {
+            i++;
+        }
+
+        // If no voltage reaches the desired thrust use the maximum
+        if (i == num_voltage_points) {
+            return voltage_max_;
+        }
+
+        double voltage = voltages_[i-1]
+                       + (desired_thrust - final_thrusts[i-1])
+                       * (voltages_[i] - voltages_[i-1])
+                       / (final_thrusts[i] - final_thrusts[i-1]);
+        return std::min(std::max(voltage, voltage_min_), voltage_max_);
+    }
+};
+
+// Static data members are odr-used above and need definitions until C++17
+template <class Data> constexpr int StaticThrustModel<Data>::num_coefficients;
+template <class Data> constexpr int StaticThrustModel<Data>::num_thrust_points;
+template <class Data> constexpr int StaticThrustModel<Data>::num_voltage_points;
+template <class Data> constexpr int StaticThrustModel<Data>::num_height_points;
+template <class Data> constexpr double StaticThrustModel<Data>::small_thrust_epsilon_;
+template <class Data> constexpr double StaticThrustModel<Data>::voltage_min_;
+template <class Data> constexpr double StaticThrustModel<Data>::voltage_max_;
+template <class Data> constexpr double StaticThrustModel<Data>::start_thrust_increment_;
+template <class Data> constexpr std::array<double, StaticThrustModel<Data>::num_coefficients>
+    StaticThrustModel<Data>::thrust_to_voltage_;
+template <class Data> constexpr std::array<double, StaticThrustModel<Data>::num_thrust_points>
+    StaticThrustModel<Data>::start_thrusts_;
+template <class Data> constexpr std::array<double, StaticThrustModel<Data>::num_thrust_points
+                                                 * StaticThrustModel<Data>::num_voltage_points>
+    StaticThrustModel<Data>::voltages_;
+template <class Data> constexpr std::array<double, StaticThrustModel<Data>::num_thrust_points
+                                                 * StaticThrustModel<Data>::num_voltage_points>
+    StaticThrustModel<Data>::end_thrusts_;
+template <class Data> constexpr std::array<double, StaticThrustModel<Data>::num_height_points>
+    StaticThrustModel<Data>::thrust_ratios_;
+
+// Model used for the vertical thrust of the quad. Building with
+// -DIARC7_MOTION_STATIC_THRUST_MODEL=<platform> compiles that platform's
+// thrust model into the node, otherwise it is loaded at runtime.
+#ifdef IARC7_MOTION_STATIC_THRUST_MODEL
+using VerticalThrustModel = StaticThrustModel<StaticThrustModelData>;
+#else
+using VerticalThrustModel = ThrustModel;
+#endif
+
+}
+
+#endif // include guard
@@ -11,14 +11,13 @@
 
 #include <ros/ros.h>
 
-#include "ros_utils/LinearMsgInterpolator.hpp"
 #include "ros_utils/SafeTransformWrapper.hpp"
 
-#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
+#include "iarc7_motion/StaticThrustModel.hpp"
 
 // ROS message headers
 #include "iarc7_msgs/BoolStamped.h"
-#include "iarc7_msgs/Float64Stamped.h"
 #include "iarc7_msgs/OrientationThrottleStamped.h"
 #include "iarc7_msgs/Arm.h"
 
@@ -38,7 +37,7 @@ public:
     // Require construction with a node handle
     TakeoffController(ros::NodeHandle& nh,
                       ros::NodeHandle& private_nh,
-                      const ThrustModel& thrust_model);
+                      const VerticalThrustModel& thrust_model);
 
     ~TakeoffController() = default;
 
@@ -50,9 +49,9 @@ public:
     bool __attribute__((warn_unused_result)) prepareForTakeover(
         const ros::Time& time);
 
-    // Used to get a uav control message
+    // Used to get a uav control message for the state at state.stamp
     bool __attribute__((warn_unused_result)) update(
-        const ros::Time& time,
+        const StateSnapshot& state,
         iarc7_msgs::OrientationThrottleStamped& uav_command);
 
     /// Waits until this object is ready to begin normal operation
@@ -60,7 +59,11 @@ public:
 
     bool isDone();
 
-    const ThrustModel& getThrustModel() const;
+    const VerticalThrustModel& getThrustModel() const;
+
+    // Use a new thrust model for the next takeoff, such as one corrected
+    // in flight by QuadVelocityController
+    void setThrustModel(const VerticalThrustModel& thrust_model);
 
 private:
     // Handles incoming landing detection messages
@@ -81,7 +84,7 @@ private:
     double throttle_;
 
     // Used to hold currently desired thrust model
-    ThrustModel thrust_model_;
+    VerticalThrustModel thrust_model_;
 
     const ros::Duration post_arm_delay_;
 
@@ -96,13 +99,6 @@ private:
     // Max allowed timeout waiting for velocities and transforms
     const ros::Duration update_timeout_;
 
-    // Max allowed distance between battery messages
-    const ros::Duration battery_timeout_;
-
-    // Interpolator for battery voltage
-    ros_utils::LinearMsgInterpolator<iarc7_msgs::Float64Stamped, double>
-            battery_interpolator_;
-
     // Establishing service client used for arm request
     ros::ServiceClient uav_arm_client_;
 
@@ -1,13 +1,33 @@
 #ifndef IARC7_MOTION_THRUST_MODEL_HPP_
 #define IARC7_MOTION_THRUST_MODEL_HPP_
 
+#include <algorithm>
 #include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <ros/ros.h>
 
+#include "iarc7_motion/Polynomial.hpp"
+#include "iarc7_motion/ThrustModelFile.hpp"
+
+//Bad Header
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+//End Bad Header
+
 namespace Iarc7Motion {
 
-struct ThrustModel
+// Tables of a thrust model. Once loaded these are never modified, so one
+// instance is shared between every ThrustModel using the model, each of
+// which only holds its own motor's start thrust.
+struct ThrustModelData
 {
   public:
     double response_lag = 0.0;
@@ -25,106 +45,303 @@ struct ThrustModel
 
     bool initialized = false;
 
-    std::vector<double> thrust_to_voltage;
+    Polynomial thrust_to_voltage;
 
-    double start_thrust = 0.0f;
+    using AlignedDoubles = std::vector<double, Eigen::aligned_allocator<double>>;
 
-    struct VoltageThrust {
-        double voltage;
-        double thrust;
+    // voltage_to_jerk mapping stored as flat arrays. Row i holds the
+    // thrusts reached from mapping_start_thrusts[i] when each voltage is
+    // applied, element (i, j) lives at i*num_voltage_points + j.
+    AlignedDoubles mapping_start_thrusts;
+    AlignedDoubles mapping_voltages;
+    AlignedDoubles mapping_end_thrusts;
 
-        VoltageThrust(double voltage, double thrust)
-            : voltage(voltage),
-              thrust(thrust)
-        {
+    double start_thrust_increment;
+
+    // Dense, uniformly gridded (start thrust x desired thrust) -> voltage
+    // table compiled from the mapping by buildLookupTable. Stored row-major
+    // with one row per start thrust grid point. The desired thrust axis is
+    // measured from the zero voltage thrust of each start thrust.
+    bool lookup_table_enabled = false;
+    int lookup_table_start_points;
+    int lookup_table_desired_points;
+    double lookup_table_start_min;
+    double lookup_table_start_step;
+    double lookup_table_desired_step;
+    AlignedDoubles lookup_table;
+
+    // Ground effect, thrust_ratios[i] is the ratio of thrust at center of
+    // lift height height_min + i * height_step to thrust far from the
+    // ground at the same voltage. Empty for a model without ground effect.
+    double height_min = 0.0;
+    double height_max = 0.0;
+    double height_step = 0.0;
+    AlignedDoubles thrust_ratios;
+
+  public:
+    ThrustModelData() {
+        
+    }
+
+    ThrustModelData(ros::NodeHandle& nh, std::string model_name) {
+        loadModel(nh, model_name);
+    }
+
+    void loadModel(ros::NodeHandle& nh, std::string model_name) {
+        // Retrieve thrust model parameters
+        double model_mass;
+        ROS_ASSERT(nh.getParam("model_mass", model_mass));
+
+        // Prefer the compiled binary model if one is present and was
+        // compiled from the current yaml model, falling back to the model on
+        // the parameter server
+        std::string model_file;
+        ThrustModelFile::MappedFile mapped_model;
+        if (nh.getParam(model_name + "_file", model_file)
+            && std::ifstream(model_file).good()
+            && mapped_model.open(model_file)
+            && matchesSource(nh, model_name, model_file, mapped_model.contents())) {
+            ROS_INFO("Loading thrust model %s from %s",
+                     model_name.c_str(),
+                     model_file.c_str());
+            loadModel(mapped_model.contents(), model_mass);
+        } else {
+            XmlRpc::XmlRpcValue model;
+            ROS_ASSERT(nh.getParam(model_name, model));
+            loadModel(model, model_mass);
         }
 
-        friend std::ostream &operator<<(std::ostream &os, VoltageThrust& v) {
-            return os << "[Voltage: " << v.voltage
-                      << " Thrust: " << v.thrust
-                      << "]";
+        bool use_lookup_table;
+        nh.param("thrust_lookup_table_enabled", use_lookup_table, true);
+        if (use_lookup_table) {
+            int start_points;
+            int desired_points;
+            nh.param("thrust_lookup_table_start_points", start_points, 64);
+            nh.param("thrust_lookup_table_desired_points", desired_points, 256);
+            buildLookupTable(start_points, desired_points);
+
+            double max_error;
+            double max_error_start;
+            double max_error_desired;
+            checkLookupTable(max_error, max_error_start, max_error_desired);
+            ROS_INFO("Thrust model %s: %dx%d lookup table max deviation "
+                     "from scan is %f V (start thrust %f, desired thrust %f)",
+                     model_name.c_str(),
+                     lookup_table_start_points,
+                     lookup_table_desired_points,
+                     max_error,
+                     max_error_start,
+                     max_error_desired);
         }
-    };
-    using VoltageThrustList = std::vector<VoltageThrust>;
+    }
 
-    struct PossibleThrustFromThrust {
+    // Loads a model from a parameter tree laid out like
+    // param/thrust_models/*.yaml, without the lookup table
+    void loadModel(XmlRpc::XmlRpcValue& model, double model_mass) {
+        this->model_mass = model_mass;
 
-        double start_thrust;
-        VoltageThrustList possible_thrusts;
+        response_lag = paramToDouble(model["response_lag"]);
+        small_thrust_epsilon = paramToDouble(model["small_thrust_epsilon"]);
 
-        friend std::ostream &operator<<(std::ostream &os, PossibleThrustFromThrust& p) {
-            os << "Start thrust: " << p.start_thrust
-               << "\nPossible Thrusts: ";
-            for(auto possible_thrust : p.possible_thrusts) {
-                os << " " << possible_thrust;
+        XmlRpc::XmlRpcValue& param_thrust_to_voltage = model["thrust_to_voltage"];
+        double coefficients[Polynomial::kMaxCoefficients];
+        ROS_ASSERT(param_thrust_to_voltage.size() <= Polynomial::kMaxCoefficients);
+        for(int i = 0; i < param_thrust_to_voltage.size(); i++) {
+            coefficients[i] = paramToDouble(param_thrust_to_voltage[i]);
+        }
+        ROS_ASSERT(thrust_to_voltage.setCoefficients(coefficients,
+                                                     param_thrust_to_voltage.size()));
+
+        XmlRpc::XmlRpcValue& voltage_to_jerk = model["voltage_to_jerk"];
+        thrust_min = paramToDouble(voltage_to_jerk["thrust_min"]);
+        thrust_max = paramToDouble(voltage_to_jerk["thrust_max"]);
+        voltage_min = paramToDouble(voltage_to_jerk["voltage_min"]);
+        voltage_max = paramToDouble(voltage_to_jerk["voltage_max"]);
+
+        XmlRpc::XmlRpcValue& param_voltage_to_jerk_mapping = voltage_to_jerk["mapping"];
+        num_thrust_points = param_voltage_to_jerk_mapping.size();
+        ROS_ASSERT(num_thrust_points >= 2);
+        num_voltage_points = param_voltage_to_jerk_mapping[0][1].size();
+        ROS_ASSERT(num_voltage_points >= 2);
+
+        mapping_start_thrusts.resize(num_thrust_points);
+        mapping_voltages.resize(num_thrust_points * num_voltage_points);
+        mapping_end_thrusts.resize(num_thrust_points * num_voltage_points);
+
+        for(int i = 0; i < num_thrust_points; i++)
+        {
+            XmlRpc::XmlRpcValue& row = param_voltage_to_jerk_mapping[i];
+            ROS_ASSERT(row[1].size() == num_voltage_points);
+
+            mapping_start_thrusts[i] = paramToDouble(row[0]);
+            for(int j = 0; j < num_voltage_points; j++){
+                mapping_voltages[i * num_voltage_points + j] = paramToDouble(row[1][j][0]);
+                mapping_end_thrusts[i * num_voltage_points + j] = paramToDouble(row[1][j][1]);
             }
-            return os;
         }
-    };
 
-    using PossibleThrustList = std::vector<PossibleThrustFromThrust>;
- 
-    PossibleThrustList voltage_to_jerk_mapping;
+        thrust_ratios.clear();
+        if (model.hasMember("ground_effect")) {
+            XmlRpc::XmlRpcValue& ground_effect = model["ground_effect"];
+            height_min = paramToDouble(ground_effect["height_min"]);
+            height_max = paramToDouble(ground_effect["height_max"]);
 
-    double start_thrust_increment;
+            XmlRpc::XmlRpcValue& param_thrust_ratios = ground_effect["thrust_ratios"];
+            for (int i = 0; i < param_thrust_ratios.size(); i++) {
+                thrust_ratios.push_back(paramToDouble(param_thrust_ratios[i]));
+            }
+        }
 
-  public:
-    ThrustModel() {
-        
+        finishLoading();
     }
 
-    ThrustModel(ros::NodeHandle& nh, std::string model_name) {
-        loadModel(nh, model_name);
+    // Loads a model from a compiled thrust model file, without the lookup
+    // table
+    void loadModel(const ThrustModelFile::Contents& contents,
+                   double model_mass) {
+        this->model_mass = model_mass;
+
+        response_lag = contents.response_lag;
+        small_thrust_epsilon = contents.small_thrust_epsilon;
+        thrust_min = contents.thrust_min;
+        thrust_max = contents.thrust_max;
+        voltage_min = contents.voltage_min;
+        voltage_max = contents.voltage_max;
+        num_thrust_points = contents.num_thrust_points;
+        num_voltage_points = contents.num_voltage_points;
+        ROS_ASSERT(num_thrust_points >= 2 && num_voltage_points >= 2);
+
+        const int table_size = num_thrust_points * num_voltage_points;
+        ROS_ASSERT(thrust_to_voltage.setCoefficients(contents.thrust_to_voltage,
+                                                     contents.num_coefficients));
+        mapping_start_thrusts.assign(contents.start_thrusts,
+                                     contents.start_thrusts + num_thrust_points);
+        mapping_voltages.assign(contents.voltages,
+                                contents.voltages + table_size);
+        mapping_end_thrusts.assign(contents.end_thrusts,
+                                   contents.end_thrusts + table_size);
+
+        height_min = contents.height_min;
+        height_max = contents.height_max;
+        thrust_ratios.assign(contents.thrust_ratios,
+                             contents.thrust_ratios + contents.num_height_points);
+
+        finishLoading();
     }
 
-    void loadModel(ros::NodeHandle& nh, std::string model_name) {
-        // Retrieve thrust model parameters
-        ROS_ASSERT(nh.getParam("model_mass", model_mass));
+    // Model in the layout of a compiled thrust model file, the arrays
+    // point into this object
+    ThrustModelFile::Contents getContents() const {
+        ROS_ASSERT(initialized);
 
-        ROS_ASSERT(nh.getParam(model_name + "/response_lag",
-                                       response_lag));
-        ROS_ASSERT(nh.getParam(model_name + "/small_thrust_epsilon",
-                                       small_thrust_epsilon));
-        ROS_ASSERT(nh.getParam(model_name + "/thrust_to_voltage",
-                                       thrust_to_voltage));
-
-        ROS_ASSERT(nh.getParam(model_name + "/voltage_to_jerk/thrust_min",
-                                       thrust_min));
-        ROS_ASSERT(nh.getParam(model_name + "/voltage_to_jerk/thrust_max",
-                                       thrust_max));
-        ROS_ASSERT(nh.getParam(model_name + "/voltage_to_jerk/voltage_min",
-                                       voltage_min));
-        ROS_ASSERT(nh.getParam(model_name + "/voltage_to_jerk/voltage_max",
-                                       voltage_max));
-
-        XmlRpc::XmlRpcValue param_voltage_to_jerk_mapping;
-        ROS_ASSERT(nh.getParam(model_name + "/voltage_to_jerk/mapping",
-                               param_voltage_to_jerk_mapping));
-
-        for(int i = 0; i < param_voltage_to_jerk_mapping.size(); i++)
-        {
-            PossibleThrustFromThrust possible_thrust_mapping;
-            possible_thrust_mapping.start_thrust = static_cast<double>(param_voltage_to_jerk_mapping[i][0]);
-            for(int j = 0; j < param_voltage_to_jerk_mapping[i][1].size(); j++){
-                possible_thrust_mapping.possible_thrusts.emplace_back(
-                    static_cast<double>(param_voltage_to_jerk_mapping[i][1][j][0]),
-                    static_cast<double>(param_voltage_to_jerk_mapping[i][1][j][1]));
+        ThrustModelFile::Contents contents;
+        contents.response_lag = response_lag;
+        contents.small_thrust_epsilon = small_thrust_epsilon;
+        contents.thrust_min = thrust_min;
+        contents.thrust_max = thrust_max;
+        contents.voltage_min = voltage_min;
+        contents.voltage_max = voltage_max;
+        contents.num_coefficients = thrust_to_voltage.size();
+        contents.num_thrust_points = num_thrust_points;
+        contents.num_voltage_points = num_voltage_points;
+        contents.thrust_to_voltage = thrust_to_voltage.data();
+        contents.start_thrusts = mapping_start_thrusts.data();
+        contents.voltages = mapping_voltages.data();
+        contents.end_thrusts = mapping_end_thrusts.data();
+        contents.num_height_points = thrust_ratios.size();
+        contents.height_min = height_min;
+        contents.height_max = height_max;
+        contents.thrust_ratios = thrust_ratios.empty() ? nullptr : thrust_ratios.data();
+        return contents;
+    }
+
+    // Fills lookup_table by evaluating the scan at every grid point.
+    //
+    // The scan steps from zero to a nonzero voltage at the zero voltage
+    // thrust, which bilinear interpolation would smear across a whole cell.
+    // Measuring the desired thrust axis from that thrust puts the step on
+    // the first grid column, which holds the voltage just above the step,
+    // and tableVoltageFromThrust applies the zero voltage cutoff exactly.
+    //
+    // The desired thrust axis extends one step past the largest reachable
+    // thrust so that saturation at voltage_max is captured by the table.
+    void buildLookupTable(int start_points, int desired_points) {
+        ROS_ASSERT(initialized);
+        ROS_ASSERT(start_points >= 2);
+        ROS_ASSERT(desired_points >= 3);
+
+        lookup_table_start_points = start_points;
+        lookup_table_desired_points = desired_points;
+
+        double max_thrust_above_zero_voltage = 0.0;
+        for (int i = 0; i < num_thrust_points; i++) {
+            const double* end_thrusts = &mapping_end_thrusts[i * num_voltage_points];
+            for (int j = 1; j < num_voltage_points; j++) {
+                max_thrust_above_zero_voltage = std::max(
+                        max_thrust_above_zero_voltage,
+                        end_thrusts[j] - end_thrusts[0]);
+            }
+        }
+        ROS_ASSERT(max_thrust_above_zero_voltage > 0.0);
+
+        lookup_table_start_min = mapping_start_thrusts.front();
+        lookup_table_start_step = (mapping_start_thrusts.back()
+                                   - lookup_table_start_min)
+                                / (lookup_table_start_points - 1);
+        lookup_table_desired_step = max_thrust_above_zero_voltage
+                                  / (lookup_table_desired_points - 2);
+
+        lookup_table.resize(lookup_table_start_points
+                            * lookup_table_desired_points);
+        for (int i = 0; i < lookup_table_start_points; i++) {
+            double start = lookup_table_start_min + i * lookup_table_start_step;
+            double zero_voltage_thrust = zeroVoltageThrust(start);
+            for (int j = 0; j < lookup_table_desired_points; j++) {
+                double desired = zero_voltage_thrust
+                               + std::max(j * lookup_table_desired_step, 1e-9);
+                lookup_table[i * lookup_table_desired_points + j]
+                    = scanVoltageFromThrust(start, desired);
             }
-            voltage_to_jerk_mapping.push_back(possible_thrust_mapping);
         }
 
-        num_thrust_points = voltage_to_jerk_mapping.size();
-        num_voltage_points = voltage_to_jerk_mapping[0].possible_thrusts.size();
-        start_thrust_increment = (thrust_max - thrust_min) / (num_thrust_points-1);
+        lookup_table_enabled = true;
+    }
 
-        initialized = true;
+    // Samples the lookup table halfway between its grid points, where
+    // bilinear interpolation error is largest, and reports the largest
+    // deviation from the scan based answer.
+    void checkLookupTable(double& max_error,
+                          double& max_error_start,
+                          double& max_error_desired) const {
+        ROS_ASSERT(initialized && lookup_table_enabled);
+
+        max_error = 0.0;
+        max_error_start = lookup_table_start_min;
+        max_error_desired = 0.0;
+        for (int i = 0; i < 2 * lookup_table_start_points - 1; i++) {
+            double start = lookup_table_start_min
+                         + 0.5 * i * lookup_table_start_step;
+            double zero_voltage_thrust = zeroVoltageThrust(start);
+            for (int j = 0; j < 2 * lookup_table_desired_points - 1; j++) {
+                double desired = zero_voltage_thrust
+                               + 0.5 * j * lookup_table_desired_step;
+                double error = std::abs(
+                        tableVoltageFromThrust(start, desired)
+                      - scanVoltageFromThrust(start, desired));
+                if (error > max_error) {
+                    max_error = error;
+                    max_error_start = start;
+                    max_error_desired = desired;
+                }
+            }
+        }
     }
 
     double linearInterpolate(double x,
                              double x_i,
                              double x_f,
                              double y_i,
-                             double y_f) {
+                             double y_f) const {
         ROS_ASSERT(initialized);
 
         double a = ((y_f - y_i)/(x_f - x_i));
@@ -134,42 +351,232 @@ struct ThrustModel
         return result;
     }
 
-    double voltageFromThrust(double acceleration, int num_props, double /*height*/) {
+    // Thrust each of num_props props has to produce for the model's mass
+    // to accelerate at acceleration
+    double thrustForAcceleration(double acceleration, int num_props) const {
+        ROS_ASSERT(initialized);
+        return model_mass * (acceleration / 9.81) / static_cast<double>(num_props);
+    }
+
+    // Ratio of thrust at a center of lift height to thrust far from the
+    // ground at the same voltage, interpolated between the model's ground
+    // effect heights. 1 for a model without ground effect.
+    double groundEffectRatio(double height) const {
+        ROS_ASSERT(initialized);
+
+        if (thrust_ratios.empty()) {
+            return 1.0;
+        }
+
+        const int last = thrust_ratios.size() - 1;
+        double index = (height - height_min) / height_step;
+        if (!(index > 0.0)) {
+            return thrust_ratios.front();
+        }
+        if (index >= last) {
+            return thrust_ratios.back();
+        }
+
+        int bottom = static_cast<int>(index);
+        double fraction = index - bottom;
+        return thrust_ratios[bottom]
+             + fraction * (thrust_ratios[bottom+1] - thrust_ratios[bottom]);
+    }
+
+    // Voltage for one motor, start_thrust is that motor's state and is
+    // updated to the new desired thrust. height is the center of lift
+    // height, used for ground effect.
+    double voltageFromThrust(double& start_thrust,
+                             double acceleration,
+                             int num_props,
+                             double height) const {
         ROS_ASSERT(initialized);
 
-        double desired_thrust =  model_mass * (acceleration / 9.81) / static_cast<double>(num_props);
+        double desired_thrust = thrustForAcceleration(acceleration, num_props);
 
         if(std::abs(desired_thrust) < small_thrust_epsilon) {
             start_thrust = desired_thrust;
             return 0.0;
         }
 
+        // Ground effect scales the thrust the props make at every voltage,
+        // so the mapping is used for the thrusts that would be made far
+        // from the ground. Together with interpolating the ratio in height
+        // this makes the lookup trilinear in start thrust, desired thrust
+        // and height.
+        const double ratio = groundEffectRatio(height);
+
         if(std::abs(desired_thrust - start_thrust) < small_thrust_epsilon){
             start_thrust = desired_thrust;
             //ROS_ERROR_STREAM("static model");
-            double voltage = get_voltage_for_thrust(desired_thrust);
+            double voltage = get_voltage_for_thrust(desired_thrust / ratio);
             //ROS_ERROR_STREAM("final voltage: " << voltage);
             return voltage;
         }
 
+        double voltage = lookup_table_enabled
+                       ? tableVoltageFromThrust(start_thrust / ratio, desired_thrust / ratio)
+                       : scanVoltageFromThrust(start_thrust / ratio, desired_thrust / ratio);
+
+        start_thrust = desired_thrust;
+        return voltage;
+    }
+
+    // Batched voltageFromThrust for num_motors motors driven by this model,
+    // all with their center of lift at height. Each motor keeps its own
+    // start thrust in start_thrusts, so this is equivalent to calling
+    // voltageFromThrust on a separate copy of the model per motor, without
+    // the copies. Motors are processed in groups of kMaxBatchMotors with
+    // the arithmetic done in passes over contiguous arrays, so it
+    // vectorizes across motors.
+    void voltagesFromThrusts(const double* accelerations,
+                             int num_props,
+                             double height,
+                             double* start_thrusts,
+                             double* voltages,
+                             int num_motors) const {
+        ROS_ASSERT(initialized);
+
+        const double ratio = groundEffectRatio(height);
+        for (int first = 0; first < num_motors; first += kMaxBatchMotors) {
+            int remaining = num_motors - first;
+            batchVoltagesFromThrusts(accelerations + first,
+                                     num_props,
+                                     ratio,
+                                     start_thrusts + first,
+                                     voltages + first,
+                                     remaining < kMaxBatchMotors ? remaining
+                                                                 : kMaxBatchMotors);
+        }
+    }
+
+    double get_voltage_for_thrust(double thrust) const {
+        ROS_ASSERT(initialized);
+        return thrust_to_voltage(thrust);
+    }
+
+    // Thrust reached one response_lag after voltage is applied starting
+    // from start_thrust, the forward direction of the voltage_to_jerk
+    // mapping. Inputs outside of the mapping are clamped to its edges.
+    double predictThrust(double start_thrust, double voltage) const {
+        ROS_ASSERT(initialized);
+
+        int bottom_thrust_index = std::min(std::max(static_cast<int>(std::floor(start_thrust / start_thrust_increment)), 0), num_thrust_points-2);
+        const double* voltages = &mapping_voltages[bottom_thrust_index * num_voltage_points];
+        const double* bottom_thrusts = &mapping_end_thrusts[bottom_thrust_index * num_voltage_points];
+        const double* top_thrusts = bottom_thrusts + num_voltage_points;
+
+        voltage = std::min(std::max(voltage, voltages[0]),
+                           voltages[num_voltage_points-1]);
+        int voltage_index = std::upper_bound(voltages + 1,
+                                             voltages + num_voltage_points - 1,
+                                             voltage)
+                          - voltages - 1;
+
+        double bottom_thrust = linearInterpolate(voltage,
+                                                 voltages[voltage_index],
+                                                 voltages[voltage_index+1],
+                                                 bottom_thrusts[voltage_index],
+                                                 bottom_thrusts[voltage_index+1]);
+        double top_thrust = linearInterpolate(voltage,
+                                              voltages[voltage_index],
+                                              voltages[voltage_index+1],
+                                              top_thrusts[voltage_index],
+                                              top_thrusts[voltage_index+1]);
+        return linearInterpolate(clampStartThrust(start_thrust),
+                                 mapping_start_thrusts[bottom_thrust_index],
+                                 mapping_start_thrusts[bottom_thrust_index+1],
+                                 bottom_thrust,
+                                 top_thrust);
+    }
+
+  private:
+    static constexpr int kMaxBatchMotors = 8;
+
+    void finishLoading() {
+        start_thrust_increment = (thrust_max - thrust_min) / (num_thrust_points-1);
+
+        ROS_ASSERT(thrust_ratios.size() != 1);
+        for (double ratio : thrust_ratios) {
+            ROS_ASSERT(ratio > 0.0);
+        }
+        if (!thrust_ratios.empty()) {
+            ROS_ASSERT(height_max > height_min);
+            height_step = (height_max - height_min) / (thrust_ratios.size() - 1);
+        }
+
+        lookup_table_enabled = false;
+        lookup_table.clear();
+
+        initialized = true;
+    }
+
+    // Parameter server values may come back as integers, e.g. "thrust_min: 0"
+    static double paramToDouble(XmlRpc::XmlRpcValue& value) {
+        if (value.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+            return static_cast<int>(value);
+        }
+        ROS_ASSERT(value.getType() == XmlRpc::XmlRpcValue::TypeDouble);
+        return static_cast<double>(value);
+    }
+
+    // Whether a compiled model was compiled from the yaml file at
+    // <model_name>_source, when that is set. Logs why not if it wasn't.
+    static bool matchesSource(const ros::NodeHandle& nh,
+                              const std::string& model_name,
+                              const std::string& model_file,
+                              const ThrustModelFile::Contents& contents) {
+        std::string source_file;
+        if (!nh.getParam(model_name + "_source", source_file)) {
+            return true;
+        }
+
+        uint64_t source_checksum;
+        if (!ThrustModelFile::sourceChecksum(source_file, source_checksum)) {
+            ROS_WARN("Failed to read %s to check thrust model file %s "
+                     "against, using the model on the parameter server",
+                     source_file.c_str(),
+                     model_file.c_str());
+            return false;
+        }
+
+        if (source_checksum != contents.source_checksum) {
+            ROS_WARN("Thrust model file %s was not compiled from the current "
+                     "%s, using the model on the parameter server. Rerun "
+                     "thrust_model_compiler to update it.",
+                     model_file.c_str(),
+                     source_file.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Finds the voltage that takes the motor from start_thrust to
+    // desired_thrust by scanning the two voltage_to_jerk mapping rows
+    // around start_thrust.
+    double scanVoltageFromThrust(double start_thrust,
+                                 double desired_thrust) const {
         double start_thrust_index = start_thrust / start_thrust_increment;
 
-        int bottom_thrust_index = std::min(std::max(static_cast<int>(std::floor(start_thrust_index)), 0), num_thrust_points-1);
-        int top_thrust_index = std::min(std::max(bottom_thrust_index + 1, 0), num_thrust_points-1);
+        int bottom_thrust_index = std::min(std::max(static_cast<int>(std::floor(start_thrust_index)), 0), num_thrust_points-2);
+        int top_thrust_index = bottom_thrust_index + 1;
 
-        PossibleThrustFromThrust bottom_thrusts = voltage_to_jerk_mapping[bottom_thrust_index];
-        PossibleThrustFromThrust top_thrusts = voltage_to_jerk_mapping[top_thrust_index];
+        const double bottom_start_thrust = mapping_start_thrusts[bottom_thrust_index];
+        const double top_start_thrust = mapping_start_thrusts[top_thrust_index];
+        const double* bottom_thrusts = &mapping_end_thrusts[bottom_thrust_index * num_voltage_points];
+        const double* top_thrusts = &mapping_end_thrusts[top_thrust_index * num_voltage_points];
+        const double* voltages = &mapping_voltages[bottom_thrust_index * num_voltage_points];
+
+        start_thrust = clampStartThrust(start_thrust);
 
         double zero_voltage_thrust = linearInterpolate(
                                         start_thrust,
-                                        bottom_thrusts.start_thrust,
-                                        top_thrusts.start_thrust,
-                                        bottom_thrusts.possible_thrusts[0].thrust,
-                                        top_thrusts.possible_thrusts[0].thrust);
+                                        bottom_start_thrust,
+                                        top_start_thrust,
+                                        bottom_thrusts[0],
+                                        top_thrusts[0]);
 
         if(zero_voltage_thrust >= desired_thrust) {
-            start_thrust = desired_thrust;
-            //ROS_ERROR("ZERO VOLTAGE THRUST");
             return 0.0f;
         }
 
@@ -185,10 +592,10 @@ struct ThrustModel
             // that is less than the desired thrust.
             double current_final_thrust = linearInterpolate(
                 start_thrust,
-                bottom_thrusts.start_thrust,
-                top_thrusts.start_thrust,
-                bottom_thrusts.possible_thrusts[i].thrust, // End thrust bottom
-                top_thrusts.possible_thrusts[i].thrust); // End thrust top
+                bottom_start_thrust,
+                top_start_thrust,
+                bottom_thrusts[i], // End thrust bottom
+                top_thrusts[i]); // End thrust top
 
             if(current_final_thrust >= desired_thrust) {
 
@@ -199,41 +606,332 @@ struct ThrustModel
                 voltage = linearInterpolate(desired_thrust,
                                              last_final_thrust,
                                              current_final_thrust,
-                                             bottom_thrusts.possible_thrusts[i-1].voltage,
-                                             bottom_thrusts.possible_thrusts[i].voltage);
-                /*ROS_ERROR_STREAM("Dynamic model");
-                ROS_ERROR_STREAM("start_thrust " << start_thrust
-                                 << "\nbottom thrust start " << bottom_thrusts.start_thrust
-                                 << "\ntop_thrusts start " << top_thrusts.start_thrust
-                                 << "\nbottom thrusts possible " << bottom_thrusts.possible_thrusts[i].thrust
-                                 << "\ntop thrusts possible " << top_thrusts.possible_thrusts[i].thrust
-                                 << "\ndesired thrust " << desired_thrust
-                                 << "\nlast final thrust " << last_final_thrust
-                                 << "\ncurrent final thrust " << current_final_thrust
-                                 << "\nvoltage low " << bottom_thrusts.possible_thrusts[i-1].voltage
-                                 << "\nvoltage high " << bottom_thrusts.possible_thrusts[i].voltage
-                                 << "\nvoltage final " << voltage);*/
-
+                                             voltages[i-1],
+                                             voltages[i]);
                 break;
             }
             last_final_thrust = current_final_thrust;
         }
 
-        start_thrust = desired_thrust;
         return std::min(std::max(voltage, voltage_min), voltage_max);
     }
 
+    // Outside of the mapping hold the nearest row
+    double clampStartThrust(double start_thrust) const {
+        return std::min(std::max(start_thrust,
+                                 mapping_start_thrusts.front()),
+                        mapping_start_thrusts.back());
+    }
 
-    double get_voltage_for_thrust(double thrust) {
-        ROS_ASSERT(initialized);
-        double sum = 0;
-        for(unsigned int i = 0; i < thrust_to_voltage.size(); i++) {
-            double inc = thrust_to_voltage[i]*std::pow(thrust, thrust_to_voltage.size()-1-i);
-            sum += inc;
+    // Thrust reached from start_thrust when zero voltage is applied.
+    // Any desired thrust at or below this maps to zero voltage.
+    double zeroVoltageThrust(double start_thrust) const {
+        int bottom_thrust_index = std::min(std::max(static_cast<int>(std::floor(start_thrust / start_thrust_increment)), 0), num_thrust_points-2);
+        int top_thrust_index = bottom_thrust_index + 1;
+
+        return linearInterpolate(clampStartThrust(start_thrust),
+                                 mapping_start_thrusts[bottom_thrust_index],
+                                 mapping_start_thrusts[top_thrust_index],
+                                 mapping_end_thrusts[bottom_thrust_index * num_voltage_points],
+                                 mapping_end_thrusts[top_thrust_index * num_voltage_points]);
+    }
+
+    // Bilinear lookup into lookup_table, queries outside of the table are
+    // clamped to its edges
+    double tableVoltageFromThrust(double start_thrust,
+                                  double desired_thrust) const {
+        double zero_voltage_thrust = zeroVoltageThrust(start_thrust);
+        if (zero_voltage_thrust >= desired_thrust) {
+            return 0.0;
+        }
+
+        double x = (start_thrust - lookup_table_start_min)
+                 / lookup_table_start_step;
+        double y = (desired_thrust - zero_voltage_thrust)
+                 / lookup_table_desired_step;
+        x = std::min(std::max(x, 0.0),
+                     static_cast<double>(lookup_table_start_points - 1));
+        y = std::min(std::max(y, 0.0),
+                     static_cast<double>(lookup_table_desired_points - 1));
+
+        int i = std::min(static_cast<int>(x), lookup_table_start_points - 2);
+        int j = std::min(static_cast<int>(y), lookup_table_desired_points - 2);
+        double fx = x - i;
+        double fy = y - j;
+
+        const double* bottom = &lookup_table[i * lookup_table_desired_points + j];
+        const double* top = bottom + lookup_table_desired_points;
+        double bottom_voltage = bottom[0] + fy * (bottom[1] - bottom[0]);
+        double top_voltage = top[0] + fy * (top[1] - top[0]);
+        return bottom_voltage + fx * (top_voltage - bottom_voltage);
+    }
+
+    // One group of voltagesFromThrusts, ratio is the ground effect ratio
+    // at the motors' height. Every motor's desired thrust and steady state
+    // voltage are computed up front in loops without branches, then each
+    // motor picks its branch.
+    void batchVoltagesFromThrusts(const double* accelerations,
+                                  int num_props,
+                                  double ratio,
+                                  double* start_thrusts,
+                                  double* voltages,
+                                  int n) const {
+        double desired_thrusts[kMaxBatchMotors] = {};
+        double free_air_starts[kMaxBatchMotors] = {};
+        double free_air_desireds[kMaxBatchMotors] = {};
+        double steady_voltages[kMaxBatchMotors];
+        double dynamic_voltages[kMaxBatchMotors];
+
+        // Same as voltageFromThrust, the mapping is used for the thrusts
+        // that would be made far from the ground
+        const double thrust_per_accel = model_mass / 9.81 / static_cast<double>(num_props);
+        for (int k = 0; k < n; k++) {
+            desired_thrusts[k] = accelerations[k] * thrust_per_accel;
+            free_air_starts[k] = start_thrusts[k] / ratio;
+            free_air_desireds[k] = desired_thrusts[k] / ratio;
+        }
+
+        thrust_to_voltage.evaluate(free_air_desireds, steady_voltages, n);
+
+        if (lookup_table_enabled) {
+            tableVoltagesFromThrusts(free_air_starts, free_air_desireds, dynamic_voltages, n);
+        } else {
+            for (int k = 0; k < n; k++) {
+                dynamic_voltages[k] = scanVoltageFromThrust(free_air_starts[k],
+                                                            free_air_desireds[k]);
+            }
+        }
+
+        for (int k = 0; k < n; k++) {
+            if (std::abs(desired_thrusts[k]) < small_thrust_epsilon) {
+                voltages[k] = 0.0;
+            } else if (std::abs(desired_thrusts[k] - start_thrusts[k]) < small_thrust_epsilon) {
+                voltages[k] = steady_voltages[k];
+            } else {
+                voltages[k] = dynamic_voltages[k];
+            }
+            start_thrusts[k] = desired_thrusts[k];
+        }
+    }
+
+    // tableVoltageFromThrust for a group of motors. Grid coordinates are
+    // computed across motors, only the table reads are done per motor.
+    void tableVoltagesFromThrusts(const double* start_thrusts,
+                                  const double* desired_thrusts,
+                                  double* voltages,
+                                  int n) const {
+        int rows[kMaxBatchMotors];
+        double clamped_starts[kMaxBatchMotors];
+        for (int k = 0; k < n; k++) {
+            double index = std::floor(start_thrusts[k] / start_thrust_increment);
+            rows[k] = static_cast<int>(std::min(std::max(index, 0.0),
+                                                static_cast<double>(num_thrust_points - 2)));
+            clamped_starts[k] = std::min(std::max(start_thrusts[k],
+                                                  mapping_start_thrusts.front()),
+                                         mapping_start_thrusts.back());
+        }
+
+        double zero_voltage_thrusts[kMaxBatchMotors];
+        for (int k = 0; k < n; k++) {
+            zero_voltage_thrusts[k] = linearInterpolate(
+                    clamped_starts[k],
+                    mapping_start_thrusts[rows[k]],
+                    mapping_start_thrusts[rows[k] + 1],
+                    mapping_end_thrusts[rows[k] * num_voltage_points],
+                    mapping_end_thrusts[(rows[k] + 1) * num_voltage_points]);
+        }
+
+        int cells[kMaxBatchMotors];
+        double fxs[kMaxBatchMotors];
+        double fys[kMaxBatchMotors];
+        for (int k = 0; k < n; k++) {
+            double x = (start_thrusts[k] - lookup_table_start_min)
+                     / lookup_table_start_step;
+            double y = (desired_thrusts[k] - zero_voltage_thrusts[k])
+                     / lookup_table_desired_step;
+            x = std::min(std::max(x, 0.0),
+                         static_cast<double>(lookup_table_start_points - 1));
+            y = std::min(std::max(y, 0.0),
+                         static_cast<double>(lookup_table_desired_points - 1));
+
+            int i = std::min(static_cast<int>(x), lookup_table_start_points - 2);
+            int j = std::min(static_cast<int>(y), lookup_table_desired_points - 2);
+            fxs[k] = x - i;
+            fys[k] = y - j;
+            cells[k] = i * lookup_table_desired_points + j;
+        }
+
+        double corners[4][kMaxBatchMotors];
+        for (int k = 0; k < n; k++) {
+            const double* bottom = &lookup_table[cells[k]];
+            const double* top = bottom + lookup_table_desired_points;
+            corners[0][k] = bottom[0];
+            corners[1][k] = bottom[1];
+            corners[2][k] = top[0];
+            corners[3][k] = top[1];
+        }
+
+        for (int k = 0; k < n; k++) {
+            double bottom_voltage = corners[0][k] + fys[k] * (corners[1][k] - corners[0][k]);
+            double top_voltage = corners[2][k] + fys[k] * (corners[3][k] - corners[2][k]);
+            double voltage = bottom_voltage + fxs[k] * (top_voltage - bottom_voltage);
+            voltages[k] = zero_voltage_thrusts[k] >= desired_thrusts[k] ? 0.0 : voltage;
+        }
+    }
+
+};
+
+// A motor's view of a thrust model. Copies share the model's tables and
+// only duplicate the start thrust, so handing a model between controllers
+// is a pointer copy.
+struct ThrustModel
+{
+  public:
+    double response_lag = 0.0;
+
+    ThrustModel() {
+
+    }
+
+    ThrustModel(ros::NodeHandle& nh, std::string model_name) {
+        loadModel(nh, model_name);
+    }
+
+    explicit ThrustModel(std::shared_ptr<const ThrustModelData> data) {
+        setData(std::move(data));
+    }
+
+    void loadModel(ros::NodeHandle& nh, std::string model_name) {
+        std::shared_ptr<ThrustModelData> data = std::make_shared<ThrustModelData>();
+        data->loadModel(nh, model_name);
+        setData(std::move(data));
+        start_thrust = 0.0;
+    }
+
+    void loadModel(XmlRpc::XmlRpcValue& model, double model_mass) {
+        std::shared_ptr<ThrustModelData> data = std::make_shared<ThrustModelData>();
+        data->loadModel(model, model_mass);
+        setData(std::move(data));
+        start_thrust = 0.0;
+    }
+
+    void loadModel(const ThrustModelFile::Contents& contents,
+                   double model_mass) {
+        std::shared_ptr<ThrustModelData> data = std::make_shared<ThrustModelData>();
+        data->loadModel(contents, model_mass);
+        setData(std::move(data));
+        start_thrust = 0.0;
+    }
+
+    // The shared tables are immutable, so this builds the table into a
+    // private copy of them
+    void buildLookupTable(int start_points, int desired_points) {
+        ROS_ASSERT(data_);
+        std::shared_ptr<ThrustModelData> data = std::make_shared<ThrustModelData>(*data_);
+        data->buildLookupTable(start_points, desired_points);
+        setData(std::move(data));
+    }
+
+    void checkLookupTable(double& max_error,
+                          double& max_error_start,
+                          double& max_error_desired) const {
+        ROS_ASSERT(data_);
+        data_->checkLookupTable(max_error, max_error_start, max_error_desired);
+    }
+
+    ThrustModelFile::Contents getContents() const {
+        ROS_ASSERT(data_);
+        return data_->getContents();
+    }
+
+    const std::shared_ptr<const ThrustModelData>& getData() const {
+        return data_;
+    }
+
+    // Switches to another model's tables, keeping this motor's start
+    // thrust since the motor itself hasn't changed
+    void setData(std::shared_ptr<const ThrustModelData> data) {
+        ROS_ASSERT(data);
+        data_ = std::move(data);
+        response_lag = data_->response_lag;
+    }
+
+    // Correction fit in flight by ThrustModelEstimator, every voltage this
+    // model returns becomes scale * voltage + offset. Like the start thrust
+    // it belongs to this handle, the shared tables stay uncorrected.
+    void setVoltageCorrection(double scale, double offset) {
+        voltage_scale = scale;
+        voltage_offset = offset;
+    }
+
+    double getVoltageScale() const {
+        return voltage_scale;
+    }
+
+    double getVoltageOffset() const {
+        return voltage_offset;
+    }
+
+    double thrustForAcceleration(double acceleration, int num_props) const {
+        ROS_ASSERT(data_);
+        return data_->thrustForAcceleration(acceleration, num_props);
+    }
+
+    double groundEffectRatio(double height) const {
+        ROS_ASSERT(data_);
+        return data_->groundEffectRatio(height);
+    }
+
+    double voltageFromThrust(double acceleration, int num_props, double height) {
+        ROS_ASSERT(data_);
+        return correctVoltage(data_->voltageFromThrust(start_thrust,
+                                                       acceleration,
+                                                       num_props,
+                                                       height));
+    }
+
+    void voltagesFromThrusts(const double* accelerations,
+                             int num_props,
+                             double height,
+                             double* start_thrusts,
+                             double* voltages,
+                             int num_motors) const {
+        ROS_ASSERT(data_);
+        data_->voltagesFromThrusts(accelerations,
+                                   num_props,
+                                   height,
+                                   start_thrusts,
+                                   voltages,
+                                   num_motors);
+        for (int i = 0; i < num_motors; i++) {
+            voltages[i] = correctVoltage(voltages[i]);
         }
-        return sum;
     }
 
+    double get_voltage_for_thrust(double thrust) const {
+        ROS_ASSERT(data_);
+        return correctVoltage(data_->get_voltage_for_thrust(thrust));
+    }
+
+    double predictThrust(double start_thrust, double voltage) const {
+        ROS_ASSERT(data_);
+        return data_->predictThrust(start_thrust, voltage);
+    }
+
+  private:
+    // Zero voltage means the motor is off, which no correction changes
+    double correctVoltage(double voltage) const {
+        return voltage > 0.0
+             ? std::max(voltage_scale * voltage + voltage_offset, 0.0)
+             : voltage;
+    }
+
+    std::shared_ptr<const ThrustModelData> data_;
+
+    double start_thrust = 0.0;
+
+    double voltage_scale = 1.0;
+    double voltage_offset = 0.0;
 };
 
 }
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Estimator
+//
+// Fits a scale and offset correction to a thrust model's thrust to voltage
+// mapping in flight, from the measured acceleration and the voltage that
+// was applied to the motors.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef THRUST_MODEL_ESTIMATOR_HPP
+#define THRUST_MODEL_ESTIMATOR_HPP
+
+#include <string>
+
+#include <ros/ros.h>
+
+//Bad Header
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+//End Bad Header
+
+namespace Iarc7Motion
+{
+
+struct ThrustModelEstimatorSettings
+{
+    // Weight of each sample relative to the one after it, the estimate
+    // averages over roughly 1 / (1 - forgetting_factor) samples
+    double forgetting_factor = 0.998;
+
+    // Time constant of the low pass filter applied to both voltages, long
+    // compared to the model's response_lag so the lag between applying a
+    // voltage and measuring its thrust doesn't bias the fit (s)
+    double filter_time_constant = 0.5;
+
+    // Limits on the correction, a bad fit can't push the model further
+    // than this from the model it corrects
+    double max_scale_error = 0.2;
+    double max_offset = 1.0;
+
+    // Bound on the estimate covariance, keeps the gain finite when the
+    // voltage hardly changes, as in a long hover
+    double max_covariance = 100.0;
+
+    // Loads the settings under prefix from nh, keeping the defaults for
+    // any that aren't set
+    static ThrustModelEstimatorSettings load(const ros::NodeHandle& nh,
+                                             const std::string& prefix);
+};
+
+// Recursive least squares fit of
+//
+//     applied voltage = scale * model voltage + offset
+//
+// where model voltage is the uncorrected thrust model's steady state
+// voltage for the measured thrust. Each update is a fixed amount of work on
+// 2x2 matrices.
+class ThrustModelEstimator
+{
+public:
+    explicit ThrustModelEstimator(const ThrustModelEstimatorSettings& settings);
+
+    ThrustModelEstimator() = delete;
+    ~ThrustModelEstimator() = default;
+
+    // Adds one control tick. dt is the time since the last update,
+    // model_voltage the uncorrected model's voltage for the thrust measured
+    // this tick and applied_voltage the voltage commanded to the motors.
+    //
+    // Returns false and ignores the sample if dt isn't positive or either
+    // voltage isn't finite.
+    bool __attribute__((warn_unused_result)) update(double dt,
+                                                    double model_voltage,
+                                                    double applied_voltage);
+
+    // Forgets the filtered voltages, but keeps the correction. Call when
+    // samples stop being representative, such as on landing.
+    void restartFilters();
+
+    // Back to no correction
+    void reset();
+
+    double getScale() const;
+    double getOffset() const;
+
+private:
+    const ThrustModelEstimatorSettings settings_;
+
+    // Scale and offset
+    Eigen::Vector2d estimate_;
+    Eigen::Matrix2d covariance_;
+
+    bool filters_initialized_;
+    double filtered_model_voltage_;
+    double filtered_applied_voltage_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // THRUST_MODEL_ESTIMATOR_HPP
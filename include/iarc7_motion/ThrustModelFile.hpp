@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model File
+//
+// Binary, memory mappable form of a thrust model. A file is a fixed size
+// header followed by flat arrays of doubles:
+//
+//   thrust_to_voltage   [num_coefficients]
+//   start_thrusts       [num_thrust_points]
+//   voltages            [num_thrust_points * num_voltage_points]
+//   end_thrusts         [num_thrust_points * num_voltage_points]
+//   thrust_ratios       [num_height_points]
+//
+// thrust_ratios is the ground effect, see Contents.
+//
+// The header size is a multiple of 8 bytes so every array is naturally
+// aligned when the file is mapped. The checksum covers the header (with the
+// checksum field zeroed) and the arrays. The header also holds the checksum
+// of the yaml file the model was compiled from, so a file left over from an
+// older yaml can be told apart.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef THRUST_MODEL_FILE_HPP
+#define THRUST_MODEL_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Iarc7Motion
+{
+namespace ThrustModelFile
+{
+
+constexpr char kMagic[8] = {'I', 'A', 'R', 'C', '7', 'T', 'M', '\0'};
+constexpr uint32_t kVersion = 3;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+
+    uint32_t num_coefficients;
+    uint32_t num_thrust_points;
+    uint32_t num_voltage_points;
+    uint32_t num_height_points;
+
+    double response_lag;
+    double small_thrust_epsilon;
+    double thrust_min;
+    double thrust_max;
+    double voltage_min;
+    double voltage_max;
+    double height_min;
+    double height_max;
+
+    uint64_t source_checksum;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(Header) % sizeof(double) == 0,
+              "Thrust model file arrays must stay 8 byte aligned");
+
+// Everything stored in a thrust model file. The arrays point either into a
+// mapped file or into storage owned by whoever filled this in.
+struct Contents
+{
+    double response_lag;
+    double small_thrust_epsilon;
+    double thrust_min;
+    double thrust_max;
+    double voltage_min;
+    double voltage_max;
+
+    int num_coefficients;
+    int num_thrust_points;
+    int num_voltage_points;
+
+    const double* thrust_to_voltage;
+    const double* start_thrusts;
+    const double* voltages;
+    const double* end_thrusts;
+
+    // Ground effect, thrust_ratios[i] is the thrust at a center of lift
+    // height of height_min + i * (height_max - height_min) / (num_height_points - 1)
+    // divided by the thrust at the same voltage far from the ground. Zero
+    // height points for a model without ground effect.
+    int num_height_points = 0;
+    double height_min = 0.0;
+    double height_max = 0.0;
+    const double* thrust_ratios = nullptr;
+
+    // sourceChecksum of the yaml file the model was compiled from, zero if
+    // it wasn't compiled from a file
+    uint64_t source_checksum = 0;
+};
+
+// Number of bytes following the header for the given dimensions
+size_t payloadSize(const Contents& contents);
+
+// Checksum of the bytes of the file at path, returns false if it can't be
+// read
+bool __attribute__((warn_unused_result)) sourceChecksum(const std::string& path,
+                                                        uint64_t& checksum);
+
+// Writes contents to path, returns false on any IO error
+bool __attribute__((warn_unused_result)) write(const std::string& path,
+                                               const Contents& contents);
+
+// Read only mapping of a thrust model file, validated on open
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    ~MappedFile();
+
+    // Don't allow the copy constructor or assignment.
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+
+    // Maps the file at path and checks its magic, version, byte order,
+    // size and checksum. Returns false and logs the reason on failure.
+    bool __attribute__((warn_unused_result)) open(const std::string& path);
+
+    void close();
+
+    bool isOpen() const;
+
+    // Only valid while the file is open
+    const Contents& contents() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    Contents contents_ = Contents();
+};
+
+} // End namespace ThrustModelFile
+} // End namespace Iarc7Motion
+
+#endif // THRUST_MODEL_FILE_HPP
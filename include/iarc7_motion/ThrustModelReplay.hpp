@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Replay
+//
+// Replays thrust stand logs (scripts/thrust_model_v2/Dynamic/*FullTest)
+// through a thrust model and measures how well the model predicts the
+// recorded thrust.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef THRUST_MODEL_REPLAY_HPP
+#define THRUST_MODEL_REPLAY_HPP
+
+#include <string>
+#include <vector>
+
+#include "iarc7_motion/ThrustModel.hpp"
+
+namespace Iarc7Motion
+{
+namespace ThrustModelReplay
+{
+
+// One load cell reading with the ESC state at the time
+struct Sample
+{
+    double time;            // Load cell timestamp (s)
+    double thrust;          // (kg)
+    double battery_voltage; // (V)
+    double throttle;        // Throttle sent to the ESC (%)
+    double throttle_time;   // Time the throttle was sent (s)
+};
+
+// Samples between a START and STOP line of the log, in time order
+typedef std::vector<Sample> Segment;
+
+struct ErrorStats
+{
+    int samples = 0;
+    double rms = 0.0;
+    double mean = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+};
+
+struct Result
+{
+    // Error of the voltage_to_jerk prediction one response_lag ahead (kg)
+    ErrorStats dynamic_thrust;
+
+    // Error of thrust_to_voltage against the applied voltage once the
+    // throttle has been held for a while (V)
+    ErrorStats steady_voltage;
+};
+
+// Reads every segment of a thrust stand log. Lines that don't parse, such
+// as ones cut short on the serial link, are skipped. Returns false if the
+// file can't be read or holds no samples.
+bool __attribute__((warn_unused_result)) loadLog(const std::string& path,
+                                                 std::vector<Segment>& segments);
+
+// Predicts the thrust one response_lag after each sample from the
+// measured thrust and applied motor voltage, and compares against the
+// thrust measured then. Samples where the throttle changes within the
+// prediction window are skipped.
+Result replay(const ThrustModel& model, const std::vector<Segment>& segments);
+
+} // End namespace ThrustModelReplay
+} // End namespace Iarc7Motion
+
+#endif // THRUST_MODEL_REPLAY_HPP
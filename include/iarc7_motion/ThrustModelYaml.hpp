@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Yaml
+//
+// Reads thrust model yaml files (as found in param/thrust_models) without
+// going through the parameter server, for the offline tools.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef THRUST_MODEL_YAML_HPP
+#define THRUST_MODEL_YAML_HPP
+
+#include <string>
+#include <vector>
+
+#include "iarc7_motion/ThrustModelFile.hpp"
+
+namespace Iarc7Motion
+{
+namespace ThrustModelYaml
+{
+
+// Thrust model read from a yaml file, the mapping is stored row major
+// like ThrustModelData's
+struct Model
+{
+    double response_lag;
+    double small_thrust_epsilon;
+    double thrust_min;
+    double thrust_max;
+    double voltage_min;
+    double voltage_max;
+
+    int num_thrust_points;
+    int num_voltage_points;
+
+    std::vector<double> thrust_to_voltage;
+    std::vector<double> start_thrusts;
+    std::vector<double> voltages;
+    std::vector<double> end_thrusts;
+
+    // Empty if the model has no ground_effect section
+    double height_min = 0.0;
+    double height_max = 0.0;
+    std::vector<double> thrust_ratios;
+
+    // Arrays point into this model
+    ThrustModelFile::Contents contents() const;
+};
+
+// Parses the thrust model in path. Models written before
+// small_thrust_epsilon was added get the default generate_thrust_model.py
+// uses, 1% of the thrust range. Prints the reason to stderr and returns
+// false on failure.
+bool __attribute__((warn_unused_result)) load(const std::string& path,
+                                              Model& model);
+
+} // End namespace ThrustModelYaml
+} // End namespace Iarc7Motion
+
+#endif // THRUST_MODEL_YAML_HPP
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Trajectory Sample
+//
+// Compact form of a motion point target used inside the motion point
+// interpolator. Only the fields the controller follows are kept, packed
+// into one aligned array so a sample is trivially copyable and two samples
+// can be interpolated with a single vector operation. Conversion to and
+// from iarc7_msgs::MotionPointStamped happens at the edges of the
+// interpolator.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef IARC7_MOTION_TRAJECTORY_SAMPLE_HPP_
+#define IARC7_MOTION_TRAJECTORY_SAMPLE_HPP_
+
+#include <cstdint>
+#include <type_traits>
+
+#include <ros/ros.h>
+
+#include "iarc7_msgs/MotionPointStamped.h"
+
+//Bad Header
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+//End Bad Header
+
+namespace Iarc7Motion
+{
+
+struct TrajectorySample
+{
+    // Layout of values
+    enum Index : int
+    {
+        kPositionX = 0,
+        kPositionY,
+        kPositionZ,
+        kVelocityX,
+        kVelocityY,
+        kVelocityZ,
+        kAccelX,
+        kAccelY,
+        kAccelZ,
+        kYawRate,
+        kSize
+    };
+
+    typedef Eigen::Matrix<double, kSize, 1> Vector;
+    typedef Eigen::Map<Vector, Eigen::Aligned> VectorMap;
+    typedef Eigen::Map<const Vector, Eigen::Aligned> ConstVectorMap;
+
+    alignas(16) double values[kSize];
+
+    // Time of the sample in nanoseconds, same as ros::Time::toNSec
+    int64_t stamp_ns;
+
+    VectorMap vector()
+    {
+        return VectorMap(values);
+    }
+
+    ConstVectorMap vector() const
+    {
+        return ConstVectorMap(values);
+    }
+
+    static TrajectorySample fromMessage(
+            const iarc7_msgs::MotionPointStamped& message)
+    {
+        const iarc7_msgs::MotionPoint& motion_point = message.motion_point;
+
+        TrajectorySample sample;
+        sample.stamp_ns = message.header.stamp.toNSec();
+        sample.values[kPositionX] = motion_point.pose.position.x;
+        sample.values[kPositionY] = motion_point.pose.position.y;
+        sample.values[kPositionZ] = motion_point.pose.position.z;
+        sample.values[kVelocityX] = motion_point.twist.linear.x;
+        sample.values[kVelocityY] = motion_point.twist.linear.y;
+        sample.values[kVelocityZ] = motion_point.twist.linear.z;
+        sample.values[kAccelX] = motion_point.accel.linear.x;
+        sample.values[kAccelY] = motion_point.accel.linear.y;
+        sample.values[kAccelZ] = motion_point.accel.linear.z;
+        sample.values[kYawRate] = motion_point.twist.angular.z;
+        return sample;
+    }
+
+    // Fills out the stamp and the fields held by the sample, all other
+    // fields of message are left unchanged
+    void toMessage(iarc7_msgs::MotionPointStamped& message) const
+    {
+        iarc7_msgs::MotionPoint& motion_point = message.motion_point;
+
+        message.header.stamp.fromNSec(stamp_ns);
+        motion_point.pose.position.x = values[kPositionX];
+        motion_point.pose.position.y = values[kPositionY];
+        motion_point.pose.position.z = values[kPositionZ];
+        motion_point.twist.linear.x = values[kVelocityX];
+        motion_point.twist.linear.y = values[kVelocityY];
+        motion_point.twist.linear.z = values[kVelocityZ];
+        motion_point.accel.linear.x = values[kAccelX];
+        motion_point.accel.linear.y = values[kAccelY];
+        motion_point.accel.linear.z = values[kAccelZ];
+        motion_point.twist.angular.z = values[kYawRate];
+    }
+};
+
+static_assert(std::is_trivially_copyable<TrajectorySample>::value,
+              "TrajectorySample must stay trivially copyable");
+
+} // End namespace Iarc7Motion
+
+#endif // IARC7_MOTION_TRAJECTORY_SAMPLE_HPP_
@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Velocity Profile Generator
+//
+// Builds the jerk limited (S-curve) profile taking the targets from a start
+// state to a target velocity, as a PolynomialTrajectory the motion point
+// interpolator follows directly.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef VELOCITY_PROFILE_GENERATOR_HPP
+#define VELOCITY_PROFILE_GENERATOR_HPP
+
+#include <string>
+
+#include <ros/ros.h>
+
+//Bad Header
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#include <Eigen/Core>
+#pragma GCC diagnostic pop
+//End Bad Header
+
+#include "iarc7_motion/PolynomialTrajectory.hpp"
+#include "iarc7_motion/TrajectorySample.hpp"
+
+namespace Iarc7Motion
+{
+
+struct VelocityProfileSettings
+{
+    // Acceleration and jerk limits used when a goal doesn't give any
+    // (m/s^2, m/s^3)
+    double acceleration = 1.0;
+    double jerk = 10.0;
+
+    // Largest limits a goal may ask for, larger ones are clamped
+    double max_acceleration = 3.0;
+    double max_jerk = 30.0;
+
+    // Time the target velocity is held for after it is reached, after
+    // which the targets come to rest with the same limits and stay there
+    // (s)
+    double hold_duration = 0.2;
+
+    // Loads the settings under prefix from nh, keeping the defaults for
+    // any that aren't set
+    static VelocityProfileSettings load(const ros::NodeHandle& nh,
+                                        const std::string& prefix);
+};
+
+// Each axis changes velocity in up to three phases of constant jerk: jerk
+// toward the peak acceleration, hold it, then jerk back to zero
+// acceleration. Every axis gets the share of the limits its velocity change
+// is of the whole change, so from rest the axes finish together and the
+// acceleration stays along the velocity change, as with the Python
+// LinearMotionProfileGenerator. Shares are kept small enough that the
+// magnitudes of the acceleration and jerk stay within the limits.
+class VelocityProfileGenerator
+{
+public:
+    explicit VelocityProfileGenerator(const VelocityProfileSettings& settings);
+
+    VelocityProfileGenerator() = delete;
+    ~VelocityProfileGenerator() = default;
+
+    // Fills trajectory with the profile from start, at start.stamp_ns, to
+    // target_velocity, held for the hold duration and then brought to rest.
+    // acceleration and jerk are the limits, 0 for the defaults. The start
+    // acceleration is clamped to the limit.
+    //
+    // Returns false and leaves trajectory empty if a limit is negative or
+    // anything isn't finite.
+    bool __attribute__((warn_unused_result)) generate(
+            const TrajectorySample& start,
+            const Eigen::Vector3d& target_velocity,
+            double acceleration,
+            double jerk,
+            PolynomialTrajectory& trajectory) const;
+
+private:
+    const VelocityProfileSettings settings_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // VELOCITY_PROFILE_GENERATOR_HPP
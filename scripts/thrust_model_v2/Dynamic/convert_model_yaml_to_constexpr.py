@@ -0,0 +1,118 @@
+import sys
+import os
+import yaml
+
+# Process a thrust model settings file and output a C++ header holding
+# the model as constexpr tables, for use with StaticThrustModel.
+#
+# Usage: convert_model_yaml_to_constexpr.py <model.yaml> <output.hpp> <StructName>
+
+def format_array(values, indent):
+    values = [repr(float(v)) for v in values]
+    lines = []
+    for i in range(0, len(values), 4):
+        lines.append(indent + ', '.join(values[i:i+4]))
+    return ',\n'.join(lines)
+
+def write_array_function(f, name, values):
+    f.write('    static constexpr std::array<double, {}> {}()\n'.format(len(values), name))
+    f.write('    {\n')
+    if values:
+        f.write('        return {{\n')
+        f.write(format_array(values, '            '))
+        f.write('\n        }};\n')
+    else:
+        f.write('        return {{}};\n')
+    f.write('    }\n')
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4:
+        sys.stderr.write('Usage: {} <model.yaml> <output.hpp> <StructName>\n'.format(sys.argv[0]))
+        sys.exit(2)
+
+    filename = sys.argv[1]
+    output = sys.argv[2]
+    struct_name = sys.argv[3]
+
+    with open(filename) as f:
+        settings = yaml.safe_load(f)
+
+    if not isinstance(settings, dict):
+        sys.stderr.write('{} does not contain a thrust model\n'.format(filename))
+        sys.exit(1)
+
+    voltage_to_jerk = settings['voltage_to_jerk']
+    model = voltage_to_jerk['mapping']
+    num_thrust_points = len(model)
+    num_voltage_points = len(model[0][1])
+
+    start_thrusts = []
+    voltages = []
+    end_thrusts = []
+    for row in model:
+        if len(row[1]) != num_voltage_points:
+            sys.stderr.write('Mapping rows have different lengths\n')
+            sys.exit(1)
+        start_thrusts.append(row[0])
+        for voltage_thrust in row[1]:
+            voltages.append(voltage_thrust[0])
+            end_thrusts.append(voltage_thrust[1])
+
+    # Models without a ground_effect section get no height points, which
+    # StaticThrustModel treats as a thrust ratio of 1 at every height
+    ground_effect = settings.get('ground_effect')
+    if ground_effect is not None:
+        height_min = ground_effect['height_min']
+        height_max = ground_effect['height_max']
+        thrust_ratios = ground_effect['thrust_ratios']
+        if len(thrust_ratios) < 2:
+            sys.stderr.write('Ground effect needs at least two heights\n')
+            sys.exit(1)
+    else:
+        height_min = 0.0
+        height_max = 0.0
+        thrust_ratios = []
+
+    header_guard = 'IARC7_MOTION_' + struct_name.upper() + '_HPP_'
+
+    output_dir = os.path.dirname(output)
+    if output_dir and not os.path.isdir(output_dir):
+        os.makedirs(output_dir)
+
+    with open(output, 'w') as f:
+        f.write('// Thrust model {} as constexpr tables\n'.format(struct_name))
+        f.write('// Generated from {} by {}\n'.format(os.path.basename(filename),
+                                                     os.path.basename(sys.argv[0])))
+        f.write('// Do not edit, regenerate by reconfiguring the build\n\n')
+        f.write('#ifndef {}\n'.format(header_guard))
+        f.write('#define {}\n\n'.format(header_guard))
+        f.write('#include <array>\n\n')
+        f.write('namespace Iarc7Motion {\n\n')
+        f.write('struct {}\n'.format(struct_name))
+        f.write('{\n')
+        f.write('    static constexpr int num_coefficients = {};\n'.format(len(settings['thrust_to_voltage'])))
+        f.write('    static constexpr int num_thrust_points = {};\n'.format(num_thrust_points))
+        f.write('    static constexpr int num_voltage_points = {};\n'.format(num_voltage_points))
+        f.write('    static constexpr int num_height_points = {};\n\n'.format(len(thrust_ratios)))
+        f.write('    static constexpr double response_lag = {};\n'.format(repr(float(settings['response_lag']))))
+        f.write('    static constexpr double small_thrust_epsilon = {};\n'.format(repr(float(settings['small_thrust_epsilon']))))
+        f.write('    static constexpr double thrust_min = {};\n'.format(repr(float(voltage_to_jerk['thrust_min']))))
+        f.write('    static constexpr double thrust_max = {};\n'.format(repr(float(voltage_to_jerk['thrust_max']))))
+        f.write('    static constexpr double voltage_min = {};\n'.format(repr(float(voltage_to_jerk['voltage_min']))))
+        f.write('    static constexpr double voltage_max = {};\n'.format(repr(float(voltage_to_jerk['voltage_max']))))
+        f.write('    static constexpr double height_min = {};\n'.format(repr(float(height_min))))
+        f.write('    static constexpr double height_max = {};\n\n'.format(repr(float(height_max))))
+
+        write_array_function(f, 'thrust_to_voltage', settings['thrust_to_voltage'])
+        f.write('\n')
+        write_array_function(f, 'start_thrusts', start_thrusts)
+        f.write('\n')
+        write_array_function(f, 'voltages', voltages)
+        f.write('\n')
+        write_array_function(f, 'end_thrusts', end_thrusts)
+        f.write('\n')
+        write_array_function(f, 'thrust_ratios', thrust_ratios)
+
+        f.write('};\n\n')
+        f.write('} // End namespace Iarc7Motion\n\n')
+        f.write('#endif // {}\n'.format(header_guard))
@@ -667,6 +667,31 @@ def generate_model_map(voltage_to_thrust, time_constant_function, settings):
     return voltage_to_jerk_model
 
 
+def generate_ground_effect(settings):
+    height_min = settings['height_min']
+    height_max = settings['height_max']
+    heights = np.linspace(
+        height_min, height_max, settings['height_points'], endpoint=True)
+
+    if 'measured_ratios' in settings:
+        # [height (m), thrust near the ground / thrust far from the ground]
+        # pairs from hover tests, resampled onto the evenly spaced heights
+        measured = np.array(sorted(settings['measured_ratios']))
+        thrust_ratios = np.interp(heights, measured[:, 0], measured[:, 1])
+    else:
+        # Cheeseman and Bennett's approximation for a rotor of radius R at
+        # height z above the ground, T / T_inf = 1 / (1 - (R / 4z)^2)
+        rotor_radius = settings['rotor_radius']
+        heights_above_rotor = np.maximum(heights, rotor_radius / 2.0)
+        thrust_ratios = 1.0 / (1.0 - (rotor_radius / (4.0 * heights_above_rotor))**2)
+
+    return {
+        'height_min': float(height_min),
+        'height_max': float(height_max),
+        'thrust_ratios': thrust_ratios.tolist()
+    }
+
+
 if __name__ == "__main__":
     filename = sys.argv[1]
 
@@ -706,6 +731,11 @@ if __name__ == "__main__":
         voltage_to_jerk_model
     }
 
+    # Optional, models without it assume no ground effect
+    if 'ground_effect_estimator' in settings:
+        output_model['ground_effect'] = generate_ground_effect(
+            settings['ground_effect_estimator'])
+
     with open(filename + '.output.yaml', 'w') as f:
         f.write('# Generated on {}\n\n'.format(str(datetime.datetime.now())))
         f.write(yaml.safe_dump(output_model))
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Control Loop Timer
+//
+// Paces the low level motion control loop with absolute deadlines on the
+// monotonic clock and keeps the period, jitter and deadline miss counts of
+// every tick. Also sets up the scheduling of the thread the loop runs on.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/ControlLoopTimer.hpp"
+
+// System Headers
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+using namespace Iarc7Motion;
+
+ControlThreadSettings ControlThreadSettings::load(const ros::NodeHandle& nh,
+                                                  const std::string& prefix)
+{
+    ControlThreadSettings settings;
+    nh.param(prefix, settings.enabled, settings.enabled);
+    nh.param(prefix + "_priority", settings.priority, settings.priority);
+    nh.param(prefix + "_cpu", settings.cpu, settings.cpu);
+    nh.param(prefix + "_lock_memory", settings.lock_memory, settings.lock_memory);
+
+    ROS_ASSERT(settings.priority >= 0 && settings.priority <= 99);
+    ROS_ASSERT(settings.cpu >= -1 && settings.cpu < CPU_SETSIZE);
+    return settings;
+}
+
+bool ControlThreadSettings::applyToCurrentThread() const
+{
+    if (lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        ROS_ERROR("ControlThreadSettings failed to lock memory: %s",
+                  std::strerror(errno));
+        return false;
+    }
+
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        const int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            ROS_ERROR("ControlThreadSettings failed to pin to cpu %d: %s",
+                      cpu,
+                      std::strerror(result));
+            return false;
+        }
+    }
+
+    if (priority > 0) {
+        sched_param param;
+        param.sched_priority = priority;
+        const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result != 0) {
+            ROS_ERROR("ControlThreadSettings failed to set SCHED_FIFO priority %d: %s",
+                      priority,
+                      std::strerror(result));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ControlLoopTimer::ControlLoopTimer(double frequency)
+    : period_ns_(std::llround(1e9 / frequency))
+{
+    ROS_ASSERT(period_ns_ > 0);
+
+    stats_.wake_ns = monotonicNs();
+    stats_.deadline_ns = stats_.wake_ns + period_ns_;
+}
+
+void ControlLoopTimer::sleep()
+{
+    beginSleep(period_ns_, monotonicNs(), stats_);
+
+    timespec deadline;
+    deadline.tv_sec = stats_.deadline_ns / 1000000000;
+    deadline.tv_nsec = stats_.deadline_ns % 1000000000;
+
+    // Returns the error instead of setting errno, only EINTR can happen
+    // with a valid absolute deadline
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+
+    endSleep(period_ns_, monotonicNs(), stats_);
+}
+
+int64_t ControlLoopTimer::monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void ControlLoopTimer::beginSleep(int64_t period_ns,
+                                  int64_t sleep_ns,
+                                  ControlLoopStats& stats)
+{
+    stats.work_ns = sleep_ns - stats.wake_ns;
+
+    if (sleep_ns >= stats.deadline_ns) {
+        const int64_t missed = (sleep_ns - stats.deadline_ns) / period_ns + 1;
+        stats.deadline_misses += missed;
+        stats.deadline_ns += missed * period_ns;
+    }
+}
+
+void ControlLoopTimer::endSleep(int64_t period_ns,
+                                int64_t wake_ns,
+                                ControlLoopStats& stats)
+{
+    stats.period_ns = wake_ns - stats.wake_ns;
+    stats.jitter_ns = wake_ns - stats.deadline_ns;
+    stats.wake_ns = wake_ns;
+    stats.deadline_ns += period_ns;
+    stats.ticks++;
+}
@@ -102,30 +102,22 @@ bool LandPlanner::prepareForTakeover(const ros::Time& time)
 }
 
 // Main update
-bool LandPlanner::getTargetMotionPoint(const ros::Time& time,
+bool LandPlanner::getTargetMotionPoint(const StateSnapshot& state,
                          iarc7_msgs::MotionPointStamped& motion_point)
 {
+    const ros::Time& time = state.stamp;
     if (time < last_update_time_) {
         ROS_ERROR("Tried to update LandPlanner with time before last update");
         return false;
     }
 
-    // Get the current transform (xyz) of the quad
-    geometry_msgs::TransformStamped transform;
-    bool success = transform_wrapper_.getTransformAtTime(transform,
-                                                         "map",
-                                                         "level_quad",
-                                                         time,
-                                                         update_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to get current transform in LandPlanner::update");
-        return false;
-    }
+    // Current height of the quad
+    const double height = state.map_to_level_quad.translation.z;
 
     if(state_ == LandState::DESCEND)
     {
       // determines whether to speed up or slow down, depending on height
-        if (transform.transform.translation.z > cushion_height_) {
+        if (height > cushion_height_) {
             actual_descend_rate_ = std::max(descend_rate_,
                                             actual_descend_rate_
                                             + (descend_acceleration_
@@ -178,7 +170,7 @@ bool LandPlanner::getTargetMotionPoint(const ros::Time& time,
     motion_point.motion_point.pose.position.z = requested_height_;
     motion_point.motion_point.twist.linear.z = actual_descend_rate_;
 
-    if (transform.transform.translation.z > cushion_height_) {
+    if (height > cushion_height_) {
         if(actual_descend_rate_ > descend_rate_) {
             motion_point.motion_point.accel.linear.z = descend_acceleration_;
         }
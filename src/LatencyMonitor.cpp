@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Latency Monitor
+//
+// Periodically publishes the 50th and 99th percentile and the maximum of
+// each registered LatencyHistogram over the last report period, as a
+// diagnostic_msgs::DiagnosticArray.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/LatencyMonitor.hpp"
+
+// System Headers
+#include <cstdio>
+#include <utility>
+
+// ROS Headers
+#include "ros_utils/ParamUtils.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+std::string microseconds(int64_t nanoseconds)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.1f", nanoseconds * 1e-3);
+    return buffer;
+}
+
+} // End anonymous namespace
+
+LatencyMonitor::LatencyMonitor(ros::NodeHandle& nh,
+                               ros::NodeHandle& private_nh)
+    : report_period_(ros_utils::ParamUtils::getParam<double>(
+              private_nh,
+              "latency_report_period")),
+      stages_(),
+      counts_(new LatencyHistogram::Counts()),
+      report_(),
+      report_publisher_(nh.advertise<diagnostic_msgs::DiagnosticArray>(
+              "diagnostics",
+              10)),
+      report_callback_queue_(),
+      report_nh_(nh),
+      report_timer_(),
+      report_spinner_(1, &report_callback_queue_),
+      started_(false)
+{
+    ROS_ASSERT_MSG(report_period_ > ros::WallDuration(0.0),
+                   "Latency report period must be positive");
+    report_nh_.setCallbackQueue(&report_callback_queue_);
+}
+
+void LatencyMonitor::addStage(const std::string& name,
+                              const LatencyHistogram& histogram)
+{
+    ROS_ASSERT(!started_);
+
+    Stage stage;
+    stage.name = name;
+    stage.histogram = &histogram;
+    stage.reported.reset(new LatencyHistogram::Counts());
+    stage.reported->fill(0);
+    stages_.push_back(std::move(stage));
+}
+
+void LatencyMonitor::start()
+{
+    ROS_ASSERT(!started_);
+    started_ = true;
+
+    report_.status.resize(stages_.size());
+    for (size_t i = 0; i < stages_.size(); i++) {
+        report_.status[i].name = "low_level_motion latency: " + stages_[i].name;
+    }
+
+    report_timer_ = report_nh_.createWallTimer(report_period_,
+                                               &LatencyMonitor::publishReport,
+                                               this);
+    report_spinner_.start();
+}
+
+void LatencyMonitor::reportStage(Stage& stage,
+                                 LatencyHistogram::Counts& counts,
+                                 diagnostic_msgs::DiagnosticStatus& status)
+{
+    // Only the values recorded since the last report
+    stage.histogram->snapshot(counts);
+    for (size_t i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+        const uint64_t total = counts[i];
+        counts[i] -= (*stage.reported)[i];
+        (*stage.reported)[i] = total;
+    }
+
+    const uint64_t count = LatencyHistogram::total(counts);
+
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = count > 0 ? "" : "Not run";
+    status.values.resize(4);
+    status.values[0].key = "count";
+    status.values[0].value = std::to_string(count);
+    status.values[1].key = "p50 (us)";
+    status.values[1].value = microseconds(LatencyHistogram::percentile(counts, 0.5));
+    status.values[2].key = "p99 (us)";
+    status.values[2].value = microseconds(LatencyHistogram::percentile(counts, 0.99));
+    status.values[3].key = "max (us)";
+    status.values[3].value = microseconds(LatencyHistogram::percentile(counts, 1.0));
+}
+
+void LatencyMonitor::publishReport(const ros::WallTimerEvent&)
+{
+    for (size_t i = 0; i < stages_.size(); i++) {
+        reportStage(stages_[i], *counts_, report_.status[i]);
+    }
+
+    report_.header.stamp = ros::Time::now();
+    report_publisher_.publish(report_);
+}
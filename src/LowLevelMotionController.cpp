@@ -12,18 +12,28 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 #include "actionlib/server/simple_action_server.h"
 #include "dynamic_reconfigure/server.h"
 
+#include "iarc7_motion/ControlLoopTimer.hpp"
+#include "iarc7_motion/LatencyHistogram.hpp"
+#include "iarc7_motion/LatencyMonitor.hpp"
 #include "iarc7_motion/MotionPointInterpolator.hpp"
 #include "iarc7_motion/LandPlanner.hpp"
 #include "iarc7_motion/LowLevelMotionConfig.h"
 #include "iarc7_motion/QuadVelocityController.hpp"
 #include "iarc7_motion/QuadTwistRequestLimiter.hpp"
+#include "iarc7_motion/StateInterpolator.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
 #include "iarc7_motion/TakeoffController.hpp"
-#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/StaticThrustModel.hpp"
 
 #include "iarc7_safety/SafetyClient.hpp"
 
@@ -34,6 +44,10 @@
 
 #include "iarc7_motion/GroundInteractionAction.h"
 
+#include "iarc7_msgs/Float64ArrayStamped.h"
+
+#include "nav_msgs/Odometry.h"
+
 using namespace Iarc7Motion;
 using geometry_msgs::TwistStamped;
 using geometry_msgs::Twist;
@@ -46,6 +60,17 @@ enum class MotionState { TAKEOFF,
                          GROUNDED,
                          PASSTHROUGH };
 
+// Gains set through dynamic reconfigure, handed from the thread servicing
+// it to the control thread
+struct ControllerGains
+{
+    double throttle_pid[6];
+    double pitch_pid[6];
+    double roll_pid[6];
+    double position_p[3];
+    double yaw_p;
+};
+
 // This is a helper function that will limit a
 // iarc7_msgs::OrientationThrottleStamped using the twist limiter
 //
@@ -96,7 +121,7 @@ int main(int argc, char **argv)
     double position_p[3];
     double yaw_p;
 
-    ThrustModel thrust_model(private_nh, "thrust_model");
+    VerticalThrustModel thrust_model(private_nh, "thrust_model");
     ThrustModel thrust_model_side;
     if(ros_utils::ParamUtils::getParam<std::string>(
               private_nh,
@@ -105,50 +130,95 @@ int main(int argc, char **argv)
         thrust_model_side.loadModel(private_nh, "thrust_model_side");
     }
 
-    double battery_timeout;
     Twist min_velocity, max_velocity, max_velocity_slew_rate;
     double update_frequency;
+    bool update_on_odometry;
+    double odometry_trigger_timeout;
+
+    // With a dedicated control thread the action server and dynamic
+    // reconfigure are serviced on their own queue by another thread, so
+    // they never delay an update. The state estimates and the plans are
+    // received on threads of their own in any case.
+    const ControlThreadSettings control_thread
+        = ControlThreadSettings::load(private_nh, "control_thread");
+    ros::CallbackQueue service_queue;
+    ros::NodeHandle service_nh;
+    ros::NodeHandle service_private_nh("~");
+    if (control_thread.enabled) {
+        service_nh.setCallbackQueue(&service_queue);
+        service_private_nh.setCallbackQueue(&service_queue);
+    }
 
-    // Set up dynamic reconfigure
+    // Set up dynamic reconfigure. With a control thread the callback runs
+    // on the service thread, so it only hands the new gains over, and the
+    // control thread copies them in between updates.
     bool dynamic_reconfigure_called = false;
-    dynamic_reconfigure::Server<iarc7_motion::LowLevelMotionConfig> dynamic_reconfigure_server;
+    std::mutex reconfigure_mutex;
+    ControllerGains reconfigure_gains;
+    bool reconfigure_pending = false;
+    dynamic_reconfigure::Server<iarc7_motion::LowLevelMotionConfig> dynamic_reconfigure_server(
+            service_private_nh);
     boost::function<void(iarc7_motion::LowLevelMotionConfig &config,
                          uint32_t level)> dynamic_reconfigure_settings_callback =
         [&](iarc7_motion::LowLevelMotionConfig &config, uint32_t) {
-
-            throttle_pid[0] = config.throttle_p;
-            throttle_pid[1] = config.throttle_i;
-            throttle_pid[2] = config.throttle_d;
-            throttle_pid[3] = config.throttle_accumulator_max;
-            throttle_pid[4] = config.throttle_accumulator_min;
-            throttle_pid[5] = config.throttle_accumulator_enable_threshold;
-
-            pitch_pid[0] = config.pitch_p;
-            pitch_pid[1] = config.pitch_i;
-            pitch_pid[2] = config.pitch_d;
-            pitch_pid[3] = config.pitch_accumulator_max;
-            pitch_pid[4] = config.pitch_accumulator_min;
-            pitch_pid[5] = config.pitch_accumulator_enable_threshold;
-
-            roll_pid[0] = config.roll_p;
-            roll_pid[1] = config.roll_i;
-            roll_pid[2] = config.roll_d;
-            roll_pid[3] = config.roll_accumulator_max;
-            roll_pid[4] = config.roll_accumulator_min;
-            roll_pid[5] = config.roll_accumulator_enable_threshold;
-
-            position_p[0] = config.position_p_x;
-            position_p[1] = config.position_p_y;
-            position_p[2] = config.position_p_z;
-
-            yaw_p = config.yaw_p;
-
-            dynamic_reconfigure_called = true;
+            std::lock_guard<std::mutex> lock(reconfigure_mutex);
+
+            reconfigure_gains.throttle_pid[0] = config.throttle_p;
+            reconfigure_gains.throttle_pid[1] = config.throttle_i;
+            reconfigure_gains.throttle_pid[2] = config.throttle_d;
+            reconfigure_gains.throttle_pid[3] = config.throttle_accumulator_max;
+            reconfigure_gains.throttle_pid[4] = config.throttle_accumulator_min;
+            reconfigure_gains.throttle_pid[5] = config.throttle_accumulator_enable_threshold;
+
+            reconfigure_gains.pitch_pid[0] = config.pitch_p;
+            reconfigure_gains.pitch_pid[1] = config.pitch_i;
+            reconfigure_gains.pitch_pid[2] = config.pitch_d;
+            reconfigure_gains.pitch_pid[3] = config.pitch_accumulator_max;
+            reconfigure_gains.pitch_pid[4] = config.pitch_accumulator_min;
+            reconfigure_gains.pitch_pid[5] = config.pitch_accumulator_enable_threshold;
+
+            reconfigure_gains.roll_pid[0] = config.roll_p;
+            reconfigure_gains.roll_pid[1] = config.roll_i;
+            reconfigure_gains.roll_pid[2] = config.roll_d;
+            reconfigure_gains.roll_pid[3] = config.roll_accumulator_max;
+            reconfigure_gains.roll_pid[4] = config.roll_accumulator_min;
+            reconfigure_gains.roll_pid[5] = config.roll_accumulator_enable_threshold;
+
+            reconfigure_gains.position_p[0] = config.position_p_x;
+            reconfigure_gains.position_p[1] = config.position_p_y;
+            reconfigure_gains.position_p[2] = config.position_p_z;
+
+            reconfigure_gains.yaw_p = config.yaw_p;
+
+            reconfigure_pending = true;
         };
-    dynamic_reconfigure_server.setCallback(dynamic_reconfigure_settings_callback);
 
-    // Battery timeout setting
-    ROS_ASSERT(private_nh.getParam("battery_timeout", battery_timeout));
+    // Copies in gains handed over by dynamic reconfigure. Never waits on
+    // the service thread, gains it is still writing are taken next time.
+    auto apply_reconfigured_gains = [&]() -> void {
+        std::unique_lock<std::mutex> lock(reconfigure_mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !reconfigure_pending) {
+            return;
+        }
+
+        std::copy(std::begin(reconfigure_gains.throttle_pid),
+                  std::end(reconfigure_gains.throttle_pid),
+                  throttle_pid);
+        std::copy(std::begin(reconfigure_gains.pitch_pid),
+                  std::end(reconfigure_gains.pitch_pid),
+                  pitch_pid);
+        std::copy(std::begin(reconfigure_gains.roll_pid),
+                  std::end(reconfigure_gains.roll_pid),
+                  roll_pid);
+        std::copy(std::begin(reconfigure_gains.position_p),
+                  std::end(reconfigure_gains.position_p),
+                  position_p);
+        yaw_p = reconfigure_gains.yaw_p;
+
+        reconfigure_pending = false;
+        dynamic_reconfigure_called = true;
+    };
+    dynamic_reconfigure_server.setCallback(dynamic_reconfigure_settings_callback);
 
     // Throttle Limit settings retrieve
     private_nh.param("throttle_max", max_velocity.linear.z, 0.0);
@@ -173,16 +243,23 @@ int main(int argc, char **argv)
     // Update frequency retrieve
     private_nh.param("update_frequency", update_frequency, 60.0);
 
+    // Event driven update settings retrieve
+    private_nh.param("update_on_odometry", update_on_odometry, false);
+    private_nh.param("odometry_trigger_timeout", odometry_trigger_timeout, 0.05);
+    ROS_ASSERT(odometry_trigger_timeout > 0.0);
+
     ros::Rate limit_check_for_simulated_time = ros::Rate(30);
     // Wait for a valid time in case we are using simulated time (not wall time)
     // Also wait for dynamic reconfigure to be called once
     while (ros::ok() && (ros::Time::now() == ros::Time(0) || !dynamic_reconfigure_called)) {
         // wait
         ros::spinOnce();
+        service_queue.callAvailable();
+        apply_reconfigured_gains();
         limit_check_for_simulated_time.sleep();
     }
 
-    Server server(nh,
+    Server server(service_nh,
                   "ground_interaction_action",
                   false);
     server.start();
@@ -190,6 +267,15 @@ int main(int argc, char **argv)
     // This assumes that we start on the ground
     MotionState motion_state = MotionState::GROUNDED;
 
+    // Create the state interpolator. It gathers the state every controller
+    // needs once per update.
+    StateInterpolator state_interpolator(nh, private_nh);
+    if (!state_interpolator.waitUntilReady())
+    {
+        ROS_ERROR("Failed during initialization of StateInterpolator");
+        return 1;
+    }
+
     // Create a quad velocity controller. It will output angles corresponding
     // to our desired velocity
     QuadVelocityController quadController(throttle_pid,
@@ -199,10 +285,8 @@ int main(int argc, char **argv)
                                           yaw_p,
                                           thrust_model,
                                           thrust_model_side,
-                                          ros::Duration(battery_timeout),
-                                          nh,
                                           private_nh);
-    if (!quadController.waitUntilReady())
+    if (!quadController.waitUntilReady(state_interpolator))
     {
         ROS_ERROR("Failed during initialization of QuadVelocityController");
         return 1;
@@ -225,7 +309,7 @@ int main(int argc, char **argv)
 
     // Create a motion point interpolator. It handles interpolation between
     // timestamped motion point requests.
-    MotionPointInterpolator motion_point_interpolator(nh);
+    MotionPointInterpolator motion_point_interpolator(nh, private_nh);
 
     // Create the publisher to send the processed uav_commands out with
     // (angles, throttle)
@@ -262,6 +346,31 @@ int main(int argc, char **argv)
         };
     ros::Subscriber passthrough_sub = nh.subscribe("passthrough_command", 2, passthrough_callback);
 
+    // When updating on odometry the loop waits on its own queue for each
+    // new odometry message and runs the update at its stamp. The
+    // StateInterpolator receives the same message on its own thread, and
+    // getSnapshot waits for it to arrive.
+    ros::CallbackQueue odometry_trigger_queue;
+    bool odometry_received = false;
+    ros::Time odometry_stamp;
+    boost::function<void(const nav_msgs::Odometry::ConstPtr&)> odometry_trigger_callback =
+        [&](const nav_msgs::Odometry::ConstPtr& msg) -> void {
+            odometry_received = true;
+            odometry_stamp = msg->header.stamp;
+        };
+    ros::Subscriber odometry_trigger_sub;
+    if (update_on_odometry) {
+        ros::NodeHandle odometry_trigger_nh(nh);
+        odometry_trigger_nh.setCallbackQueue(&odometry_trigger_queue);
+        odometry_trigger_sub = odometry_trigger_nh.subscribe("odometry/filtered",
+                                                             1,
+                                                             odometry_trigger_callback);
+    }
+
+    // Set when odometry stops arriving, updates then run at update_frequency
+    // until it comes back
+    bool odometry_stalled = false;
+
     // Form a connection with the node monitor. If no connection can be made
     // assert because we don't know what's going on with the other nodes.
     ROS_INFO("low_level_motion: Attempting to form safety bond");
@@ -269,13 +378,55 @@ int main(int argc, char **argv)
     ROS_ASSERT_MSG(safety_client.formBond(),
                    "low_level_motion: Could not form bond with safety client");
 
+    // Time taken by each stage of the control loop, published along with
+    // the stages of the QuadVelocityController's update
+    LatencyHistogram tick_latency;
+    LatencyHistogram target_latency;
+    LatencyHistogram limiter_latency;
+    LatencyHistogram publish_latency;
+    LatencyHistogram callbacks_latency;
+    LatencyMonitor latency_monitor(nh, private_nh);
+    latency_monitor.addStage("tick", tick_latency);
+    latency_monitor.addStage("target", target_latency);
+    latency_monitor.addStage("limiter", limiter_latency);
+    latency_monitor.addStage("publish", publish_latency);
+    latency_monitor.addStage("callbacks", callbacks_latency);
+    state_interpolator.addLatencyStages(latency_monitor);
+    quadController.addLatencyStages(latency_monitor);
+    latency_monitor.start();
+
+    // Start servicing the action server and dynamic reconfigure, before
+    // the control thread's scheduling is changed so this thread doesn't
+    // inherit it
+    ros::AsyncSpinner service_spinner(1, &service_queue);
+    ros::Publisher control_loop_timing_pub;
+    if (control_thread.enabled) {
+        service_spinner.start();
+
+        if (!control_thread.applyToCurrentThread()) {
+            ROS_ERROR("Failed to set up the control thread");
+            return 1;
+        }
+
+        // Period, jitter and work time of each tick (s), and the total
+        // number of missed deadlines
+        control_loop_timing_pub = nh.advertise<iarc7_msgs::Float64ArrayStamped>(
+                "control_loop_timing", 50);
+    }
+    iarc7_msgs::Float64ArrayStamped control_loop_timing;
+
     // Cache the time
     ros::Time last_time = ros::Time::now();
 
     ros::Rate rate (update_frequency);
+    ControlLoopTimer control_loop_timer(update_frequency);
 
     iarc7_msgs::OrientationThrottleStamped last_uav_command;
 
+    // State of the quad at the time of the current update, kept between
+    // updates so its storage is reused
+    StateSnapshot state;
+
     // Run until ROS says we need to shutdown
     while (ros::ok())
     {
@@ -286,14 +437,46 @@ int main(int argc, char **argv)
         ROS_ASSERT_MSG(!safety_client.isFatalActive(),
                        "low_level_motion: fatal event from safety");
 
+        // Take new gains between updates, never during one
+        apply_reconfigured_gains();
+
         // Get the time
-        ros::Time current_time = ros::Time::now();
+        ros::Time current_time;
+        if (update_on_odometry) {
+            // Wait for the next odometry message, or fall back to a timed
+            // update if the estimate stalls
+            odometry_received = false;
+            odometry_trigger_queue.callAvailable(ros::WallDuration(
+                    odometry_stalled ? 1.0 / update_frequency
+                                     : odometry_trigger_timeout));
+
+            if (odometry_received) {
+                if (odometry_stalled) {
+                    ROS_INFO("low_level_motion: odometry resumed, updating on odometry");
+                    odometry_stalled = false;
+                }
+                current_time = odometry_stamp;
+            } else {
+                if (!odometry_stalled) {
+                    ROS_WARN("low_level_motion: no odometry for %f seconds, "
+                             "updating at %f Hz",
+                             odometry_trigger_timeout,
+                             update_frequency);
+                    odometry_stalled = true;
+                }
+                current_time = ros::Time::now();
+            }
+        } else {
+            current_time = ros::Time::now();
+        }
 
         // Make sure we don't call QuadVelocity controllers update unless we
         // have a new timestamp to give. This can be a problem with simulated
-        // time that does not update with high precision.
+        // time that does not update with high precision, and with odometry
+        // stamped before a timed update made while it was stalled.
         if(current_time > last_time)
         {
+            ScopedLatencyTimer tick_timer(tick_latency);
             last_time = current_time;
 
             //cancellation inputs
@@ -392,10 +575,22 @@ int main(int argc, char **argv)
                 }
             }
 
+            // Gather the state once for every controller. Nothing runs
+            // on the ground, so there is nothing to gather.
+            if (motion_state != MotionState::GROUNDED) {
+                bool success = state_interpolator.getSnapshot(current_time, state);
+                ROS_ASSERT_MSG(success, "LowLevelMotion failed to get the state of the quad");
+            }
+
             //  This will contain the target twist or velocity that we want to achieve
             iarc7_msgs::MotionPointStamped target_motion_point;
             iarc7_msgs::OrientationThrottleStamped uav_command;
 
+            // Take in plans whatever the state, so plans sent during takeoff
+            // or on the ground are waiting when velocity control starts
+            motion_point_interpolator.takePlans(
+                    current_time + ros::Duration(thrust_model.response_lag));
+
             // Check for a safety state in which case we should execute our safety response
             if(safety_client.isSafetyActive()
                && !safety_client.isSafetyResponseActive())
@@ -410,27 +605,29 @@ int main(int argc, char **argv)
             else if(motion_state == MotionState::VELOCITY_CONTROL)
             {
                 // If nothing is wrong get a motion point target from the uav motion point interpolator
-                MotionPointStamped motion_point;
-                motion_point_interpolator.getTargetMotionPoint(
-                        current_time + ros::Duration(thrust_model.response_lag),
-                        target_motion_point);
+                {
+                    ScopedLatencyTimer target_timer(target_latency);
+                    motion_point_interpolator.getTargetMotionPoint(
+                            current_time + ros::Duration(thrust_model.response_lag),
+                            target_motion_point);
+                }
 
                 // Request the appropriate throttle and angle settings for the desired motion point
                 quadController.setTargetVelocity(target_motion_point);
 
                 // Get the next uav command that is appropriate for the desired velocity
-                bool success = quadController.update(current_time, uav_command);
+                bool success = quadController.update(state, uav_command);
                 ROS_ASSERT_MSG(success, "LowLevelMotion quad velocity controller update failed");
             }
             else if(motion_state == MotionState::TAKEOFF)
             {
-                bool success = takeoffController.update(current_time, uav_command);
+                bool success = takeoffController.update(state, uav_command);
                 ROS_ASSERT_MSG(success, "LowLevelMotion takeoff controller update failed");
 
                 if(takeoffController.isDone())
                 {
                     server.setSucceeded();
-                    ThrustModel new_model = takeoffController.getThrustModel();
+                    VerticalThrustModel new_model = takeoffController.getThrustModel();
                     quadController.setThrustModel(new_model);
                     success = quadController.prepareForTakeover();
                     ROS_ASSERT_MSG(success, "LowLevelMotion switching to velocity control failed");
@@ -441,13 +638,17 @@ int main(int argc, char **argv)
             }
             else if(motion_state == MotionState::LAND)
             {
-                bool success = landPlanner.getTargetMotionPoint(current_time, target_motion_point);
+                bool success;
+                {
+                    ScopedLatencyTimer target_timer(target_latency);
+                    success = landPlanner.getTargetMotionPoint(state, target_motion_point);
+                }
                 ROS_ASSERT_MSG(success, "LowLevelMotion LandPlanner getTargetTwist failed");
 
                 quadController.setTargetVelocity(target_motion_point);
 
                 // Get the next uav command that is appropriate for the desired velocity
-                success = quadController.update(current_time, uav_command);
+                success = quadController.update(state, uav_command);
                 ROS_ASSERT_MSG(success, "LowLevelMotion quad velocity controller update failed");
 
                 if(landPlanner.isDone())
@@ -462,6 +663,9 @@ int main(int argc, char **argv)
                     success = quadController.prepareForTakeover();
                     ROS_ASSERT_MSG(success, "LowLevelMotion switching to velocity control failed");
                     motion_state = MotionState::GROUNDED;
+
+                    // Take off next time with the model as corrected in flight
+                    takeoffController.setThrustModel(quadController.getThrustModel());
                 }
             }
             else if(motion_state == MotionState::GROUNDED)
@@ -477,7 +681,7 @@ int main(int argc, char **argv)
                     motion_point.motion_point.twist.linear.z = twist.linear.z;
 
                     quadController.setTargetVelocity(motion_point);
-                    bool success = quadController.update(current_time,
+                    bool success = quadController.update(state,
                                                          uav_command,
                                                          true,
                                                          last_msg->data.pitch,
@@ -495,21 +699,49 @@ int main(int argc, char **argv)
 
             //ROS_ERROR_STREAM("Pre limiter: " << uav_command);
             // Limit the uav command with the twist limiter before sending the uav command
-            limitUavCommand(limiter, uav_command);
+            {
+                ScopedLatencyTimer limiter_timer(limiter_latency);
+                limitUavCommand(limiter, uav_command);
+            }
             //ROS_ERROR_STREAM("Post limiter: " << uav_command);
 
+            ScopedLatencyTimer publish_timer(publish_latency);
+
             // Publish the current target velocity
             motion_point_target_.publish(target_motion_point);
 
             // Publish the desired angles and throttle to the topic
             uav_control_.publish(uav_command);
+            publish_timer.stop();
 
             last_uav_command = uav_command;
         }
 
-        // Handle all ROS callbacks
-        ros::spinOnce();
-        rate.sleep();
+        // Handle all ROS callbacks, except for the state estimates and
+        // motion point plans which the StateInterpolator and
+        // MotionPointInterpolator receive on their own threads, and the
+        // action server and dynamic reconfigure when they have their own
+        {
+            ScopedLatencyTimer callbacks_timer(callbacks_latency);
+            ros::spinOnce();
+        }
+
+        // Updating on odometry waits for the next message instead
+        if (!update_on_odometry) {
+            if (control_thread.enabled) {
+                control_loop_timer.sleep();
+
+                const ControlLoopStats& stats = control_loop_timer.stats();
+                control_loop_timing.header.stamp = ros::Time::now();
+                control_loop_timing.data = {stats.period_ns * 1e-9,
+                                            stats.jitter_ns * 1e-9,
+                                            stats.work_ns * 1e-9,
+                                            static_cast<double>(stats.deadline_misses)};
+                control_loop_timing_pub.publish(control_loop_timing);
+            } else {
+                rate.sleep();
+            }
+        }
     }
 
     // All is good.
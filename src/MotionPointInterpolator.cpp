@@ -12,25 +12,131 @@
 
 //System Headers
 #include <algorithm>
+#include <cmath>
+
+#include "iarc7_msgs/Float64ArrayStamped.h"
+#include "ros_utils/ParamUtils.hpp"
 
 using namespace Iarc7Motion;
 
+namespace
+{
+
+// Longest time since the last target was given to the controller for it to
+// still be following the targets, several control periods
+const int64_t kFollowingTimeoutNs = 100000000;
+
+// Fits a polynomial in time to the positions of each axis matching the
+// positions and velocities at both ends, and the accelerations too if
+// quintic, then evaluates it and its first two derivatives t seconds after
+// begin. span is the seconds between begin and end.
+void interpolateHermite(const TrajectorySample& begin,
+                        const TrajectorySample& end,
+                        double span,
+                        double t,
+                        bool quintic,
+                        TrajectorySample& interpolated)
+{
+    typedef Eigen::Map<const Eigen::Array3d> ConstAxes;
+    typedef Eigen::Map<Eigen::Array3d> Axes;
+
+    const ConstAxes p0(begin.values + TrajectorySample::kPositionX);
+    const ConstAxes v0(begin.values + TrajectorySample::kVelocityX);
+    const ConstAxes a0(begin.values + TrajectorySample::kAccelX);
+    const ConstAxes p1(end.values + TrajectorySample::kPositionX);
+    const ConstAxes v1(end.values + TrajectorySample::kVelocityX);
+    const ConstAxes a1(end.values + TrajectorySample::kAccelX);
+
+    // Coefficients of t^2 and up, the lower two are p0 and v0
+    Eigen::Array3d c2, c3, c4, c5;
+    if(quintic)
+    {
+        // Position and velocity at the end left over after following
+        // the starting acceleration
+        const Eigen::Array3d dp = p1 - p0 - span * v0 - 0.5 * span * span * a0;
+        const Eigen::Array3d dv = span * (v1 - v0 - span * a0);
+        const Eigen::Array3d da = span * span * (a1 - a0);
+
+        c2 = 0.5 * a0;
+        c3 = (10.0 * dp - 4.0 * dv + 0.5 * da) / std::pow(span, 3);
+        c4 = (-15.0 * dp + 7.0 * dv - da) / std::pow(span, 4);
+        c5 = (6.0 * dp - 3.0 * dv + 0.5 * da) / std::pow(span, 5);
+    }
+    else
+    {
+        const Eigen::Array3d dp = p1 - p0 - span * v0;
+        const Eigen::Array3d dv = span * (v1 - v0);
+
+        c2 = (3.0 * dp - dv) / (span * span);
+        c3 = (-2.0 * dp + dv) / std::pow(span, 3);
+        c4.setZero();
+        c5.setZero();
+    }
+
+    Axes(interpolated.values + TrajectorySample::kPositionX)
+        = p0 + t * (v0 + t * (c2 + t * (c3 + t * (c4 + t * c5))));
+    Axes(interpolated.values + TrajectorySample::kVelocityX)
+        = v0 + t * (2.0 * c2 + t * (3.0 * c3 + t * (4.0 * c4 + t * 5.0 * c5)));
+    Axes(interpolated.values + TrajectorySample::kAccelX)
+        = 2.0 * c2 + t * (6.0 * c3 + t * (12.0 * c4 + t * 20.0 * c5));
+}
+
+} // End anonymous namespace
+
 // Construct the object need a node handle to register
 // the subscriber for velocity targets
-MotionPointInterpolator::MotionPointInterpolator(ros::NodeHandle& nh) :
+MotionPointInterpolator::MotionPointInterpolator(ros::NodeHandle& nh,
+                                                 ros::NodeHandle& private_nh) :
+interpolation_mode_(interpolationModeFromName(
+    ros_utils::ParamUtils::getParam<std::string>(private_nh, "motion_point_interpolation"))),
+velocity_profile_generator_(VelocityProfileSettings::load(private_nh, "velocity_profile")),
+pending_plans_(),
+plan_callback_queue_(),
 motion_points_subscriber_(),
-motion_point_targets_()
+polynomial_trajectory_subscriber_(),
+velocity_goal_subscriber_(),
+plan_spinner_(1, &plan_callback_queue_),
+motion_point_targets_(queueCapacity(
+    ros_utils::ParamUtils::getParam<double>(private_nh, "motion_point_queue_duration"),
+    ros_utils::ParamUtils::getParam<double>(private_nh, "motion_point_queue_timestep")))
 {
-    motion_points_subscriber_ = nh.subscribe(
+    // Put an initial time in the buffer so that buffer is never empty
+    iarc7_msgs::MotionPointStampedArray::Ptr zero_plan(
+            new iarc7_msgs::MotionPointStampedArray());
+    zero_plan->motion_points.resize(1);
+    zero_plan->motion_points[0].header.stamp = ros::Time::now();
+    const bool pushed = motion_point_targets_.push_back(zero_plan, 0, 1);
+    ROS_ASSERT(pushed);
+
+    const double blend_duration = ros_utils::ParamUtils::getParam<double>(
+            private_nh, "motion_point_splice_blend_duration");
+    ROS_ASSERT_MSG(blend_duration >= 0.0,
+                   "Motion point splice blend duration must not be negative");
+    plan_splice_.blend_duration_ns = std::llround(blend_duration * 1e9);
+
+    splice_debug_publisher_ = nh.advertise<iarc7_msgs::Float64ArrayStamped>(
+                    "motion_point_splice_debug",
+                    100);
+
+    ros::NodeHandle plan_nh(nh);
+    plan_nh.setCallbackQueue(&plan_callback_queue_);
+    motion_points_subscriber_ = plan_nh.subscribe(
                     "motion_point_targets",
                     100,
                     &MotionPointInterpolator::processMotionPointArray,
                     this);
+    polynomial_trajectory_subscriber_ = plan_nh.subscribe(
+                    "polynomial_trajectory_targets",
+                    100,
+                    &MotionPointInterpolator::processPolynomialTrajectory,
+                    this);
+    velocity_goal_subscriber_ = plan_nh.subscribe(
+                    "velocity_goal_targets",
+                    100,
+                    &MotionPointInterpolator::processVelocityGoal,
+                    this);
 
-    // Put an initial time in the buffer so that buffer is never empty
-    MotionPointStamped zero_state;
-    zero_state.header.stamp = ros::Time::now();
-    motion_point_targets_.emplace_back(zero_state);
+    plan_spinner_.start();
 }
 
 // Called by a class user to get a target motion point
@@ -40,97 +146,367 @@ void MotionPointInterpolator::getTargetMotionPoint(
                 const ros::Time& current_time,
                 MotionPointStamped& target_motion_point)
 {
+    takePlans(current_time);
+
+    TrajectorySample target;
+    if(!sampleTargets(motion_point_targets_,
+                      polynomial_targets_,
+                      plan_splice_,
+                      current_time,
+                      interpolation_mode_,
+                      target_cursor_,
+                      target))
+    {
+        ROS_ERROR("Motion Point Interpolation failed, not filling out target motion point");
+        return;
+    }
+
+    plan_splice_.last_target_ns = current_time.toNSec();
+    target.toMessage(target_motion_point);
+}
+
+// Appends the plans the plan thread handed off since the last call and
+// drops the targets before current_time
+void MotionPointInterpolator::takePlans(const ros::Time& current_time)
+{
+    const uint64_t splices = plan_splice_.metrics.splices;
+    applyPendingPlans(pending_plans_,
+                      current_time,
+                      motion_point_targets_,
+                      polynomial_targets_,
+                      plan_splice_,
+                      velocity_profile_generator_,
+                      interpolation_mode_);
+
+    // Publish the jumps of the last plan spliced in
+    if(plan_splice_.metrics.splices != splices)
+    {
+        iarc7_msgs::Float64ArrayStamped debug_msg;
+        debug_msg.header.stamp = current_time;
+        debug_msg.data = {plan_splice_.metrics.last_position_jump,
+                          plan_splice_.metrics.last_velocity_jump,
+                          plan_splice_.metrics.last_accel_jump};
+        splice_debug_publisher_.publish(debug_msg);
+    }
+
+    trimTargets(motion_point_targets_, polynomial_targets_, current_time);
+}
+
+// Targets at each of times, which must be increasing, as of the last
+// call to getTargetMotionPoint
+bool MotionPointInterpolator::getTargetMotionPoints(
+                const std::vector<ros::Time>& times,
+                std::vector<MotionPointStamped>& target_motion_points) const
+{
+    // Leave the control loop's cursor where the last tick put it
+    TargetCursor cursor = target_cursor_;
+
+    // Each target goes straight into the caller's messages, which keep
+    // their capacity between calls
+    target_motion_points.resize(times.size());
+    TrajectorySample target;
+    for(size_t i = 0; i < times.size(); i++)
+    {
+        if(i > 0 && !(times[i - 1] < times[i]))
+        {
+            ROS_ERROR("getTargetMotionPoints times out of order at %lf", times[i].toSec());
+            target_motion_points.resize(i);
+            return false;
+        }
+
+        if(!peekTargets(motion_point_targets_,
+                        polynomial_targets_,
+                        plan_splice_,
+                        times[i],
+                        interpolation_mode_,
+                        cursor,
+                        target))
+        {
+            target_motion_points.resize(i);
+            return false;
+        }
+        target.toMessage(target_motion_points[i]);
+    }
+    return true;
+}
+
+// Target at time from the polynomial targets if they cover it, otherwise
+// interpolated from the motion point queue, which is trimmed
+bool MotionPointInterpolator::sampleTargets(
+        MotionPointQueue& motion_points,
+        PolynomialTargets& polynomial_targets,
+        const PlanSplice& plan_splice,
+        const ros::Time& time,
+        InterpolationMode mode,
+        TargetCursor& cursor,
+        TrajectorySample& target)
+{
+    trimTargets(motion_points, polynomial_targets, time);
+    return peekTargets(motion_points, polynomial_targets, plan_splice, time, mode, cursor, target);
+}
 
-    // Trim velocity queue when done we will have one or two velocities available.
-    trimMotionPointQueue(motion_point_targets_, current_time);
+// Drops the targets before time that are no longer needed
+void MotionPointInterpolator::trimTargets(
+        MotionPointQueue& motion_points,
+        PolynomialTargets& polynomial_targets,
+        const ros::Time& time)
+{
+    // Release the polynomial trajectory once a dense plan has taken over
+    if(polynomial_targets.trajectory
+            && static_cast<int64_t>(time.toNSec()) >= polynomial_targets.end_ns)
+    {
+        polynomial_targets.trajectory.reset();
+    }
 
-    if(motion_point_targets_.size() == 1)
+    // Trim velocity queue when done we will have one or two velocities
+    // available. Motion points a dense plan queued to take over from a
+    // trajectory later are kept.
+    if(!motion_points.empty() && motion_points.front().header.stamp < time)
     {
-        target_motion_point = motion_point_targets_[0];
+        trimMotionPointQueue(motion_points, time);
+    }
+}
+
+// Same target as sampleTargets without trimming or releasing anything
+bool MotionPointInterpolator::peekTargets(
+        const MotionPointQueue& motion_points,
+        const PolynomialTargets& polynomial_targets,
+        const PlanSplice& plan_splice,
+        const ros::Time& time,
+        InterpolationMode mode,
+        TargetCursor& cursor,
+        TrajectorySample& target)
+{
+    const int64_t time_ns = time.toNSec();
+
+    if(polynomial_targets.trajectory
+            && time_ns >= polynomial_targets.trajectory->startNs()
+            && time_ns < polynomial_targets.end_ns)
+    {
+        if(!polynomial_targets.trajectory->sample(time_ns, target, cursor.segment))
+        {
+            return false;
+        }
     }
     else
     {
-        bool success = interpolateMotionPoints(
-            motion_point_targets_[0],
-            motion_point_targets_[1],
-            target_motion_point,
-            current_time);
+        if(motion_points.empty())
+        {
+            return false;
+        }
+
+        // Motion points either side of time, the last one is held after
+        // the end of the queue
+        const size_t index = motion_points.lowerBound(time, cursor.motion_point);
+        cursor.motion_point = index;
+        if(index == motion_points.size())
+        {
+            target = TrajectorySample::fromMessage(motion_points.back());
+        }
+        else if(motion_points[index].header.stamp == time)
+        {
+            target = TrajectorySample::fromMessage(motion_points[index]);
+        }
+        else if(index == 0
+                || !interpolateMotionPoints(
+                        TrajectorySample::fromMessage(motion_points[index - 1]),
+                        TrajectorySample::fromMessage(motion_points[index]),
+                        target,
+                        time_ns,
+                        mode))
+        {
+            return false;
+        }
+    }
+
+    // Add what is left of the jump from the last splice
+    if(time_ns < plan_splice.blend_end_ns && time_ns >= plan_splice.offset.stamp_ns)
+    {
+        TrajectorySample zero;
+        zero.vector().setZero();
+        zero.stamp_ns = plan_splice.blend_end_ns;
+
+        TrajectorySample offset;
+        const bool blended = interpolateMotionPoints(plan_splice.offset,
+                                                     zero,
+                                                     offset,
+                                                     time_ns,
+                                                     InterpolationMode::QUINTIC);
+        ROS_ASSERT(blended);
+        target.vector() += offset.vector();
+    }
+
+    return true;
+}
+
+// Same as peekTargets at each of times, which must be increasing, in
+// one sweep from cursor
+bool MotionPointInterpolator::peekTargets(
+        const MotionPointQueue& motion_points,
+        const PolynomialTargets& polynomial_targets,
+        const PlanSplice& plan_splice,
+        const std::vector<ros::Time>& times,
+        InterpolationMode mode,
+        TargetCursor& cursor,
+        std::vector<TrajectorySample>& targets)
+{
+    targets.resize(times.size());
+    for(size_t i = 0; i < times.size(); i++)
+    {
+        if(i > 0 && !(times[i - 1] < times[i]))
+        {
+            ROS_ERROR("peekTargets times out of order at %lf", times[i].toSec());
+            targets.resize(i);
+            return false;
+        }
 
-        if(!success)
+        if(!peekTargets(motion_points,
+                        polynomial_targets,
+                        plan_splice,
+                        times[i],
+                        mode,
+                        cursor,
+                        targets[i]))
         {
-            ROS_ERROR("Motion Point Interpolation failed, not filling out target motion point");
-            return;
+            targets.resize(i);
+            return false;
         }
     }
+    return true;
 }
 
-// Takes two twists and interpolates between their values
-// using linear interpolation
-bool MotionPointInterpolator::interpolateMotionPoints(
-        MotionPointStamped& begin,
-        MotionPointStamped& end,
-        MotionPointStamped& interpolated,
-        ros::Time time)
+// Records the jump from before, the target at time before a plan was
+// appended, to the target now and starts blending it out
+void MotionPointInterpolator::spliceTargets(
+        const MotionPointQueue& motion_points,
+        const PolynomialTargets& polynomial_targets,
+        const TrajectorySample& before,
+        const ros::Time& time,
+        InterpolationMode mode,
+        PlanSplice& plan_splice)
 {
+    // The new targets replace the old blend
+    plan_splice.blend_end_ns = std::numeric_limits<int64_t>::min();
 
-    ros::Time begin_time = begin.header.stamp;
-    ros::Time end_time   = end.header.stamp;
+    TrajectorySample after;
+    TargetCursor cursor;
+    if(!peekTargets(motion_points, polynomial_targets, plan_splice, time, mode, cursor, after))
+    {
+        return;
+    }
 
+    plan_splice.offset.vector() = before.vector() - after.vector();
+    plan_splice.offset.stamp_ns = time.toNSec();
+
+    SpliceMetrics& metrics = plan_splice.metrics;
+    metrics.splices++;
+    metrics.last_position_jump = Eigen::Map<const Eigen::Vector3d>(
+            plan_splice.offset.values + TrajectorySample::kPositionX).norm();
+    metrics.last_velocity_jump = Eigen::Map<const Eigen::Vector3d>(
+            plan_splice.offset.values + TrajectorySample::kVelocityX).norm();
+    metrics.last_accel_jump = Eigen::Map<const Eigen::Vector3d>(
+            plan_splice.offset.values + TrajectorySample::kAccelX).norm();
+    metrics.max_position_jump = std::max(metrics.max_position_jump,
+                                         metrics.last_position_jump);
+    metrics.max_velocity_jump = std::max(metrics.max_velocity_jump,
+                                         metrics.last_velocity_jump);
+    metrics.max_accel_jump = std::max(metrics.max_accel_jump,
+                                      metrics.last_accel_jump);
+
+    if(plan_splice.blend_duration_ns > 0)
+    {
+        plan_splice.blend_end_ns = plan_splice.offset.stamp_ns
+                                 + plan_splice.blend_duration_ns;
+    }
+}
+
+// Takes two samples and interpolates between their values
+// using the given mode, time_ns is in nanoseconds
+bool MotionPointInterpolator::interpolateMotionPoints(
+        const TrajectorySample& begin,
+        const TrajectorySample& end,
+        TrajectorySample& interpolated,
+        int64_t time_ns,
+        InterpolationMode mode)
+{
     // Check for incorrect times
-    if(end_time < begin_time)
+    if(end.stamp_ns < begin.stamp_ns)
     {
         return false;
     }
-    
-    if(time > end_time)
+
+    if(time_ns > end.stamp_ns)
     {
         return false;
     }
 
-    if(time < begin_time)
+    if(time_ns < begin.stamp_ns)
     {
         return false;
     }
 
-    // Find the ratio between the desired delta time and the delta time between the two twists
-    double x = (time - begin_time).toSec() / (end_time - begin_time).toSec();
-
-    // Interpolate linearly, do not interpolate orientation components as they are not supported
-    interpolated.motion_point.pose.position.x = interpolate(x, begin.motion_point.pose.position.x, end.motion_point.pose.position.x);
-    interpolated.motion_point.pose.position.y = interpolate(x, begin.motion_point.pose.position.y, end.motion_point.pose.position.y);
-    interpolated.motion_point.pose.position.z = interpolate(x, begin.motion_point.pose.position.z, end.motion_point.pose.position.z);
+    // Find the ratio between the desired delta time and the delta time between the two samples
+    const int64_t span_ns = end.stamp_ns - begin.stamp_ns;
+    const double x = span_ns == 0
+                   ? 0.0
+                   : static_cast<double>(time_ns - begin.stamp_ns) / span_ns;
 
-    interpolated.motion_point.twist.linear.x = interpolate(x, begin.motion_point.twist.linear.x, end.motion_point.twist.linear.x);
-    interpolated.motion_point.twist.linear.y = interpolate(x, begin.motion_point.twist.linear.y, end.motion_point.twist.linear.y);
-    interpolated.motion_point.twist.linear.z = interpolate(x, begin.motion_point.twist.linear.z, end.motion_point.twist.linear.z);
+    // Interpolate every field linearly at once, orientation is not
+    // supported so it is not part of the sample. Yaw rate is interpolated
+    // since yaw is not supported by any other way in the controller.
+    interpolated.vector() = begin.vector() + x * (end.vector() - begin.vector());
 
-    // z interpolation is left in for now since
-    // yaw is not supported by any other way in the controller
-    interpolated.motion_point.twist.angular.z = interpolate(x, begin.motion_point.twist.angular.z, end.motion_point.twist.angular.z);
-
-    interpolated.motion_point.accel.linear.x = interpolate(x, begin.motion_point.accel.linear.x, end.motion_point.accel.linear.x);
-    interpolated.motion_point.accel.linear.y = interpolate(x, begin.motion_point.accel.linear.y, end.motion_point.accel.linear.y);
-    interpolated.motion_point.accel.linear.z = interpolate(x, begin.motion_point.accel.linear.z, end.motion_point.accel.linear.z);
+    // Replace the linear position, velocity and acceleration with the
+    // polynomial fit, yaw rate stays linear in every mode
+    if(mode != InterpolationMode::LINEAR && span_ns != 0)
+    {
+        interpolateHermite(begin,
+                           end,
+                           span_ns * 1e-9,
+                           (time_ns - begin.stamp_ns) * 1e-9,
+                           mode == InterpolationMode::QUINTIC,
+                           interpolated);
+    }
 
     // Set the current header stamp
-    interpolated.header.stamp = time;
+    interpolated.stamp_ns = time_ns;
 
     return true;
 }
 
-// Interpolate between arbitrary values and waypoints
-// x is to be between 0-1 if the interpolation is to
-// range from start to end.
-double MotionPointInterpolator::interpolate(double x,
-                                            double start,
-                                            double end)
+// Mode named by the motion_point_interpolation param
+InterpolationMode MotionPointInterpolator::interpolationModeFromName(
+        const std::string& name)
+{
+    if(name == "cubic")
+    {
+        return InterpolationMode::CUBIC;
+    }
+    else if(name == "quintic")
+    {
+        return InterpolationMode::QUINTIC;
+    }
+    else if(name != "linear")
+    {
+        ROS_ERROR("Unknown motion_point_interpolation %s, using linear", name.c_str());
+    }
+    return InterpolationMode::LINEAR;
+}
+
+// Number of targets that can be queued, the number of targets in duration
+// seconds spaced timestep apart plus the target before the current time
+size_t MotionPointInterpolator::queueCapacity(double duration, double timestep)
 {
-    return (end-start)*x +start;
+    ROS_ASSERT_MSG(duration > 0.0 && timestep > 0.0,
+                   "Motion point queue duration and timestep must be positive");
+    // Tolerance keeps durations that are a multiple of the timestep from
+    // rounding up an extra point
+    return static_cast<size_t>(std::ceil(duration / timestep - 1e-6)) + 2;
 }
 
 // Trim the velocity queue so that there aren't old velocities in the queue
 bool MotionPointInterpolator::trimMotionPointQueue(
-    MotionPointStampedArray& motion_points,
+    MotionPointQueue& motion_points,
     const ros::Time& time)
 {
     // Check for empty array of twists
@@ -144,20 +520,12 @@ bool MotionPointInterpolator::trimMotionPointQueue(
     // the current time and then also keep all going into the future.
 
     // Find the first time more than or equal
-    // Uses a lambda (and an auto specifier) to compare
-    //the current time and a header's time stamp
-    MotionPointStampedArray::iterator it = std::lower_bound(
-                    motion_points.begin(),
-                    motion_points.end(),
-                    time,
-                    [](auto& motion_point, auto& time) {
-                        return motion_point.header.stamp < time;
-                    });
+    size_t index = motion_points.lowerBound(time);
  
     // If the first time more than or equal is the first item in the array
     // then there is not a twist prior to the current time.
     // so a valid interpolated velocity cannot be calculated.
-    if(it == motion_points.begin())
+    if(index == 0)
     {
         // ALl the times are greater than the current time
         ROS_ERROR("trimMotionPointQueue there are no valid motion points available");
@@ -166,8 +534,8 @@ bool MotionPointInterpolator::trimMotionPointQueue(
     // There must be an item in the list prior to the iterator
     else
     {
-        // Delete everything from the beginning up to (but not including) the node prior to the iterator
-        (void)motion_points.erase(motion_points.begin(), std::prev(it, 1));
+        // Delete everything from the beginning up to (but not including) the node prior to the index
+        motion_points.pop_front(index - 1);
         return true;
     }
 }
@@ -175,10 +543,12 @@ bool MotionPointInterpolator::trimMotionPointQueue(
 // Append velocity targets to the velocity queue. If the velocity targets are older than the newest velocity target queued
 // the queued velocity targets are discarded
 bool MotionPointInterpolator::appendMotionPointQueue(
-    MotionPointStampedArray& current_motion_points,
-    const MotionPointStampedArray& new_motion_points,
+    MotionPointQueue& current_motion_points,
+    const MotionPointQueue::PlanConstPtr& new_plan,
     const ros::Time& time)
 {
+    const MotionPointStampedArray& new_motion_points = new_plan->motion_points;
+
     // Check for an empty array of new twists
     if(new_motion_points.empty())
     {
@@ -207,37 +577,220 @@ bool MotionPointInterpolator::appendMotionPointQueue(
     if(!current_motion_points.empty())
     {
         // This is the time after which all motion points in the queue will be discarded
-        ros::Time target_time = static_cast<ros::Time>(first_valid_motion_point->header.stamp);
+        ros::Time target_time = first_valid_motion_point->header.stamp;
 
-        // Get an iterator to the first queue velocity with a timestamp more than or equal to the
+        // Get the index of the first queue velocity with a timestamp more than or equal to the
         // first time we're appending from the new twists
-        MotionPointStampedArray::iterator it = std::lower_bound(
-            current_motion_points.begin(),
-            current_motion_points.end(),
-            target_time,
-            [](auto& motion_point, auto& time) { return motion_point.header.stamp < time; });
-
-        // Check if its the last element before attempting to remove
-        if(it != current_motion_points.end())
+        size_t index = current_motion_points.lowerBound(target_time);
+
+        // Erase from the index to the end, does nothing if the index is past the last element
+        current_motion_points.truncate(index);
+    }
+
+    // Queue all future targets that fit by reference to the plan.
+    // All targets that were after these targets should be deleted now.
+    const size_t begin = first_valid_motion_point - new_motion_points.begin();
+    const size_t end = std::min(new_motion_points.size(),
+                                begin + current_motion_points.capacity()
+                                      - current_motion_points.size());
+    const bool pushed = current_motion_points.push_back(new_plan, begin, end);
+    ROS_ASSERT(pushed);
+
+    if(end < new_motion_points.size())
+    {
+        ROS_ERROR("appendMotionPointQueue queue is full, dropping the last %lu "
+                  "motion points, increase motion_point_queue_duration",
+                  static_cast<unsigned long>(new_motion_points.size() - end));
+        return false;
+    }
+
+    return true;
+}
+
+// Makes trajectory the polynomial targets, discarding queued motion
+// points from its start on. The oldest motion point is always kept so
+// the queue is never empty.
+void MotionPointInterpolator::appendPolynomialTrajectory(
+    MotionPointQueue& motion_points,
+    PolynomialTargets& polynomial_targets,
+    const std::shared_ptr<const PolynomialTrajectory>& trajectory)
+{
+    ros::Time start;
+    start.fromNSec(trajectory->startNs());
+    motion_points.truncate(std::max<size_t>(motion_points.lowerBound(start), 1));
+
+    polynomial_targets.trajectory = trajectory;
+    polynomial_targets.end_ns = std::numeric_limits<int64_t>::max();
+}
+
+// Makes the velocity profile for goal the polynomial targets. The
+// profile starts from the targets at the goal's stamp, or at the oldest
+// queued motion point if that is later.
+bool MotionPointInterpolator::applyVelocityGoal(
+    MotionPointQueue& motion_points,
+    PolynomialTargets& polynomial_targets,
+    const PlanSplice& plan_splice,
+    const VelocityProfileGenerator& velocity_profile_generator,
+    InterpolationMode mode,
+    const iarc7_motion::VelocityGoal& goal)
+{
+    // Targets before the oldest queued motion point have been trimmed
+    // already, the profile can't start before it
+    const ros::Time start_time = std::max(goal.header.stamp,
+                                          motion_points.front().header.stamp);
+
+    // Only peek, the goal may be stamped ahead of the control loop, which
+    // still needs the targets up to it
+    TrajectorySample start;
+    TargetCursor cursor;
+    if(!peekTargets(motion_points, polynomial_targets, plan_splice, start_time, mode, cursor, start))
+    {
+        ROS_ERROR("applyVelocityGoal has no targets to start the profile from");
+        return false;
+    }
+    start.stamp_ns = start_time.toNSec();
+
+    // Apply the start overrides
+    const geometry_msgs::Vector3* overrides[2] = {&goal.start_position,
+                                                  &goal.start_velocity};
+    const int first_index[2] = {TrajectorySample::kPositionX,
+                                TrajectorySample::kVelocityX};
+    for(int i = 0; i < 2; i++)
+    {
+        const double values[3] = {overrides[i]->x, overrides[i]->y, overrides[i]->z};
+        for(int axis = 0; axis < 3; axis++)
         {
-            // Erase from the index to the end since the iterator must be somewhere in the the list
-            (void)current_motion_points.erase(it, current_motion_points.end());
+            if(!std::isnan(values[axis]))
+            {
+                start.values[first_index[i] + axis] = values[axis];
+            }
         }
     }
 
-    // Copy all future targets into our buffer.
-    // All targets that were after these targets should be deleted now.
-    std::for_each(first_valid_motion_point,
-                  new_motion_points.end(),
-                  [&](auto i){ current_motion_points.emplace_back(i); } );
+    std::shared_ptr<PolynomialTrajectory> trajectory
+        = std::make_shared<PolynomialTrajectory>();
+    if(!velocity_profile_generator.generate(
+            start,
+            Eigen::Vector3d(goal.target_velocity.x,
+                            goal.target_velocity.y,
+                            goal.target_velocity.z),
+            goal.acceleration,
+            goal.jerk,
+            *trajectory))
+    {
+        ROS_ERROR("applyVelocityGoal could not generate a profile, dropping goal");
+        return false;
+    }
 
+    appendPolynomialTrajectory(motion_points, polynomial_targets, trajectory);
     return true;
 }
 
-// Receive a new list of velocities commands and call appendVelocityQueue to insert them into the queue
+// Appends every plan waiting in pending_plans in the order they were
+// received. A dense plan ends the polynomial targets where it starts.
+// Velocity goals are interpolated from the targets with mode. The
+// jump each plan makes in the targets at time is blended out and
+// recorded in plan_splice.
+// Returns false if any of them could not be appended.
+bool MotionPointInterpolator::applyPendingPlans(
+    PlanHandoff& pending_plans,
+    const ros::Time& time,
+    MotionPointQueue& motion_points,
+    PolynomialTargets& polynomial_targets,
+    PlanSplice& plan_splice,
+    const VelocityProfileGenerator& velocity_profile_generator,
+    InterpolationMode mode)
+{
+    // Only splices in targets the controller is following are blended and
+    // measured
+    const bool following = plan_splice.last_target_ns
+                        >= static_cast<int64_t>(time.toNSec()) - kFollowingTimeoutNs;
+
+    bool success = true;
+    PendingPlan pending_plan;
+    while(pending_plans.pop(pending_plan))
+    {
+        TrajectorySample before;
+        TargetCursor cursor;
+        const bool have_before = following
+            && peekTargets(motion_points, polynomial_targets, plan_splice, time, mode, cursor, before);
+
+        if(pending_plan.polynomial_plan)
+        {
+            appendPolynomialTrajectory(motion_points,
+                                       polynomial_targets,
+                                       pending_plan.polynomial_plan);
+        }
+        else if(pending_plan.velocity_goal)
+        {
+            if(!applyVelocityGoal(motion_points,
+                                  polynomial_targets,
+                                  plan_splice,
+                                  velocity_profile_generator,
+                                  mode,
+                                  *pending_plan.velocity_goal))
+            {
+                success = false;
+                continue;
+            }
+        }
+        else
+        {
+            if(!appendMotionPointQueue(motion_points,
+                                       pending_plan.plan,
+                                       pending_plan.time))
+            {
+                success = false;
+                continue;
+            }
+
+            if(polynomial_targets.trajectory)
+            {
+                const int64_t plan_start_ns
+                    = pending_plan.plan->motion_points.front().header.stamp.toNSec();
+                if(plan_start_ns <= polynomial_targets.trajectory->startNs())
+                {
+                    polynomial_targets.trajectory.reset();
+                }
+                else
+                {
+                    polynomial_targets.end_ns = std::min(polynomial_targets.end_ns,
+                                                         plan_start_ns);
+                }
+            }
+        }
+
+        if(have_before)
+        {
+            spliceTargets(motion_points, polynomial_targets, before, time, mode, plan_splice);
+        }
+    }
+    return success;
+}
+
+// Receive a new list of velocities commands and hand it to the control thread.
+// Runs on the plan callback thread.
 void MotionPointInterpolator::processMotionPointArray(
     const iarc7_msgs::MotionPointStampedArray::ConstPtr& message)
 {
+    // The plan is appended relative to the time it was received
+    handOffMotionPointArray(pending_plans_, message, ros::Time::now());
+}
+
+// Checks message is a valid plan and hands it to the control thread,
+// received at time
+bool MotionPointInterpolator::handOffMotionPointArray(
+    PlanHandoff& pending_plans,
+    const iarc7_msgs::MotionPointStampedArray::ConstPtr& message,
+    const ros::Time& time)
+{
+    // Check for empty message
+    if(message->motion_points.empty())
+    {
+        ROS_WARN("processMotionPointArray passed an empty array" 
+                  "of MotionPointStampedArray, not accepting");
+        return false;
+    }
 
     for(MotionPointStampedArray::const_iterator checkMessageOrder = message->motion_points.begin();
         checkMessageOrder != message->motion_points.end() - 1; 
@@ -249,20 +802,60 @@ void MotionPointInterpolator::processMotionPointArray(
             ROS_ERROR("Messages out of order at time %lf and time %lf, rejecting entire message", 
             checkMessageOrder->header.stamp.toSec(), (checkMessageOrder+1)->header.stamp.toSec());
             
-            return;
+            return false;
         }
     }
 
-    // Check for empty message
-    if(message->motion_points.empty())
+    PendingPlan pending_plan;
+    pending_plan.plan = message;
+    pending_plan.time = time;
+
+    if(!pending_plans.push(pending_plan))
     {
-        ROS_WARN("processMotionPointArray passed an empty array" 
-                  "of MotionPointStampedArray, not accepting");
+        ROS_ERROR("processMotionPointArray control thread is not taking plans, "
+                  "dropping plan received at %lf", pending_plan.time.toSec());
+        return false;
+    }
+
+    return true;
+}
+
+// Receive a polynomial trajectory, convert it and hand it to the control
+// thread. Runs on the plan callback thread.
+void MotionPointInterpolator::processPolynomialTrajectory(
+    const iarc7_motion::PolynomialTrajectory::ConstPtr& message)
+{
+    std::shared_ptr<PolynomialTrajectory> trajectory
+        = std::make_shared<PolynomialTrajectory>();
+    if(!trajectory->fromMessage(*message))
+    {
+        ROS_ERROR("processPolynomialTrajectory rejecting invalid trajectory");
         return;
     }
 
-    // Cache time to make sure it stays the same for the proceeding function calls
-    ros::Time current_time = ros::Time::now();
+    PendingPlan pending_plan;
+    pending_plan.polynomial_plan = trajectory;
+    pending_plan.time = ros::Time::now();
+
+    if(!pending_plans_.push(pending_plan))
+    {
+        ROS_ERROR("processPolynomialTrajectory control thread is not taking plans, "
+                  "dropping trajectory received at %lf", pending_plan.time.toSec());
+    }
+}
+
+// Receive a velocity goal and hand it to the control thread, which
+// generates its profile. Runs on the plan callback thread.
+void MotionPointInterpolator::processVelocityGoal(
+    const iarc7_motion::VelocityGoal::ConstPtr& message)
+{
+    PendingPlan pending_plan;
+    pending_plan.velocity_goal = message;
+    pending_plan.time = ros::Time::now();
 
-    appendMotionPointQueue(motion_point_targets_, message->motion_points, current_time);
+    if(!pending_plans_.push(pending_plan))
+    {
+        ROS_ERROR("processVelocityGoal control thread is not taking plans, "
+                  "dropping goal received at %lf", pending_plan.time.toSec());
+    }
 }
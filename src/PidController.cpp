@@ -87,8 +87,9 @@ bool PidController::update(double current_value,
         double d_term = d_gain_ * derivative;
         response -= d_term;
 
-        //Publish PID values to topic
-        if (log_debug) {
+        //Publish PID values to topic, building the message allocates so
+        //skip it when nobody is listening
+        if (log_debug && pid_value_publisher_.getNumSubscribers() > 0) {
             iarc7_msgs::Float64ArrayStamped debug_msg;
             debug_msg.header.stamp = time;
             debug_msg.data = {p_term, i_accumulator_,-d_term};
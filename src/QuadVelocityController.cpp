@@ -9,23 +9,20 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
 #include <boost/algorithm/clamp.hpp>
 
 // Associated header
 #include "iarc7_motion/QuadVelocityController.hpp"
 
 // ROS Headers
-#include "ros_utils/LinearMsgInterpolator.hpp"
 #include "ros_utils/ParamUtils.hpp"
-#include "ros_utils/SafeTransformWrapper.hpp"
 #include "tf2/LinearMath/Matrix3x3.h"
 #include "tf2/LinearMath/Quaternion.h"
 #include "tf2/LinearMath/Vector3.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
 
 // ROS message headers
-#include "geometry_msgs/AccelWithCovarianceStamped.h"
-#include "iarc7_msgs/Float64Stamped.h"
 #include "iarc7_msgs/MotionPointStamped.h"
 
 using namespace Iarc7Motion;
@@ -36,10 +33,8 @@ QuadVelocityController::QuadVelocityController(
         double vy_pid_settings[6],
         double (&position_p)[3],
         double yaw_p,
-        const ThrustModel& thrust_model,
+        const VerticalThrustModel& thrust_model,
         const ThrustModel& thrust_model_side,
-        const ros::Duration& battery_timeout,
-        ros::NodeHandle& nh,
         ros::NodeHandle& private_nh)
     : vz_pid_(vz_pid_settings,
               "vz_pid",
@@ -51,57 +46,20 @@ QuadVelocityController::QuadVelocityController(
               "vy_pid",
               private_nh),
       thrust_model_(thrust_model),
-      thrust_model_front_(thrust_model_side),
-      thrust_model_back_(thrust_model_side),
-      thrust_model_left_(thrust_model_side),
-      thrust_model_right_(thrust_model_side),
-      transform_wrapper_(),
+      thrust_model_side_(thrust_model_side),
+      side_start_thrusts_(),
+      thrust_model_adaptation_enabled_(ros_utils::ParamUtils::getParam<bool>(
+              private_nh,
+              "thrust_model_adaptation_enabled")),
+      thrust_model_estimator_(ThrustModelEstimatorSettings::load(
+              private_nh,
+              "thrust_model_adaptation")),
       setpoint_(),
       xy_mixer_(ros_utils::ParamUtils::getParam<std::string>(
               private_nh,
               "xy_mixer")),
       position_p_(position_p),
       yaw_p_(yaw_p),
-      startup_timeout_(ros_utils::ParamUtils::getParam<double>(
-              private_nh,
-              "startup_timeout")),
-      update_timeout_(ros_utils::ParamUtils::getParam<double>(
-              private_nh,
-              "update_timeout")),
-      accel_interpolator_(
-              nh,
-              "accel/filtered",
-              update_timeout_,
-              ros::Duration(0),
-              [](const geometry_msgs::AccelWithCovarianceStamped& msg) {
-                  return tf2::Vector3(msg.accel.accel.linear.x,
-                                      msg.accel.accel.linear.y,
-                                      msg.accel.accel.linear.z);
-              },
-              100),
-      battery_interpolator_(nh,
-                            "motor_battery",
-                            update_timeout_,
-                            battery_timeout,
-                            [](const iarc7_msgs::Float64Stamped& msg) {
-                                return msg.data;
-                            },
-                            100),
-      odom_interpolator_(nh,
-                         "odometry/filtered",
-                         update_timeout_,
-                         ros::Duration(0),
-                         [](const nav_msgs::Odometry& msg) {
-                              Eigen::VectorXd v(6);
-                              v[0] = msg.twist.twist.linear.x;
-                              v[1] = msg.twist.twist.linear.y;
-                              v[2] = msg.twist.twist.linear.z;
-                              v[3] = msg.pose.pose.position.x;
-                              v[4] = msg.pose.pose.position.y;
-                              v[5] = msg.pose.pose.position.z;
-                              return v;
-                         },
-                         100),
       min_thrust_(ros_utils::ParamUtils::getParam<double>(
               private_nh,
               "min_thrust")),
@@ -135,87 +93,80 @@ void QuadVelocityController::setTargetVelocity(iarc7_msgs::MotionPointStamped mo
 }
 
 // Use a new thrust model
-void QuadVelocityController::setThrustModel(const ThrustModel& thrust_model)
+void QuadVelocityController::setThrustModel(const VerticalThrustModel& thrust_model)
 {
-    thrust_model_ = thrust_model;
+    std::atomic_store(&pending_thrust_model_,
+                      std::make_shared<const VerticalThrustModel>(thrust_model));
+}
+
+VerticalThrustModel QuadVelocityController::getThrustModel() const
+{
+    // A model set since the last update replaces thrust_model_ on the next
+    // one, so it is the model in use as far as callers are concerned
+    std::shared_ptr<const VerticalThrustModel> pending_thrust_model
+        = std::atomic_load(&pending_thrust_model_);
+    if (pending_thrust_model) {
+        return withLearnedCorrection(*pending_thrust_model);
+    }
+    return thrust_model_;
+}
+
+VerticalThrustModel QuadVelocityController::withLearnedCorrection(
+        const VerticalThrustModel& thrust_model) const
+{
+    VerticalThrustModel corrected_model = thrust_model;
+    if (thrust_model_adaptation_enabled_) {
+        corrected_model.setVoltageCorrection(
+                thrust_model_estimator_.getScale(),
+                thrust_model_estimator_.getOffset());
+    }
+    return corrected_model;
 }
 
 // Main update, runs all PID calculations and returns a desired uav_command
 // Needs to be called at regular intervals in order to keep catching the latest velocities.
-bool QuadVelocityController::update(const ros::Time& time,
+bool QuadVelocityController::update(const StateSnapshot& state,
                                     iarc7_msgs::OrientationThrottleStamped& uav_command,
                                     bool xy_passthrough_mode,
                                     double a_x,
                                     double a_y)
 {
+    ScopedLatencyTimer update_timer(latencies_.update);
+
+    const ros::Time& time = state.stamp;
     if (time < last_update_time_) {
         ROS_ERROR("Tried to update QuadVelocityController with time before last update");
         return false;
     }
 
-    // Get the current odometry of the quad.
-    Eigen::VectorXd odometry;
-    bool success = odom_interpolator_.getInterpolatedMsgAtTime(odometry, time);
-    if (!success) {
-        ROS_ERROR("Failed to get current velocities in QuadVelocityController::update");
-        return false;
-    }
-
-    // Get the current battery voltage of the quad
-    double voltage;
-    success = battery_interpolator_.getInterpolatedMsgAtTime(voltage, time);
-    if (!success) {
-        ROS_ERROR("Failed to get current battery voltage in QuadVelocityController::update");
-        return false;
+    // Pick up a model installed by setThrustModel
+    std::shared_ptr<const VerticalThrustModel> pending_thrust_model
+        = std::atomic_exchange(&pending_thrust_model_,
+                               std::shared_ptr<const VerticalThrustModel>());
+    if (pending_thrust_model) {
+        thrust_model_ = withLearnedCorrection(*pending_thrust_model);
     }
 
-    // Get the current acceleration of the quad
-    tf2::Vector3 accel;
-    success = accel_interpolator_.getInterpolatedMsgAtTime(accel, time);
-    if (!success) {
-        ROS_ERROR("Failed to get current acceleration in QuadVelocityController::update");
-        return false;
-    }
-
-    // Get the current transform (rotation) of the quad
-    geometry_msgs::TransformStamped transform;
-    success = transform_wrapper_.getTransformAtTime(transform,
-                                                    "level_quad",
-                                                    "quad",
-                                                    time,
-                                                    update_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to get current transform in QuadVelocityController::update");
-        return false;
-    }
-
-    // Get the current transform (rotation) of the quad
-    geometry_msgs::TransformStamped col_height_transform;
-    success = transform_wrapper_.getTransformAtTime(col_height_transform,
-                                                    "map",
-                                                    "center_of_lift",
-                                                    time,
-                                                    update_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to get current transform in QuadVelocityController::update");
-        return false;
-    }
-    double col_height = col_height_transform.transform.translation.z;
+    const OdometryVector& odometry = state.odometry;
+    const tf2::Vector3& accel = state.accel;
+    const double voltage = state.battery_voltage;
+    const double col_height = state.map_to_center_of_lift.translation.z;
 
     // Get current yaw from the transform
-    double current_yaw = yawFromQuaternion(transform.transform.rotation);
+    double current_yaw = yawFromQuaternion(state.level_quad_to_quad.rotation);
 
     // Update setpoints on PID controllers
+    ScopedLatencyTimer pid_timer(latencies_.pid);
     updatePidSetpoints(current_yaw, odometry);
 
     // Update Vz PID loop with position and velocity
     double x_accel_output = 0;
     double y_accel_output = 0;
     double z_accel_output = 0;
-    success = vz_pid_.update(odometry[2],
-                             time,
-                             z_accel_output,
-                             accel.z() - setpoint_.motion_point.accel.linear.z, true);
+    bool success = vz_pid_.update(odometry[2],
+                                  time,
+                                  z_accel_output,
+                                  accel.z() - setpoint_.motion_point.accel.linear.z, true);
 
     if (!success) {
         ROS_ERROR("Vz PID update failed in QuadVelocityController::update");
@@ -279,6 +230,8 @@ bool QuadVelocityController::update(const ros::Time& time,
         }
     }
 
+    pid_timer.stop();
+
     // Fill in the uav_command's information
     uav_command.header.stamp = time;
 
@@ -286,6 +239,7 @@ bool QuadVelocityController::update(const ros::Time& time,
     double y_accel = y_accel_output + local_y_setpoint_accel;
     double z_accel = g_ + z_accel_output + setpoint_accel.z;
 
+    ScopedLatencyTimer thrust_model_timer(latencies_.thrust_model);
     double thrust_request;
     if(xy_mixer_ == "4dof") {
         double pitch_request, roll_request;
@@ -314,26 +268,24 @@ bool QuadVelocityController::update(const ros::Time& time,
         uav_command.data.pitch = 0;
         uav_command.data.roll = 0;
 
-        uav_command.planar.front_throttle = thrust_model_front_.voltageFromThrust(
+        const double side_accels[4] = {
             std::min(std::max(-x_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_),
-            1,
-            0.0)
-            / voltage;
-        uav_command.planar.back_throttle = thrust_model_back_.voltageFromThrust(
-          std::min(std::max(x_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_),
-            1,
-            0.0)
-            / voltage;
-        uav_command.planar.left_throttle = thrust_model_left_.voltageFromThrust(
+            std::min(std::max(x_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_),
             std::min(std::max(-y_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_),
-            1,
-            0.0)
-            / voltage;
-        uav_command.planar.right_throttle = thrust_model_right_.voltageFromThrust(
-            std::min(std::max(y_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_),
-            1,
-            0.0)
-            / voltage;
+            std::min(std::max(y_accel + min_side_thrust_, min_side_thrust_), max_side_thrust_)
+        };
+        double side_voltages[4];
+        thrust_model_side_.voltagesFromThrusts(side_accels,
+                                               1,
+                                               col_height,
+                                               side_start_thrusts_,
+                                               side_voltages,
+                                               4);
+
+        uav_command.planar.front_throttle = side_voltages[0] / voltage;
+        uav_command.planar.back_throttle = side_voltages[1] / voltage;
+        uav_command.planar.left_throttle = side_voltages[2] / voltage;
+        uav_command.planar.right_throttle = side_voltages[3] / voltage;
         //ROS_ERROR_STREAM(uav_command);
     }
     else {
@@ -342,11 +294,21 @@ bool QuadVelocityController::update(const ros::Time& time,
     }
 
     ROS_DEBUG("Thrust: %f, Voltage: %f, height: %f", thrust_request, voltage, col_height);
-    uav_command.throttle = thrust_model_.voltageFromThrust(
+    double commanded_voltage = thrust_model_.voltageFromThrust(
             std::min(std::max(thrust_request, min_thrust_), max_thrust_),
             4,
-            col_height)
-            / voltage;
+            col_height);
+    uav_command.throttle = commanded_voltage / voltage;
+
+    if (thrust_model_adaptation_enabled_) {
+        updateThrustModelEstimate(time,
+                                  accel,
+                                  col_height,
+                                  commanded_voltage,
+                                  thrust_request < min_thrust_
+                                   || thrust_request > max_thrust_);
+    }
+    thrust_model_timer.stop();
 
     // Hack heading to straight ahead
     uav_command.data.yaw = -yaw_p_ * (0.0 - current_yaw);
@@ -376,58 +338,62 @@ bool QuadVelocityController::update(const ros::Time& time,
     return true;
 }
 
-bool QuadVelocityController::waitUntilReady()
+void QuadVelocityController::addLatencyStages(LatencyMonitor& monitor) const
 {
-    bool success = accel_interpolator_.waitUntilReady(startup_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to fetch initial acceleration");
-        return false;
-    }
-
-    success = battery_interpolator_.waitUntilReady(startup_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to fetch battery voltage");
-        return false;
-    }
-
-    success = odom_interpolator_.waitUntilReady(startup_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to fetch initial velocity");
-        return false;
-    }
+    monitor.addStage("controller", latencies_.update);
+    monitor.addStage("controller pid", latencies_.pid);
+    monitor.addStage("controller thrust model", latencies_.thrust_model);
+}
 
-    geometry_msgs::TransformStamped transform;
-    success = transform_wrapper_.getTransformAtTime(transform,
-                                                    "level_quad",
-                                                    "quad",
-                                                    ros::Time(0),
-                                                    startup_timeout_);
-    if (!success)
-    {
-        ROS_ERROR("Failed to fetch initial transform level_quad to quad");
-        return false;
+void QuadVelocityController::updateThrustModelEstimate(
+        const ros::Time& time,
+        const tf2::Vector3& accel,
+        double col_height,
+        double commanded_voltage,
+        bool thrust_saturated)
+{
+    // Close to the ground, ground effect adds thrust that the model
+    // doesn't account for, and a saturated command isn't what the
+    // model asked for
+    if (level_flight_active_ || thrust_saturated) {
+        thrust_model_estimator_.restartFilters();
+        return;
     }
 
-    success = transform_wrapper_.getTransformAtTime(transform,
-                                                    "map",
-                                                    "center_of_lift",
-                                                    ros::Time(0),
-                                                    startup_timeout_);
-    if (!success)
-    {
-        ROS_ERROR("Failed to fetch initial transform map to center_of_lift");
-        return false;
+    // The 4dof mixer tilts the whole thrust vector, the 6dof mixer's
+    // vertical motors only produce the vertical component
+    const tf2::Vector3 thrust_accel = accel + tf2::Vector3(0.0, 0.0, g_);
+    const double measured_accel = xy_mixer_ == "4dof" ? thrust_accel.length()
+                                                      : thrust_accel.z();
+
+    // The estimator fits the uncorrected model far from the ground, so
+    // take out ground effect and the current correction
+    const double free_air_thrust
+        = thrust_model_.thrustForAcceleration(measured_accel, 4)
+        / thrust_model_.groundEffectRatio(col_height);
+    const double model_voltage
+        = (thrust_model_.get_voltage_for_thrust(free_air_thrust)
+           - thrust_model_.getVoltageOffset())
+        / thrust_model_.getVoltageScale();
+
+    if (thrust_model_estimator_.update((time - last_update_time_).toSec(),
+                                       model_voltage,
+                                       commanded_voltage)) {
+        thrust_model_.setVoltageCorrection(thrust_model_estimator_.getScale(),
+                                           thrust_model_estimator_.getOffset());
     }
+}
 
-    // Mark the last update time as 1ns later than the odometry message,
-    // because we should always have a message older than the last update
-    last_update_time_ = std::max({accel_interpolator_.getLastUpdateTime(),
-                                  battery_interpolator_.getLastUpdateTime(),
-                                  odom_interpolator_.getLastUpdateTime()});
+bool QuadVelocityController::waitUntilReady(
+        const StateInterpolator& state_interpolator)
+{
+    // Mark the last update time as the newest estimate, because we should
+    // always have a message older than the last update
+    last_update_time_ = state_interpolator.getLastUpdateTime();
     return true;
 }
 
-void QuadVelocityController::updatePidSetpoints(double current_yaw, const Eigen::VectorXd& odometry)
+void QuadVelocityController::updatePidSetpoints(double current_yaw, const OdometryVector& odometry)
 {
     double position_velocity_request[3] = {
         position_p_[0] * (setpoint_.motion_point.pose.position.x - odometry[3]),
@@ -484,6 +450,7 @@ void QuadVelocityController::commandForAccel(
 
 bool QuadVelocityController::prepareForTakeover()
 {
+    thrust_model_estimator_.restartFilters();
     vz_pid_.reset();
     vx_pid_.reset();
     vy_pid_.reset();
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// State Interpolator
+//
+// Subscribes to the state estimates the controllers need and interpolates
+// all of them, along with the transforms, to the time of each control
+// update as a StateSnapshot.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+
+// Associated header
+#include "iarc7_motion/StateInterpolator.hpp"
+
+// ROS Headers
+#include "ros_utils/ParamUtils.hpp"
+
+using namespace Iarc7Motion;
+
+StateInterpolator::StateInterpolator(ros::NodeHandle& nh,
+                                     ros::NodeHandle& private_nh)
+    : transform_wrapper_(),
+      transform_stamped_(),
+      startup_timeout_(ros_utils::ParamUtils::getParam<double>(
+              private_nh,
+              "startup_timeout")),
+      update_timeout_(ros_utils::ParamUtils::getParam<double>(
+              private_nh,
+              "update_timeout")),
+      callback_queue_(),
+      mutex_(),
+      callback_called_(),
+      accel_queue_(callback_queue_, mutex_, callback_called_),
+      battery_queue_(callback_queue_, mutex_, callback_called_),
+      odom_queue_(callback_queue_, mutex_, callback_called_),
+      accel_nh_(callbackNodeHandle(nh, accel_queue_)),
+      battery_nh_(callbackNodeHandle(nh, battery_queue_)),
+      odom_nh_(callbackNodeHandle(nh, odom_queue_)),
+      accel_interpolator_(
+              accel_nh_,
+              "accel/filtered",
+              update_timeout_,
+              ros::Duration(0),
+              [](const geometry_msgs::AccelWithCovarianceStamped& msg) {
+                  return tf2::Vector3(msg.accel.accel.linear.x,
+                                      msg.accel.accel.linear.y,
+                                      msg.accel.accel.linear.z);
+              },
+              100),
+      battery_interpolator_(battery_nh_,
+                            "motor_battery",
+                            update_timeout_,
+                            ros::Duration(ros_utils::ParamUtils::getParam<double>(
+                                    private_nh,
+                                    "battery_timeout")),
+                            [](const iarc7_msgs::Float64Stamped& msg) {
+                                return msg.data;
+                            },
+                            100),
+      odom_interpolator_(odom_nh_,
+                         "odometry/filtered",
+                         update_timeout_,
+                         ros::Duration(0),
+                         [](const nav_msgs::Odometry& msg) {
+                              return odometryFromMessage(msg);
+                         },
+                         100),
+      spinner_(1, &callback_queue_),
+      latencies_()
+{
+    spinner_.start();
+}
+
+bool StateInterpolator::waitUntilReady()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // The interpolators are only read with the lock held, so wait for
+    // each to have a message before asking them
+    callback_called_.wait_for(
+            lock,
+            std::chrono::nanoseconds(startup_timeout_.toNSec()),
+            [this]() {
+                return accel_queue_.callCount() > 0
+                    && battery_queue_.callCount() > 0
+                    && odom_queue_.callCount() > 0;
+            });
+
+    if (accel_queue_.callCount() == 0
+            || !accel_interpolator_.waitUntilReady(startup_timeout_)) {
+        ROS_ERROR("Failed to fetch initial acceleration");
+        return false;
+    }
+
+    if (battery_queue_.callCount() == 0
+            || !battery_interpolator_.waitUntilReady(startup_timeout_)) {
+        ROS_ERROR("Failed to fetch battery voltage");
+        return false;
+    }
+
+    if (odom_queue_.callCount() == 0
+            || !odom_interpolator_.waitUntilReady(startup_timeout_)) {
+        ROS_ERROR("Failed to fetch initial velocity");
+        return false;
+    }
+    lock.unlock();
+
+    const char* transforms[3][2] = {{"level_quad", "quad"},
+                                    {"map", "center_of_lift"},
+                                    {"map", "level_quad"}};
+    for (const auto& frames : transforms) {
+        const bool success = transform_wrapper_.getTransformAtTime(
+                transform_stamped_,
+                frames[0],
+                frames[1],
+                ros::Time(0),
+                startup_timeout_);
+        if (!success) {
+            ROS_ERROR("Failed to fetch initial transform %s to %s",
+                      frames[0],
+                      frames[1]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ros::Time StateInterpolator::getLastUpdateTime() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::max({accel_interpolator_.getLastUpdateTime(),
+                     battery_interpolator_.getLastUpdateTime(),
+                     odom_interpolator_.getLastUpdateTime()});
+}
+
+bool StateInterpolator::getSnapshot(const ros::Time& time,
+                                    StateSnapshot& snapshot)
+{
+    ScopedLatencyTimer snapshot_timer(latencies_.snapshot);
+    snapshot.stamp = time;
+
+    // Wait for odometry and acceleration to reach time without holding
+    // the lock, so the spinner thread can deliver them
+    std::unique_lock<std::mutex> lock(mutex_);
+    const bool received = callback_called_.wait_for(
+            lock,
+            std::chrono::nanoseconds(update_timeout_.toNSec()),
+            [this, &time]() {
+                return odom_interpolator_.getLastUpdateTime() >= time
+                    && accel_interpolator_.getLastUpdateTime() >= time;
+            });
+    if (!received) {
+        ROS_ERROR("Timed out waiting for estimates in StateInterpolator::getSnapshot");
+        return false;
+    }
+
+    bool success;
+    {
+        ScopedLatencyTimer timer(latencies_.odometry);
+        success = odom_interpolator_.getInterpolatedMsgAtTime(snapshot.odometry, time);
+    }
+    if (!success) {
+        ROS_ERROR("Failed to get current velocities in StateInterpolator::getSnapshot");
+        return false;
+    }
+
+    {
+        ScopedLatencyTimer timer(latencies_.battery);
+        success = battery_interpolator_.getInterpolatedMsgAtTime(snapshot.battery_voltage,
+                                                                 time);
+    }
+    if (!success) {
+        ROS_ERROR("Failed to get current battery voltage in StateInterpolator::getSnapshot");
+        return false;
+    }
+
+    {
+        ScopedLatencyTimer timer(latencies_.accel);
+        success = accel_interpolator_.getInterpolatedMsgAtTime(snapshot.accel, time);
+    }
+    if (!success) {
+        ROS_ERROR("Failed to get current acceleration in StateInterpolator::getSnapshot");
+        return false;
+    }
+    lock.unlock();
+
+    ScopedLatencyTimer transforms_timer(latencies_.transforms);
+    return getTransform("level_quad", "quad", time, snapshot.level_quad_to_quad)
+        && getTransform("map", "center_of_lift", time, snapshot.map_to_center_of_lift)
+        && getTransform("map", "level_quad", time, snapshot.map_to_level_quad);
+}
+
+void StateInterpolator::addLatencyStages(LatencyMonitor& monitor) const
+{
+    monitor.addStage("state", latencies_.snapshot);
+    monitor.addStage("state odometry", latencies_.odometry);
+    monitor.addStage("state battery", latencies_.battery);
+    monitor.addStage("state accel", latencies_.accel);
+    monitor.addStage("state transforms", latencies_.transforms);
+}
+
+ros::NodeHandle StateInterpolator::callbackNodeHandle(
+        const ros::NodeHandle& nh,
+        ros::CallbackQueueInterface& queue)
+{
+    ros::NodeHandle callback_nh(nh);
+    callback_nh.setCallbackQueue(&queue);
+    return callback_nh;
+}
+
+bool StateInterpolator::getTransform(const std::string& parent,
+                                     const std::string& child,
+                                     const ros::Time& time,
+                                     geometry_msgs::Transform& transform)
+{
+    if (!transform_wrapper_.getTransformAtTime(transform_stamped_,
+                                               parent,
+                                               child,
+                                               time,
+                                               update_timeout_)) {
+        ROS_ERROR("Failed to get transform %s to %s in StateInterpolator::getSnapshot",
+                  parent.c_str(),
+                  child.c_str());
+        return false;
+    }
+
+    transform = transform_stamped_.transform;
+    return true;
+}
@@ -12,16 +12,13 @@
 // ROS Headers
 #include <ros/ros.h>
 #include "ros_utils/ParamUtils.hpp"
-#include "tf2_geometry_msgs/tf2_geometry_msgs.h"
-
-#include <geometry_msgs/PointStamped.h>
 
 using namespace Iarc7Motion;
 
 TakeoffController::TakeoffController(
         ros::NodeHandle& nh,
         ros::NodeHandle& private_nh,
-        const ThrustModel& thrust_model)
+        const VerticalThrustModel& thrust_model)
     : landing_detected_message_(),
       landing_detected_subscriber_(),
       landing_detected_message_received_(false),
@@ -42,17 +39,6 @@ TakeoffController::TakeoffController(
       update_timeout_(ros_utils::ParamUtils::getParam<double>(
               private_nh,
               "update_timeout")),
-      battery_timeout_(ros_utils::ParamUtils::getParam<double>(
-              private_nh,
-              "battery_timeout")),
-      battery_interpolator_(nh,
-                            "motor_battery",
-                            update_timeout_,
-                            battery_timeout_,
-                            [](const iarc7_msgs::Float64Stamped& msg) {
-                                return msg.data;
-                            },
-                            100),
       uav_arm_client_(nh.serviceClient<iarc7_msgs::Arm>("uav_arm")),
       arm_time_(),
       ramp_start_time_()
@@ -101,9 +87,10 @@ bool TakeoffController::prepareForTakeover(const ros::Time& time)
 }
 
 // Main update
-bool TakeoffController::update(const ros::Time& time,
-                            iarc7_msgs::OrientationThrottleStamped& uav_command)
+bool TakeoffController::update(const StateSnapshot& state,
+                               iarc7_msgs::OrientationThrottleStamped& uav_command)
 {
+    const ros::Time& time = state.stamp;
     if (time < last_update_time_) {
         ROS_ERROR("Tried to update TakeoffHandler with time before last update");
         return false;
@@ -136,29 +123,11 @@ bool TakeoffController::update(const ros::Time& time,
     }
     else if(state_ == TakeoffState::RAMP) {
         if (time <= ramp_start_time_ + takeoff_throttle_ramp_duration_){
-            double voltage;
-            if (!battery_interpolator_.getInterpolatedMsgAtTime(voltage, time)) {
-                ROS_ERROR("Failed to get battery voltage to interpret results of thrust model");
-                return false;
-            }
-
-            geometry_msgs::TransformStamped transform;
-            bool success = transform_wrapper_.getTransformAtTime(transform,
-                                                                 "map",
-                                                                 "center_of_lift",
-                                                                 time,
-                                                                 update_timeout_);
-            if (!success) {
-                ROS_ERROR("Takeoff controller failed to get height transform");
-                return false;
-            }
-
-            geometry_msgs::PointStamped col_point;
-            tf2::doTransform(col_point, col_point, transform);
             double hover_throttle = thrust_model_.voltageFromThrust(
                                                   9.8,
                                                   4,
-                                                  col_point.point.z)/voltage;
+                                                  state.map_to_center_of_lift.translation.z)
+                                  / state.battery_voltage;
 
             // Linearly ramp to hover throttle
             throttle_ = ((time-ramp_start_time_).toSec()
@@ -218,12 +187,6 @@ bool TakeoffController::waitUntilReady()
         return false;
     }
 
-    success = battery_interpolator_.waitUntilReady(startup_timeout_);
-    if (!success) {
-        ROS_ERROR("Failed to fetch battery voltage");
-        return false;
-    }
-
     const ros::Time start_time = ros::Time::now();
     while (ros::ok()
            && !landing_detected_message_received_
@@ -238,9 +201,8 @@ bool TakeoffController::waitUntilReady()
     }
 
     // This time is just used to calculate any ramping that needs to be done.
-    last_update_time_ = std::max({transform.header.stamp,
-                                  landing_detected_message_.header.stamp,
-                                  battery_interpolator_.getLastUpdateTime()});
+    last_update_time_ = std::max(transform.header.stamp,
+                                 landing_detected_message_.header.stamp);
     return true;
 }
 
@@ -249,11 +211,16 @@ bool TakeoffController::isDone()
   return (state_ == TakeoffState::DONE);
 }
 
-const ThrustModel& TakeoffController::getThrustModel() const
+const VerticalThrustModel& TakeoffController::getThrustModel() const
 {
   return thrust_model_;
 }
 
+void TakeoffController::setThrustModel(const VerticalThrustModel& thrust_model)
+{
+  thrust_model_ = thrust_model;
+}
+
 void TakeoffController::processLandingDetectedMessage(
     const iarc7_msgs::BoolStamped::ConstPtr& message)
 {
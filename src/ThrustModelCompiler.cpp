@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Compiler
+//
+// Offline tool that converts a thrust model yaml file (as found in
+// param/thrust_models) into the binary thrust model file format loaded by
+// ThrustModel, after checking that the model is well formed.
+//
+// Usage: thrust_model_compiler [--strict] <model.yaml> <model.tmb>
+//
+// --strict turns non monotonic end thrust rows into errors
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "iarc7_motion/Polynomial.hpp"
+#include "iarc7_motion/ThrustModelFile.hpp"
+#include "iarc7_motion/ThrustModelYaml.hpp"
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// Checks the assumptions ThrustModel makes about the mapping. Returns the
+// number of errors found.
+int validateModel(const ThrustModelYaml::Model& model, bool strict)
+{
+    int errors = 0;
+    const int rows = model.num_thrust_points;
+    const int cols = model.num_voltage_points;
+
+    if (model.thrust_to_voltage.empty()) {
+        std::cerr << "thrust_to_voltage has no coefficients" << std::endl;
+        errors++;
+    } else if (model.thrust_to_voltage.size() > Polynomial::kMaxCoefficients) {
+        std::cerr << "thrust_to_voltage has " << model.thrust_to_voltage.size()
+                  << " coefficients, at most " << Polynomial::kMaxCoefficients
+                  << " are supported" << std::endl;
+        errors++;
+    }
+
+    if (rows < 2 || cols < 2) {
+        std::cerr << "Mapping must be at least 2x2, got "
+                  << rows << "x" << cols << std::endl;
+        return errors + 1;
+    }
+
+    // Start thrusts are indexed by start_thrust / increment, so they must
+    // be strictly increasing and evenly spaced from zero
+    const double increment = (model.thrust_max - model.thrust_min) / (rows - 1);
+    for (int i = 0; i < rows; i++) {
+        if (i > 0 && model.start_thrusts[i] <= model.start_thrusts[i-1]) {
+            std::cerr << "Start thrusts not increasing at row " << i << std::endl;
+            errors++;
+        }
+        if (std::abs(model.start_thrusts[i] - i * increment)
+                > 1e-6 * std::abs(model.thrust_max)) {
+            std::cerr << "Start thrust " << model.start_thrusts[i]
+                      << " at row " << i << " is not on the grid "
+                      << "implied by thrust_min and thrust_max" << std::endl;
+            errors++;
+        }
+    }
+
+    // Voltages must be strictly increasing, inside the voltage limits,
+    // and shared by every row since the scan only reads the bottom row's
+    for (int i = 0; i < rows; i++) {
+        const double* voltages = &model.voltages[i * cols];
+        for (int j = 0; j < cols; j++) {
+            if (j > 0 && voltages[j] <= voltages[j-1]) {
+                std::cerr << "Voltages not increasing at row " << i
+                          << " column " << j << std::endl;
+                errors++;
+            }
+            if (voltages[j] < model.voltage_min || voltages[j] > model.voltage_max) {
+                std::cerr << "Voltage " << voltages[j] << " at row " << i
+                          << " column " << j << " is outside of voltage limits"
+                          << std::endl;
+                errors++;
+            }
+            if (voltages[j] != model.voltages[j]) {
+                std::cerr << "Voltages at row " << i << " column " << j
+                          << " differ from row 0" << std::endl;
+                errors++;
+            }
+        }
+    }
+
+    // The scan takes the first voltage reaching the desired thrust, which is
+    // only the unique answer when end thrusts increase with voltage
+    int non_monotonic_rows = 0;
+    for (int i = 0; i < rows; i++) {
+        const double* end_thrusts = &model.end_thrusts[i * cols];
+        for (int j = 1; j < cols; j++) {
+            if (end_thrusts[j] < end_thrusts[j-1]) {
+                std::cerr << (strict ? "Error: " : "Warning: ")
+                          << "end thrusts decrease at row " << i
+                          << " column " << j << std::endl;
+                non_monotonic_rows++;
+                break;
+            }
+        }
+    }
+    if (strict) {
+        errors += non_monotonic_rows;
+    }
+
+    // Ground effect is optional, but if present the ratios are indexed
+    // by height the same way start thrusts are
+    const int heights = model.thrust_ratios.size();
+    if (heights == 1) {
+        std::cerr << "Ground effect needs at least two heights" << std::endl;
+        errors++;
+    } else if (heights > 1) {
+        if (!(model.height_max > model.height_min)) {
+            std::cerr << "Ground effect height_max must be greater than height_min"
+                      << std::endl;
+            errors++;
+        }
+        for (int i = 0; i < heights; i++) {
+            if (!(model.thrust_ratios[i] > 0.0)) {
+                std::cerr << "Thrust ratio " << model.thrust_ratios[i]
+                          << " at height " << i << " is not positive" << std::endl;
+                errors++;
+            }
+        }
+        if (std::abs(model.thrust_ratios.back() - 1.0) > 0.05) {
+            std::cerr << "Warning: thrust ratio at height_max is "
+                      << model.thrust_ratios.back()
+                      << ", ground effect is held there at all greater heights"
+                      << std::endl;
+        }
+    }
+
+    return errors;
+}
+
+// Maps the written file back in and makes sure it holds exactly the model
+bool verifyFile(const std::string& path,
+                const ThrustModelYaml::Model& model,
+                uint64_t source_checksum)
+{
+    ThrustModelFile::MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    const ThrustModelFile::Contents& read = file.contents();
+    const ThrustModelFile::Contents written = model.contents();
+    const size_t table_bytes = sizeof(double) * model.voltages.size();
+
+    return read.source_checksum == source_checksum
+        && read.num_coefficients == written.num_coefficients
+        && read.num_thrust_points == written.num_thrust_points
+        && read.num_voltage_points == written.num_voltage_points
+        && read.response_lag == written.response_lag
+        && read.small_thrust_epsilon == written.small_thrust_epsilon
+        && read.thrust_min == written.thrust_min
+        && read.thrust_max == written.thrust_max
+        && read.voltage_min == written.voltage_min
+        && read.voltage_max == written.voltage_max
+        && std::memcmp(read.thrust_to_voltage,
+                       written.thrust_to_voltage,
+                       sizeof(double) * written.num_coefficients) == 0
+        && std::memcmp(read.start_thrusts,
+                       written.start_thrusts,
+                       sizeof(double) * written.num_thrust_points) == 0
+        && std::memcmp(read.voltages, written.voltages, table_bytes) == 0
+        && std::memcmp(read.end_thrusts, written.end_thrusts, table_bytes) == 0
+        && read.num_height_points == written.num_height_points
+        && read.height_min == written.height_min
+        && read.height_max == written.height_max
+        && (written.num_height_points == 0
+            || std::memcmp(read.thrust_ratios,
+                           written.thrust_ratios,
+                           sizeof(double) * written.num_height_points) == 0);
+}
+
+} // End anonymous namespace
+
+int main(int argc, char **argv)
+{
+    bool strict = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--strict") == 0) {
+            strict = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--strict] <model.yaml> <model.tmb>" << std::endl;
+        return 2;
+    }
+
+    ThrustModelYaml::Model model;
+    if (!ThrustModelYaml::load(paths[0], model)) {
+        return 1;
+    }
+
+    int errors = validateModel(model, strict);
+    if (errors != 0) {
+        std::cerr << paths[0] << " failed validation with "
+                  << errors << " errors" << std::endl;
+        return 1;
+    }
+
+    // Lets the node tell when the yaml has changed since it was compiled
+    ThrustModelFile::Contents contents = model.contents();
+    if (!ThrustModelFile::sourceChecksum(paths[0], contents.source_checksum)) {
+        std::cerr << "Failed to read " << paths[0] << std::endl;
+        return 1;
+    }
+
+    if (!ThrustModelFile::write(paths[1], contents)) {
+        std::cerr << "Failed to write " << paths[1] << std::endl;
+        return 1;
+    }
+
+    if (!verifyFile(paths[1], model, contents.source_checksum)) {
+        std::cerr << "Readback of " << paths[1] << " does not match "
+                  << paths[0] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Compiled " << paths[0] << " ("
+              << model.num_thrust_points << "x" << model.num_voltage_points
+              << ") to " << paths[1] << std::endl;
+    return 0;
+}
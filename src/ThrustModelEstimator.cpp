@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Estimator
+//
+// Fits a scale and offset correction to a thrust model's thrust to voltage
+// mapping in flight, from the measured acceleration and the voltage that
+// was applied to the motors.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/ThrustModelEstimator.hpp"
+
+// System Headers
+#include <algorithm>
+#include <cmath>
+
+using namespace Iarc7Motion;
+
+ThrustModelEstimatorSettings ThrustModelEstimatorSettings::load(
+        const ros::NodeHandle& nh,
+        const std::string& prefix)
+{
+    ThrustModelEstimatorSettings settings;
+    nh.param(prefix + "_forgetting_factor",
+             settings.forgetting_factor,
+             settings.forgetting_factor);
+    nh.param(prefix + "_filter_time_constant",
+             settings.filter_time_constant,
+             settings.filter_time_constant);
+    nh.param(prefix + "_max_scale_error",
+             settings.max_scale_error,
+             settings.max_scale_error);
+    nh.param(prefix + "_max_offset",
+             settings.max_offset,
+             settings.max_offset);
+    nh.param(prefix + "_max_covariance",
+             settings.max_covariance,
+             settings.max_covariance);
+
+    ROS_ASSERT(settings.forgetting_factor > 0.0
+            && settings.forgetting_factor <= 1.0);
+    ROS_ASSERT(settings.filter_time_constant >= 0.0);
+    ROS_ASSERT(settings.max_scale_error >= 0.0 && settings.max_scale_error < 1.0);
+    ROS_ASSERT(settings.max_offset >= 0.0);
+    ROS_ASSERT(settings.max_covariance > 0.0);
+    return settings;
+}
+
+ThrustModelEstimator::ThrustModelEstimator(
+        const ThrustModelEstimatorSettings& settings)
+    : settings_(settings)
+{
+    reset();
+}
+
+bool ThrustModelEstimator::update(double dt,
+                                  double model_voltage,
+                                  double applied_voltage)
+{
+    if (!(dt > 0.0)
+     || !std::isfinite(model_voltage)
+     || !std::isfinite(applied_voltage)) {
+        return false;
+    }
+
+    if (!filters_initialized_) {
+        filtered_model_voltage_ = model_voltage;
+        filtered_applied_voltage_ = applied_voltage;
+        filters_initialized_ = true;
+    } else {
+        const double alpha = dt / (settings_.filter_time_constant + dt);
+        filtered_model_voltage_ += alpha * (model_voltage - filtered_model_voltage_);
+        filtered_applied_voltage_ += alpha * (applied_voltage - filtered_applied_voltage_);
+    }
+
+    const Eigen::Vector2d regressor(filtered_model_voltage_, 1.0);
+    const Eigen::Vector2d covariance_regressor = covariance_ * regressor;
+    const Eigen::Vector2d gain = covariance_regressor
+                               / (settings_.forgetting_factor
+                                  + regressor.dot(covariance_regressor));
+
+    const double error = filtered_applied_voltage_ - regressor.dot(estimate_);
+    estimate_ += gain * error;
+    covariance_ = (covariance_ - gain * covariance_regressor.transpose())
+                / settings_.forgetting_factor;
+
+    // Forgetting grows the covariance along directions the samples don't
+    // excite, scale it back before the gain gets large enough to chase noise
+    const double trace = covariance_.trace();
+    if (trace > settings_.max_covariance) {
+        covariance_ *= settings_.max_covariance / trace;
+    }
+
+    estimate_(0) = std::min(std::max(estimate_(0),
+                                     1.0 - settings_.max_scale_error),
+                            1.0 + settings_.max_scale_error);
+    estimate_(1) = std::min(std::max(estimate_(1), -settings_.max_offset),
+                            settings_.max_offset);
+    return true;
+}
+
+void ThrustModelEstimator::restartFilters()
+{
+    filters_initialized_ = false;
+    filtered_model_voltage_ = 0.0;
+    filtered_applied_voltage_ = 0.0;
+}
+
+void ThrustModelEstimator::reset()
+{
+    estimate_ << 1.0, 0.0;
+
+    // Start out unsure of the scale by a few percent and the offset by
+    // a fraction of a volt
+    covariance_ << 0.01, 0.0,
+                   0.0, 0.1;
+
+    restartFilters();
+}
+
+double ThrustModelEstimator::getScale() const
+{
+    return estimate_(0);
+}
+
+double ThrustModelEstimator::getOffset() const
+{
+    return estimate_(1);
+}
@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model File
+//
+// Binary, memory mappable form of a thrust model.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/ThrustModelFile.hpp"
+
+// System Headers
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ROS Headers
+#include <ros/ros.h>
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// 64 bit FNV-1a, continued from hash
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t checksum(const ThrustModelFile::Header& header,
+                  const void* payload)
+{
+    ThrustModelFile::Header zeroed_header = header;
+    zeroed_header.checksum = 0;
+    uint64_t hash = fnv1a(&zeroed_header,
+                          sizeof(zeroed_header),
+                          0xcbf29ce484222325ULL);
+    return fnv1a(payload, header.payload_size, hash);
+}
+
+} // End anonymous namespace
+
+size_t ThrustModelFile::payloadSize(const Contents& contents)
+{
+    size_t table_size = static_cast<size_t>(contents.num_thrust_points)
+                      * contents.num_voltage_points;
+    return sizeof(double) * (contents.num_coefficients
+                             + contents.num_thrust_points
+                             + 2 * table_size
+                             + contents.num_height_points);
+}
+
+bool ThrustModelFile::sourceChecksum(const std::string& path, uint64_t& checksum)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    char buffer[4096];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hash = fnv1a(buffer, file.gcount(), hash);
+    }
+    if (file.bad()) {
+        return false;
+    }
+
+    checksum = hash;
+    return true;
+}
+
+bool ThrustModelFile::write(const std::string& path, const Contents& contents)
+{
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(header.magic));
+    header.version = kVersion;
+    header.byte_order_mark = kByteOrderMark;
+    header.num_coefficients = contents.num_coefficients;
+    header.num_thrust_points = contents.num_thrust_points;
+    header.num_voltage_points = contents.num_voltage_points;
+    header.num_height_points = contents.num_height_points;
+    header.response_lag = contents.response_lag;
+    header.small_thrust_epsilon = contents.small_thrust_epsilon;
+    header.thrust_min = contents.thrust_min;
+    header.thrust_max = contents.thrust_max;
+    header.voltage_min = contents.voltage_min;
+    header.voltage_max = contents.voltage_max;
+    header.height_min = contents.height_min;
+    header.height_max = contents.height_max;
+    header.source_checksum = contents.source_checksum;
+    header.payload_size = payloadSize(contents);
+
+    // Lay the payload out contiguously so it can be checksummed in one pass
+    size_t table_size = static_cast<size_t>(contents.num_thrust_points)
+                      * contents.num_voltage_points;
+    std::string payload(header.payload_size, '\0');
+    char* out = &payload[0];
+    auto append = [&out](const double* values, size_t count) {
+        if (count > 0) {
+            std::memcpy(out, values, count * sizeof(double));
+            out += count * sizeof(double);
+        }
+    };
+    append(contents.thrust_to_voltage, contents.num_coefficients);
+    append(contents.start_thrusts, contents.num_thrust_points);
+    append(contents.voltages, table_size);
+    append(contents.end_thrusts, table_size);
+    append(contents.thrust_ratios, contents.num_height_points);
+
+    header.checksum = checksum(header, payload.data());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(payload.data(), payload.size());
+    file.close();
+    return static_cast<bool>(file);
+}
+
+ThrustModelFile::MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool ThrustModelFile::MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        ROS_ERROR("Failed to open thrust model file %s", path.c_str());
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0
+     || static_cast<size_t>(file_stat.st_size) < sizeof(Header)) {
+        ROS_ERROR("Thrust model file %s is too small", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = file_stat.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        ROS_ERROR("Failed to map thrust model file %s", path.c_str());
+        return false;
+    }
+
+    const Header& header = *static_cast<const Header*>(data);
+    const char* payload = static_cast<const char*>(data) + sizeof(Header);
+
+    const char* error = nullptr;
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        error = "bad magic";
+    } else if (header.byte_order_mark != kByteOrderMark) {
+        error = "wrong byte order";
+    } else if (header.version != kVersion) {
+        error = "unsupported version";
+    } else if (header.num_thrust_points < 2 || header.num_voltage_points < 2) {
+        error = "mapping is smaller than 2x2";
+    } else if (header.num_height_points == 1) {
+        error = "ground effect has a single height";
+    } else if (header.payload_size != size - sizeof(Header)) {
+        error = "payload size does not match file size";
+    } else if (checksum(header, payload) != header.checksum) {
+        error = "checksum mismatch";
+    }
+
+    Contents contents;
+    contents.response_lag = header.response_lag;
+    contents.small_thrust_epsilon = header.small_thrust_epsilon;
+    contents.thrust_min = header.thrust_min;
+    contents.thrust_max = header.thrust_max;
+    contents.voltage_min = header.voltage_min;
+    contents.voltage_max = header.voltage_max;
+    contents.num_coefficients = header.num_coefficients;
+    contents.num_thrust_points = header.num_thrust_points;
+    contents.num_voltage_points = header.num_voltage_points;
+    contents.num_height_points = header.num_height_points;
+    contents.height_min = header.height_min;
+    contents.height_max = header.height_max;
+    contents.source_checksum = header.source_checksum;
+
+    if (error == nullptr && payloadSize(contents) != header.payload_size) {
+        error = "payload size does not match dimensions";
+    }
+
+    if (error != nullptr) {
+        ROS_ERROR("Invalid thrust model file %s: %s", path.c_str(), error);
+        munmap(data, size);
+        return false;
+    }
+
+    size_t table_size = static_cast<size_t>(contents.num_thrust_points)
+                      * contents.num_voltage_points;
+    const double* arrays = reinterpret_cast<const double*>(payload);
+    contents.thrust_to_voltage = arrays;
+    contents.start_thrusts = contents.thrust_to_voltage + contents.num_coefficients;
+    contents.voltages = contents.start_thrusts + contents.num_thrust_points;
+    contents.end_thrusts = contents.voltages + table_size;
+    contents.thrust_ratios = contents.num_height_points > 0
+                           ? contents.end_thrusts + table_size
+                           : nullptr;
+
+    data_ = data;
+    size_ = size;
+    contents_ = contents;
+    return true;
+}
+
+void ThrustModelFile::MappedFile::close()
+{
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+        contents_ = Contents();
+    }
+}
+
+bool ThrustModelFile::MappedFile::isOpen() const
+{
+    return data_ != nullptr;
+}
+
+const ThrustModelFile::Contents& ThrustModelFile::MappedFile::contents() const
+{
+    ROS_ASSERT(isOpen());
+    return contents_;
+}
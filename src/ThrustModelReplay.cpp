@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Replay
+//
+// Replays thrust stand logs through a thrust model and measures how well
+// the model predicts the recorded thrust.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/ThrustModelReplay.hpp"
+
+// System Headers
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// Columns of a log line, same as graph_thrust_model_test.py
+constexpr int kThrustColumn = 0;
+constexpr int kThrustTimeColumn = 1;
+constexpr int kVoltageColumn = 4;
+constexpr int kThrottleColumn = 7;
+constexpr int kThrottleTimeColumn = 8;
+constexpr int kMinColumns = 9;
+
+// Throttle must be held this long before a sample counts as steady state
+constexpr double kSteadyStateTime = 0.5;
+
+bool parseLine(const std::string& line, ThrustModelReplay::Sample& sample)
+{
+    std::vector<double> columns;
+    std::istringstream stream(line);
+    std::string column;
+    while (std::getline(stream, column, ',')) {
+        char* end;
+        double value = std::strtod(column.c_str(), &end);
+        if (end == column.c_str()) {
+            return false;
+        }
+        columns.push_back(value);
+    }
+
+    if (columns.size() < kMinColumns) {
+        return false;
+    }
+
+    sample.time = columns[kThrustTimeColumn] / 1000000.0;
+    sample.thrust = columns[kThrustColumn];
+    sample.battery_voltage = columns[kVoltageColumn];
+    sample.throttle = columns[kThrottleColumn];
+    sample.throttle_time = columns[kThrottleTimeColumn] / 1000000.0;
+    return true;
+}
+
+// Linear interpolation of thrust in a segment, samples must be sorted
+// by time and time must lie within them
+double thrustAtTime(const ThrustModelReplay::Segment& segment, double time)
+{
+    auto after = std::lower_bound(segment.begin(),
+                                  segment.end(),
+                                  time,
+                                  [](const ThrustModelReplay::Sample& sample,
+                                     double t) { return sample.time < t; });
+    if (after == segment.begin()) {
+        return after->thrust;
+    }
+    auto before = after - 1;
+    double fraction = (time - before->time) / (after->time - before->time);
+    return before->thrust + fraction * (after->thrust - before->thrust);
+}
+
+ThrustModelReplay::ErrorStats computeStats(std::vector<double>& errors)
+{
+    ThrustModelReplay::ErrorStats stats;
+    stats.samples = errors.size();
+    if (errors.empty()) {
+        return stats;
+    }
+
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    for (double& error : errors) {
+        sum += error;
+        sum_squares += error * error;
+        error = std::abs(error);
+    }
+    std::sort(errors.begin(), errors.end());
+
+    stats.mean = sum / errors.size();
+    stats.rms = std::sqrt(sum_squares / errors.size());
+    stats.p95 = errors[static_cast<size_t>(0.95 * (errors.size() - 1))];
+    stats.max = errors.back();
+    return stats;
+}
+
+} // End anonymous namespace
+
+bool ThrustModelReplay::loadLog(const std::string& path,
+                                std::vector<Segment>& segments)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    segments.clear();
+    bool in_segment = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line == "START") {
+            in_segment = true;
+            segments.emplace_back();
+            continue;
+        }
+        if (line == "STOP") {
+            in_segment = false;
+            continue;
+        }
+        if (!in_segment) {
+            continue;
+        }
+
+        // The line after RESPONSE START holds the ramp rate, which only
+        // has one column and is dropped by parseLine
+        Sample sample;
+        if (!parseLine(line, sample)) {
+            continue;
+        }
+
+        // The load cell is slower than the log rate, only keep new readings
+        Segment& segment = segments.back();
+        if (!segment.empty() && sample.time <= segment.back().time) {
+            continue;
+        }
+        segment.push_back(sample);
+    }
+
+    segments.erase(std::remove_if(segments.begin(),
+                                  segments.end(),
+                                  [](const Segment& segment) {
+                                      return segment.size() < 2;
+                                  }),
+                   segments.end());
+    return !segments.empty();
+}
+
+ThrustModelReplay::Result ThrustModelReplay::replay(
+        const ThrustModel& model,
+        const std::vector<Segment>& segments)
+{
+    const double lag = model.response_lag;
+
+    std::vector<double> thrust_errors;
+    std::vector<double> voltage_errors;
+    for (const Segment& segment : segments) {
+        const double last_time = segment.back().time;
+
+        // Samples where the throttle changed, to tell whether it changes
+        // during a prediction window
+        std::vector<double> throttle_change_times;
+        for (size_t i = 1; i < segment.size(); i++) {
+            if (segment[i].throttle != segment[i-1].throttle) {
+                throttle_change_times.push_back(segment[i].throttle_time);
+            }
+        }
+
+        for (const Sample& sample : segment) {
+            if (sample.time + lag > last_time) {
+                break;
+            }
+
+            // Next throttle change after the one applied at this sample
+            auto next_change = std::upper_bound(throttle_change_times.begin(),
+                                                throttle_change_times.end(),
+                                                sample.throttle_time);
+            if (next_change != throttle_change_times.end()
+                    && *next_change <= sample.time + lag) {
+                continue;
+            }
+
+            const double motor_voltage = sample.battery_voltage
+                                       * sample.throttle / 100.0;
+
+            double predicted = model.predictThrust(sample.thrust, motor_voltage);
+            double measured = thrustAtTime(segment, sample.time + lag);
+            thrust_errors.push_back(predicted - measured);
+
+            // The throttle is resent every tick, so it has been held since
+            // the last change rather than since throttle_time
+            const double held_since = next_change == throttle_change_times.begin()
+                                    ? segment.front().time
+                                    : *(next_change - 1);
+            if (sample.throttle > 0.0
+                    && sample.time - held_since > kSteadyStateTime) {
+                voltage_errors.push_back(
+                        model.get_voltage_for_thrust(sample.thrust)
+                      - motor_voltage);
+            }
+        }
+    }
+
+    Result result;
+    result.dynamic_thrust = computeStats(thrust_errors);
+    result.steady_voltage = computeStats(voltage_errors);
+    return result;
+}
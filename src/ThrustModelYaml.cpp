@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Thrust Model Yaml
+//
+// Reads thrust model yaml files without going through the parameter
+// server, for the offline tools.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/ThrustModelYaml.hpp"
+
+// System Headers
+#include <iostream>
+#include <yaml-cpp/yaml.h>
+
+using namespace Iarc7Motion;
+
+ThrustModelFile::Contents ThrustModelYaml::Model::contents() const
+{
+    ThrustModelFile::Contents contents;
+    contents.response_lag = response_lag;
+    contents.small_thrust_epsilon = small_thrust_epsilon;
+    contents.thrust_min = thrust_min;
+    contents.thrust_max = thrust_max;
+    contents.voltage_min = voltage_min;
+    contents.voltage_max = voltage_max;
+    contents.num_coefficients = thrust_to_voltage.size();
+    contents.num_thrust_points = num_thrust_points;
+    contents.num_voltage_points = num_voltage_points;
+    contents.thrust_to_voltage = thrust_to_voltage.data();
+    contents.start_thrusts = start_thrusts.data();
+    contents.voltages = voltages.data();
+    contents.end_thrusts = end_thrusts.data();
+    contents.num_height_points = thrust_ratios.size();
+    contents.height_min = height_min;
+    contents.height_max = height_max;
+    contents.thrust_ratios = thrust_ratios.empty() ? nullptr : thrust_ratios.data();
+    return contents;
+}
+
+bool ThrustModelYaml::load(const std::string& path, Model& model)
+{
+    try {
+        YAML::Node root = YAML::LoadFile(path);
+        if (!root.IsMap()) {
+            std::cerr << path << " does not contain a thrust model" << std::endl;
+            return false;
+        }
+
+        YAML::Node voltage_to_jerk = root["voltage_to_jerk"];
+        model.thrust_min = voltage_to_jerk["thrust_min"].as<double>();
+        model.thrust_max = voltage_to_jerk["thrust_max"].as<double>();
+        model.voltage_min = voltage_to_jerk["voltage_min"].as<double>();
+        model.voltage_max = voltage_to_jerk["voltage_max"].as<double>();
+
+        model.response_lag = root["response_lag"].as<double>();
+        model.small_thrust_epsilon = root["small_thrust_epsilon"]
+            ? root["small_thrust_epsilon"].as<double>()
+            : (model.thrust_max - model.thrust_min) / 100;
+        model.thrust_to_voltage = root["thrust_to_voltage"].as<std::vector<double>>();
+
+        YAML::Node mapping = voltage_to_jerk["mapping"];
+        model.num_thrust_points = mapping.size();
+        model.num_voltage_points = model.num_thrust_points > 0
+                                 ? mapping[0][1].size()
+                                 : 0;
+
+        model.start_thrusts.clear();
+        model.voltages.clear();
+        model.end_thrusts.clear();
+        for (const YAML::Node& row : mapping) {
+            if (static_cast<int>(row[1].size()) != model.num_voltage_points) {
+                std::cerr << "Mapping rows have different lengths in "
+                          << path << std::endl;
+                return false;
+            }
+
+            model.start_thrusts.push_back(row[0].as<double>());
+            for (const YAML::Node& voltage_thrust : row[1]) {
+                model.voltages.push_back(voltage_thrust[0].as<double>());
+                model.end_thrusts.push_back(voltage_thrust[1].as<double>());
+            }
+        }
+
+        YAML::Node ground_effect = root["ground_effect"];
+        if (ground_effect) {
+            model.height_min = ground_effect["height_min"].as<double>();
+            model.height_max = ground_effect["height_max"].as<double>();
+            model.thrust_ratios = ground_effect["thrust_ratios"].as<std::vector<double>>();
+        } else {
+            model.height_min = 0.0;
+            model.height_max = 0.0;
+            model.thrust_ratios.clear();
+        }
+    } catch (const YAML::Exception& e) {
+        std::cerr << "Failed to parse " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,323 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Velocity Profile Generator
+//
+// Builds the jerk limited (S-curve) profile taking the targets from a start
+// state to a target velocity, as a PolynomialTrajectory the motion point
+// interpolator follows directly.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "iarc7_motion/VelocityProfileGenerator.hpp"
+
+// System Headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace Iarc7Motion;
+
+namespace
+{
+
+// Smallest share of the limits an axis gets, so an axis with no velocity
+// change can still bring its acceleration to zero
+const double kMinLimitShare = 0.1;
+
+// Length of the segment the targets come to rest in. Sampling past the end
+// holds the end of the last segment, so it only has to exist.
+const int64_t kRestSegmentNs = 1;
+
+// Constant jerk phases of one axis, unused phases have zero duration
+struct AxisProfile
+{
+    static constexpr int kNumPhases = 3;
+    double durations[kNumPhases] = {0.0, 0.0, 0.0};
+    double jerks[kNumPhases] = {0.0, 0.0, 0.0};
+};
+
+// Fastest profile from velocity v0 and acceleration a0 to velocity v1 and
+// zero acceleration with |acceleration| <= max_accel and |jerk| <= max_jerk
+AxisProfile planAxis(double v0, double a0, double v1, double max_accel, double max_jerk)
+{
+    AxisProfile profile;
+    a0 = std::min(std::max(a0, -max_accel), max_accel);
+
+    // Velocity reached by bringing the acceleration straight to zero
+    const double settle_velocity = v0 + a0 * std::abs(a0) / (2.0 * max_jerk);
+    const double direction = v1 > settle_velocity ? 1.0
+                           : v1 < settle_velocity ? -1.0
+                           : 0.0;
+
+    if (direction == 0.0) {
+        profile.durations[2] = std::abs(a0) / max_jerk;
+        profile.jerks[2] = a0 > 0.0 ? -max_jerk : max_jerk;
+        return profile;
+    }
+
+    // Work with a positive velocity change, the peak acceleration is then
+    // at least a0
+    const double dv = direction * (v1 - v0);
+    const double a = direction * a0;
+
+    double peak = std::sqrt(max_jerk * dv + 0.5 * a * a);
+    double cruise = 0.0;
+    if (peak > max_accel) {
+        peak = max_accel;
+        cruise = (dv - (2.0 * peak * peak - a * a) / (2.0 * max_jerk)) / peak;
+    }
+
+    profile.durations[0] = (peak - a) / max_jerk;
+    profile.jerks[0] = direction * max_jerk;
+    profile.durations[1] = std::max(cruise, 0.0);
+    profile.durations[2] = peak / max_jerk;
+    profile.jerks[2] = -direction * max_jerk;
+    return profile;
+}
+
+// Share of the limits each axis gets for changing velocity by
+// velocity_change starting at accel. An axis gets the fraction of the
+// whole change that is its own, but at least kMinLimitShare. Axes with
+// nothing to do don't use their share, the shares of the rest are scaled
+// down if needed so their length as a vector is at most one. The
+// magnitudes of the acceleration and jerk then stay within the limits.
+Eigen::Vector3d limitShares(const Eigen::Vector3d& velocity_change,
+                            const Eigen::Vector3d& accel)
+{
+    const double total_change = velocity_change.norm();
+
+    Eigen::Vector3d shares;
+    double active_squared_norm = 0.0;
+    for (int axis = 0; axis < 3; axis++) {
+        shares(axis) = total_change > 0.0
+                     ? std::max(std::abs(velocity_change(axis)) / total_change,
+                                kMinLimitShare)
+                     : 1.0;
+        if (velocity_change(axis) != 0.0 || accel(axis) != 0.0) {
+            active_squared_norm += shares(axis) * shares(axis);
+        }
+    }
+
+    if (active_squared_norm > 1.0) {
+        shares /= std::sqrt(active_squared_norm);
+    }
+    return shares;
+}
+
+// Appends the segments taking position, velocity and accel through the
+// phases of profiles, starting elapsed_ns after start_ns. The state and
+// elapsed_ns are advanced to the end of the last phase. Segments break
+// wherever any axis changes phase. Phase ends are rounded to whole
+// nanoseconds so the segments line up exactly with the times they are
+// sampled at.
+void appendPhases(const AxisProfile (&profiles)[3],
+                  int64_t start_ns,
+                  int64_t& elapsed_ns,
+                  Eigen::Vector3d& position,
+                  Eigen::Vector3d& velocity,
+                  Eigen::Vector3d& accel,
+                  PolynomialTrajectory& trajectory)
+{
+    int64_t phase_ends_ns[3][AxisProfile::kNumPhases];
+    int phase[3] = {0, 0, 0};
+    for (int axis = 0; axis < 3; axis++) {
+        double end = 0.0;
+        for (int i = 0; i < AxisProfile::kNumPhases; i++) {
+            end += profiles[axis].durations[i];
+            phase_ends_ns[axis][i] = elapsed_ns + std::llround(end * 1e9);
+        }
+    }
+
+    const Polynomial no_yaw_rate;
+    while (true) {
+        // Skip finished and empty phases
+        int64_t next_ns = -1;
+        for (int axis = 0; axis < 3; axis++) {
+            while (phase[axis] < AxisProfile::kNumPhases
+                    && phase_ends_ns[axis][phase[axis]] <= elapsed_ns) {
+                phase[axis]++;
+            }
+            if (phase[axis] < AxisProfile::kNumPhases
+                    && (next_ns < 0 || phase_ends_ns[axis][phase[axis]] < next_ns)) {
+                next_ns = phase_ends_ns[axis][phase[axis]];
+            }
+        }
+
+        if (next_ns < 0) {
+            break;
+        }
+
+        Polynomial positions[3];
+        const double dt = (next_ns - elapsed_ns) * 1e-9;
+        for (int axis = 0; axis < 3; axis++) {
+            const double j = phase[axis] < AxisProfile::kNumPhases
+                           ? profiles[axis].jerks[phase[axis]]
+                           : 0.0;
+            const double coefficients[4] = {j / 6.0,
+                                            accel(axis) / 2.0,
+                                            velocity(axis),
+                                            position(axis)};
+            const bool set = positions[axis].setCoefficients(coefficients, 4);
+            ROS_ASSERT(set);
+
+            position(axis) += dt * (velocity(axis) + dt * (accel(axis) / 2.0 + dt * j / 6.0));
+            velocity(axis) += dt * (accel(axis) + dt * j / 2.0);
+            accel(axis) += dt * j;
+        }
+
+        const bool appended = trajectory.appendSegment(start_ns + elapsed_ns,
+                                                       start_ns + next_ns,
+                                                       positions,
+                                                       no_yaw_rate);
+        ROS_ASSERT(appended);
+        elapsed_ns = next_ns;
+    }
+}
+
+// Appends a segment moving at constant velocity from position for
+// duration_ns, advancing position and elapsed_ns to its end
+void appendConstantVelocity(const Eigen::Vector3d& velocity,
+                            int64_t duration_ns,
+                            int64_t start_ns,
+                            int64_t& elapsed_ns,
+                            Eigen::Vector3d& position,
+                            PolynomialTrajectory& trajectory)
+{
+    Polynomial positions[3];
+    for (int axis = 0; axis < 3; axis++) {
+        const double coefficients[2] = {velocity(axis), position(axis)};
+        const bool set = positions[axis].setCoefficients(coefficients, 2);
+        ROS_ASSERT(set);
+    }
+    const bool appended = trajectory.appendSegment(start_ns + elapsed_ns,
+                                                   start_ns + elapsed_ns + duration_ns,
+                                                   positions,
+                                                   Polynomial());
+    ROS_ASSERT(appended);
+
+    position += velocity * (duration_ns * 1e-9);
+    elapsed_ns += duration_ns;
+}
+
+} // End anonymous namespace
+
+VelocityProfileSettings VelocityProfileSettings::load(
+        const ros::NodeHandle& nh,
+        const std::string& prefix)
+{
+    VelocityProfileSettings settings;
+    nh.param(prefix + "_acceleration",
+             settings.acceleration,
+             settings.acceleration);
+    nh.param(prefix + "_jerk",
+             settings.jerk,
+             settings.jerk);
+    nh.param(prefix + "_max_acceleration",
+             settings.max_acceleration,
+             settings.max_acceleration);
+    nh.param(prefix + "_max_jerk",
+             settings.max_jerk,
+             settings.max_jerk);
+    nh.param(prefix + "_hold_duration",
+             settings.hold_duration,
+             settings.hold_duration);
+
+    ROS_ASSERT(settings.acceleration > 0.0
+            && settings.acceleration <= settings.max_acceleration);
+    ROS_ASSERT(settings.jerk > 0.0 && settings.jerk <= settings.max_jerk);
+    ROS_ASSERT(settings.hold_duration > 0.0);
+    return settings;
+}
+
+VelocityProfileGenerator::VelocityProfileGenerator(
+        const VelocityProfileSettings& settings)
+    : settings_(settings)
+{
+}
+
+bool VelocityProfileGenerator::generate(
+        const TrajectorySample& start,
+        const Eigen::Vector3d& target_velocity,
+        double acceleration,
+        double jerk,
+        PolynomialTrajectory& trajectory) const
+{
+    trajectory.clear();
+
+    if (!(acceleration >= 0.0) || !(jerk >= 0.0)
+            || !start.vector().allFinite() || !target_velocity.allFinite()) {
+        ROS_ERROR("VelocityProfileGenerator given invalid start, target or limits");
+        return false;
+    }
+
+    if (acceleration == 0.0) {
+        acceleration = settings_.acceleration;
+    }
+    else if (acceleration > settings_.max_acceleration) {
+        ROS_ERROR("VelocityProfileGenerator requested acceleration %f is too large, "
+                  "limit %f", acceleration, settings_.max_acceleration);
+        acceleration = settings_.max_acceleration;
+    }
+
+    if (jerk == 0.0) {
+        jerk = settings_.jerk;
+    }
+    else if (jerk > settings_.max_jerk) {
+        ROS_ERROR("VelocityProfileGenerator requested jerk %f is too large, "
+                  "limit %f", jerk, settings_.max_jerk);
+        jerk = settings_.max_jerk;
+    }
+
+    Eigen::Vector3d position(start.values + TrajectorySample::kPositionX);
+    Eigen::Vector3d velocity(start.values + TrajectorySample::kVelocityX);
+    Eigen::Vector3d accel(start.values + TrajectorySample::kAccelX);
+
+    AxisProfile profiles[3];
+    const Eigen::Vector3d shares = limitShares(target_velocity - velocity, accel);
+    for (int axis = 0; axis < 3; axis++) {
+        profiles[axis] = planAxis(velocity(axis),
+                                  accel(axis),
+                                  target_velocity(axis),
+                                  shares(axis) * acceleration,
+                                  shares(axis) * jerk);
+        accel(axis) = std::min(std::max(accel(axis), -shares(axis) * acceleration),
+                               shares(axis) * acceleration);
+    }
+
+    int64_t elapsed_ns = 0;
+    appendPhases(profiles, start.stamp_ns, elapsed_ns, position, velocity, accel, trajectory);
+
+    // Hold the target velocity, snapping off the rounding left over from
+    // stepping through the phases
+    appendConstantVelocity(target_velocity,
+                           std::llround(settings_.hold_duration * 1e9),
+                           start.stamp_ns,
+                           elapsed_ns,
+                           position,
+                           trajectory);
+
+    // The targets at the end are held like the last point of a plan, so
+    // come to rest with the same limits first rather than hold a position
+    // while commanding a velocity
+    if (target_velocity != Eigen::Vector3d::Zero()) {
+        velocity = target_velocity;
+        accel.setZero();
+        const Eigen::Vector3d stop_shares = limitShares(-velocity, accel);
+        for (int axis = 0; axis < 3; axis++) {
+            profiles[axis] = planAxis(velocity(axis),
+                                      0.0,
+                                      0.0,
+                                      stop_shares(axis) * acceleration,
+                                      stop_shares(axis) * jerk);
+        }
+        appendPhases(profiles, start.stamp_ns, elapsed_ns, position, velocity, accel, trajectory);
+        appendConstantVelocity(Eigen::Vector3d::Zero(),
+                               kRestSegmentNs,
+                               start.stamp_ns,
+                               elapsed_ns,
+                               position,
+                               trajectory);
+    }
+    return true;
+}
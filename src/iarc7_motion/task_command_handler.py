@@ -19,6 +19,7 @@ from iarc7_safety.iarc_safety_exception import IARCFatalSafetyException
 
 from iarc7_msgs.msg import TwistStampedArray, OrientationThrottleStamped
 from iarc7_motion.msg import GroundInteractionGoal, GroundInteractionAction
+from iarc7_motion.msg import VelocityGoal
 
 from iarc7_motion.linear_motion_profile_generator import LinearMotionProfileGenerator
 
@@ -45,6 +46,12 @@ class TaskCommandHandler(object):
                                                  MotionPointStampedArray,
                                                  queue_size=0)
 
+        # used to send velocity goals to LLM, which generates the profile
+        # itself, when onboard_velocity_profile is set
+        self._velocity_goal_pub = rospy.Publisher('velocity_goal_targets',
+                                                  VelocityGoal,
+                                                  queue_size=0)
+
         # Used to send Path messages for visualizatio in Rviz
         self._local_plan_pub = rospy.Publisher('local_plan',
                                                Path,
@@ -67,6 +74,11 @@ class TaskCommandHandler(object):
 
         self._motion_profile_generator = LinearMotionProfileGenerator.get_linear_motion_profile_generator()
 
+        self._onboard_velocity_profile = rospy.get_param('~onboard_velocity_profile', False)
+        # Start point from the last ResetLinearProfileCommand, applied to
+        # the next velocity goal
+        self._reset_command = None
+
     # takes in new task from HLM Controller
     # transition is of type TransitionData
     def new_task(self, task, transition):
@@ -229,10 +241,16 @@ class TaskCommandHandler(object):
         pass
 
     def _handle_velocity_command(self, velocity_command):
+        if self._onboard_velocity_profile:
+            self._publish_velocity_goal(velocity_command)
+            return
         plan, pose_only_plan = self._motion_profile_generator.get_velocity_plan(velocity_command)
         self._publish_motion_profile(plan, pose_only_plan)
 
     def _handle_reset_linear_profile_command(self, reset_command):
+        if self._onboard_velocity_profile:
+            self._reset_command = reset_command
+            return
         self._motion_profile_generator.set_start_point(reset_command)
 
     def _handle_passthrough_mode_command(self, passthrough_mode_command):
@@ -317,6 +335,36 @@ class TaskCommandHandler(object):
         self._local_plan_pub.publish(path)
         self._motion_point_pub.publish(motion_point_stamped_array)
 
+    """
+    Sends a velocity goal to LLM in place of a motion profile
+
+    Args:
+        velocity_command: VelocityCommand
+    """
+    def _publish_velocity_goal(self, velocity_command):
+        goal = VelocityGoal()
+        goal.header.stamp = velocity_command.target_twist.header.stamp
+        goal.target_velocity = velocity_command.target_twist.twist.linear
+        if velocity_command.acceleration is not None:
+            goal.acceleration = velocity_command.acceleration
+
+        # Fields left as None keep LLM's current target, the command's
+        # start point takes priority over the last reset
+        starts = [(goal.start_position, 'start_position'),
+                  (goal.start_velocity, 'start_velocity')]
+        for start, name in starts:
+            for axis in ('x', 'y', 'z'):
+                value = getattr(getattr(velocity_command, name), axis)
+                if value is None and self._reset_command is not None:
+                    reset = getattr(self._reset_command, name)
+                    if reset is not None:
+                        value = getattr(reset, axis)
+                setattr(start, axis, float('nan') if value is None else value)
+        self._reset_command = None
+
+        self._last_twist = velocity_command.target_twist.twist
+        self._velocity_goal_pub.publish(goal)
+
     # public wrapper for HLM Controller to send timeouts
     def send_timeout(self, twist, acceleration=1.0):
         self._handle_velocity_command(task_commands.VelocityCommand(twist, acceleration=acceleration))
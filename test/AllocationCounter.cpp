@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Allocation Counter
+//
+// Replaces the C allocation functions with ones that count calls on the
+// calling thread and hand off to glibc's.
+//
+////////////////////////////////////////////////////////////////////////////
+
+// Associated header
+#include "AllocationCounter.hpp"
+
+// glibc's allocator, which the replacements below forward to
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+// Constant initialized, so reading it never allocates
+static thread_local size_t thread_allocation_count = 0;
+
+extern "C" void* malloc(size_t size)
+{
+    thread_allocation_count++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    thread_allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    thread_allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+
+using namespace Iarc7Motion;
+
+AllocationCounter::AllocationCounter()
+    : start_(thread_allocation_count)
+{
+}
+
+size_t AllocationCounter::count() const
+{
+    return thread_allocation_count - start_;
+}
@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////////
+//
+// Allocation Counter
+//
+// Counts the heap allocations made by the calling thread, so tests can
+// check that the control loop hot path never reaches the allocator.
+// Linking test/AllocationCounter.cpp into a test replaces malloc, calloc
+// and realloc for the whole process, which catches operator new as well
+// as Eigen, which allocates with malloc directly. Allocations made by
+// other threads, like ROS spinners, aren't counted.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+namespace Iarc7Motion
+{
+
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+
+    // Allocations made by this thread since construction
+    size_t count() const;
+
+private:
+    const size_t start_;
+};
+
+} // End namespace Iarc7Motion
+
+#endif // ALLOCATION_COUNTER_HPP
@@ -0,0 +1,64 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/ControlLoopTimer.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+namespace Iarc7Motion
+{
+    TEST(ControlLoopTimerTests, testDeadlines)
+    {
+        const int64_t period = 5000000;
+        ControlLoopStats stats;
+        stats.wake_ns = 1000000000;
+        stats.deadline_ns = stats.wake_ns + period;
+
+        // On time, woken 20 us late
+        ControlLoopTimer::beginSleep(period, stats.wake_ns + 1000000, stats);
+        EXPECT_EQ(stats.work_ns, 1000000);
+        EXPECT_EQ(stats.deadline_ns, 1005000000);
+        ControlLoopTimer::endSleep(period, 1005020000, stats);
+        EXPECT_EQ(stats.period_ns, 5020000);
+        EXPECT_EQ(stats.jitter_ns, 20000);
+        EXPECT_EQ(stats.deadline_ns, 1010000000);
+        EXPECT_EQ(stats.ticks, 1u);
+        EXPECT_EQ(stats.deadline_misses, 0u);
+
+        // Working through two deadlines skips them and keeps the phase
+        ControlLoopTimer::beginSleep(period, 1016000000, stats);
+        EXPECT_EQ(stats.work_ns, 10980000);
+        EXPECT_EQ(stats.deadline_misses, 2u);
+        EXPECT_EQ(stats.deadline_ns, 1020000000);
+        ControlLoopTimer::endSleep(period, 1020000000, stats);
+        EXPECT_EQ(stats.period_ns, 14980000);
+        EXPECT_EQ(stats.jitter_ns, 0);
+        EXPECT_EQ(stats.deadline_ns, 1025000000);
+
+        // Going to sleep right at the deadline misses it
+        ControlLoopTimer::beginSleep(period, 1025000000, stats);
+        EXPECT_EQ(stats.deadline_misses, 3u);
+        EXPECT_EQ(stats.deadline_ns, 1030000000);
+    }
+
+    TEST(ControlLoopTimerTests, testSleep)
+    {
+        ControlLoopTimer timer(1000.0);
+        int64_t deadline = timer.stats().deadline_ns;
+        for (int i = 0; i < 20; i++) {
+            timer.sleep();
+
+            // Never wakes before the deadline, which advances by whole
+            // periods
+            EXPECT_GE(timer.stats().jitter_ns, 0);
+            EXPECT_EQ((timer.stats().deadline_ns - deadline) % 1000000, 0);
+            deadline = timer.stats().deadline_ns;
+        }
+        EXPECT_EQ(timer.stats().ticks, 20u);
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/LatencyHistogram.hpp"
+#include "iarc7_motion/LatencyMonitor.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+namespace Iarc7Motion
+{
+    TEST(LatencyHistogramTests, testBuckets)
+    {
+        // Buckets are contiguous and within a sub bucket of their values
+        EXPECT_EQ(LatencyHistogram::bucketIndex(-5), 0u);
+        EXPECT_EQ(LatencyHistogram::bucketUpperBound(0), 0);
+        for (size_t i = 1; i < LatencyHistogram::kNumBuckets; i++) {
+            const int64_t lower = LatencyHistogram::bucketUpperBound(i - 1) + 1;
+            const int64_t upper = LatencyHistogram::bucketUpperBound(i);
+            ASSERT_LE(lower, upper);
+            EXPECT_EQ(LatencyHistogram::bucketIndex(lower), i);
+            EXPECT_EQ(LatencyHistogram::bucketIndex(upper), i);
+            EXPECT_LE(upper - lower + 1,
+                      std::max<int64_t>(1, lower / LatencyHistogram::kSubBuckets));
+        }
+
+        // Values past the range go in the last bucket
+        EXPECT_EQ(LatencyHistogram::bucketIndex(INT64_MAX),
+                  LatencyHistogram::kNumBuckets - 1);
+    }
+
+    TEST(LatencyHistogramTests, testPercentiles)
+    {
+        LatencyHistogram histogram;
+        LatencyHistogram::Counts counts;
+        histogram.snapshot(counts);
+        EXPECT_EQ(LatencyHistogram::percentile(counts, 0.5), 0);
+
+        // 1 to 1000 us
+        for (int64_t i = 1; i <= 1000; i++) {
+            histogram.record(i * 1000);
+        }
+        histogram.snapshot(counts);
+        EXPECT_EQ(LatencyHistogram::total(counts), 1000u);
+
+        const double percentiles[3] = {0.5, 0.99, 1.0};
+        for (double fraction : percentiles) {
+            const double expected = fraction * 1e6;
+            const int64_t value = LatencyHistogram::percentile(counts, fraction);
+            EXPECT_GE(value, expected);
+            EXPECT_LE(value, expected * (1.0 + 1.0 / LatencyHistogram::kSubBuckets));
+        }
+    }
+
+    TEST(LatencyHistogramTests, testReportStage)
+    {
+        LatencyHistogram histogram;
+        LatencyMonitor::Stage stage;
+        stage.name = "stage";
+        stage.histogram = &histogram;
+        stage.reported.reset(new LatencyHistogram::Counts());
+        stage.reported->fill(0);
+        std::unique_ptr<LatencyHistogram::Counts> counts(new LatencyHistogram::Counts());
+
+        diagnostic_msgs::DiagnosticStatus status;
+        LatencyMonitor::reportStage(stage, *counts, status);
+        ASSERT_EQ(status.values.size(), 4u);
+        EXPECT_EQ(status.values[0].value, "0");
+
+        for (int i = 0; i < 99; i++) {
+            histogram.record(10000);
+        }
+        histogram.record(5000000);
+        LatencyMonitor::reportStage(stage, *counts, status);
+        EXPECT_EQ(status.values[0].value, "100");
+        EXPECT_NEAR(std::atof(status.values[1].value.c_str()), 10.0, 10.0 / 16);
+        EXPECT_NEAR(std::atof(status.values[2].value.c_str()), 10.0, 10.0 / 16);
+        EXPECT_NEAR(std::atof(status.values[3].value.c_str()), 5000.0, 5000.0 / 16);
+
+        // Each report only covers what was recorded since the last one
+        histogram.record(20000);
+        LatencyMonitor::reportStage(stage, *counts, status);
+        EXPECT_EQ(status.values[0].value, "1");
+        EXPECT_NEAR(std::atof(status.values[3].value.c_str()), 20.0, 20.0 / 16);
+    }
+
+    TEST(LatencyHistogramTests, testConcurrentSnapshots)
+    {
+        // Reading while another thread records sees counts only grow
+        LatencyHistogram histogram;
+        const int records = 200000;
+        std::thread recorder([&histogram]() {
+            for (int i = 0; i < records; i++) {
+                histogram.record(i % 5000);
+            }
+        });
+
+        LatencyHistogram::Counts counts;
+        uint64_t last_total = 0;
+        for (int i = 0; i < 100; i++) {
+            histogram.snapshot(counts);
+            const uint64_t total = LatencyHistogram::total(counts);
+            EXPECT_GE(total, last_total);
+            last_total = total;
+        }
+        recorder.join();
+
+        histogram.snapshot(counts);
+        EXPECT_EQ(LatencyHistogram::total(counts), static_cast<uint64_t>(records));
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,103 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/LockedCallbackQueue.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <boost/make_shared.hpp>
+
+#include <ros/callback_queue.h>
+#include <ros/callback_queue_interface.h>
+
+namespace Iarc7Motion
+{
+    // Records whether the mutex was held while it was called
+    class MutexCheckingCallback : public ros::CallbackInterface
+    {
+    public:
+        MutexCheckingCallback(std::mutex& mutex, CallResult result)
+            : mutex_(mutex),
+              result_(result),
+              called_locked_(false)
+        {
+        }
+
+        CallResult call() override
+        {
+            called_locked_ = !mutex_.try_lock();
+            if (!called_locked_) {
+                mutex_.unlock();
+            }
+            return result_;
+        }
+
+        std::mutex& mutex_;
+        const CallResult result_;
+        bool called_locked_;
+    };
+
+    TEST(LockedCallbackQueueTests, testCallbacksRunLocked)
+    {
+        ros::CallbackQueue queue;
+        std::mutex mutex;
+        std::condition_variable called;
+        LockedCallbackQueue locked_queue(queue, mutex, called);
+
+        auto callback = boost::make_shared<MutexCheckingCallback>(
+                mutex, ros::CallbackInterface::Success);
+        locked_queue.addCallback(callback);
+        queue.callAvailable();
+
+        EXPECT_TRUE(callback->called_locked_);
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(locked_queue.callCount(), 1u);
+    }
+
+    TEST(LockedCallbackQueueTests, testOnlySuccessesCounted)
+    {
+        ros::CallbackQueue queue;
+        std::mutex mutex;
+        std::condition_variable called;
+        LockedCallbackQueue locked_queue(queue, mutex, called);
+
+        locked_queue.addCallback(boost::make_shared<MutexCheckingCallback>(
+                mutex, ros::CallbackInterface::Invalid));
+        queue.callAvailable();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(locked_queue.callCount(), 0u);
+    }
+
+    TEST(LockedCallbackQueueTests, testWaiterNotified)
+    {
+        ros::CallbackQueue queue;
+        std::mutex mutex;
+        std::condition_variable called;
+        LockedCallbackQueue locked_queue(queue, mutex, called);
+
+        locked_queue.addCallback(boost::make_shared<MutexCheckingCallback>(
+                mutex, ros::CallbackInterface::Success));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        std::thread spinner([&queue]() { queue.callAvailable(); });
+        const bool woken = called.wait_for(
+                lock,
+                std::chrono::seconds(5),
+                [&locked_queue]() { return locked_queue.callCount() > 0; });
+        lock.unlock();
+        spinner.join();
+
+        EXPECT_TRUE(woken);
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -4,9 +4,26 @@
 // Bring in gtest
 #include "gtest/gtest.h"
 
+#include <boost/make_shared.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <thread>
+
 
 namespace Iarc7Motion
 {
+    // Plan message holding motion_points
+    MotionPointQueue::PlanConstPtr makePlan(const MotionPointStampedArray& motion_points)
+    {
+        iarc7_msgs::MotionPointStampedArray::Ptr plan(
+                new iarc7_msgs::MotionPointStampedArray());
+        plan->motion_points = motion_points;
+        return plan;
+    }
+
     TEST(MotionPointInterpolatorTests, testTrimMotionPointQueue)
     {
         typedef Iarc7Motion::MotionPointInterpolator Planner;
@@ -14,14 +31,16 @@ namespace Iarc7Motion
         ros::Time::init();
         ros::Time current_time(ros::Time::now());
 
-        Iarc7Motion::MotionPointStampedArray motion_points;
+        Iarc7Motion::MotionPointQueue motion_points(10);
+        Iarc7Motion::MotionPointStampedArray initial_motion_points;
         // Create an array of 10 motion_points
         for(int32_t i = 0; i < 10; i++)
         {
             MotionPointStamped motion_point;
             motion_point.header.stamp = current_time + ros::Duration(i);
-            motion_points.push_back(motion_point);
+            initial_motion_points.push_back(motion_point);
         }
+        ASSERT_TRUE(motion_points.push_back(makePlan(initial_motion_points), 0, 10));
 
         // Check general trimming
         // Check to make the sure the function doesn't incur an internal error
@@ -55,30 +74,32 @@ namespace Iarc7Motion
         ros::Time::init();
         ros::Time current_time(ros::Time::now());
 
-        Iarc7Motion::MotionPointStampedArray motion_points;
+        Iarc7Motion::MotionPointQueue motion_points(32);
+        Iarc7Motion::MotionPointStampedArray initial_motion_points;
         Iarc7Motion::MotionPointStampedArray motion_points_append;
         // Create an array of 10 motion points and ten motion points to append
         for(int32_t i = 0; i < 10; i++)
         {
             MotionPointStamped motion_point;
             motion_point.header.stamp = current_time + ros::Duration(i);
-            motion_points.push_back(motion_point);
+            initial_motion_points.push_back(motion_point);
             motion_point.header.stamp = current_time + ros::Duration(i+11.0);
             motion_points_append.push_back(motion_point);
         }
+        ASSERT_TRUE(motion_points.push_back(makePlan(initial_motion_points), 0, 10));
 
         // Make sure a list of old timestamps is rejected except for the last
         size_t expected_size = motion_points.size() + 1;
         ros::Time expected_time = motion_points_append.back().header.stamp;
-        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, motion_points_append, current_time + ros::Duration(40.0)));
+        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, makePlan(motion_points_append), current_time + ros::Duration(40.0)));
         EXPECT_EQ(motion_points.size(), expected_size);
         EXPECT_EQ(motion_points.back().header.stamp, expected_time);
         // Cleanup
-        motion_points.pop_back();
+        motion_points.truncate(motion_points.size() - 1);
 
         // See if it will append all at the end as expected
         expected_size = motion_points.size() + motion_points_append.size();
-        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, motion_points_append, current_time));
+        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, makePlan(motion_points_append), current_time));
         EXPECT_EQ(motion_points.size(), expected_size);
 
         for(int32_t i = 0; i < 10; i++)
@@ -93,7 +114,7 @@ namespace Iarc7Motion
         // See if it will overwrite in the middle as expected
         motion_points_append.pop_back();
         --expected_size;
-        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, motion_points_append, current_time));
+        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, makePlan(motion_points_append), current_time));
         EXPECT_EQ(motion_points.size(), expected_size);
 
         for(int32_t i = 0; i < 10; i++)
@@ -111,21 +132,23 @@ namespace Iarc7Motion
         // See if it will not add the whole list if current time is more than the beginning
         // Regenerate motion_points and motion_points_append
         motion_points.clear();
+        initial_motion_points.clear();
         motion_points_append.clear();
         // Create an array of 10 motion points and ten motion points to append
         for(int32_t i = 0; i < 10; i++)
         {
             MotionPointStamped motion_point;
             motion_point.header.stamp = current_time + ros::Duration(i);
-            motion_points.push_back(motion_point);
+            initial_motion_points.push_back(motion_point);
             motion_point.header.stamp = current_time + ros::Duration(i+11.0);
             motion_points_append.push_back(motion_point);
         }
+        ASSERT_TRUE(motion_points.push_back(makePlan(initial_motion_points), 0, 10));
 
         // Should cut one element off of motion_points_append
         // since it will keep the first one before the target time if it exists
         expected_size = motion_points.size() + motion_points_append.size() - 1;
-        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, motion_points_append, current_time+ros::Duration(13.0)));
+        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, makePlan(motion_points_append), current_time+ros::Duration(13.0)));
         EXPECT_EQ(motion_points.size(), expected_size);
 
         for(int32_t i = 0; i < 10; i++)
@@ -142,7 +165,1211 @@ namespace Iarc7Motion
 
         // Make sure it errors when handed an empty motion_point
         motion_points_append.clear();
-        ASSERT_FALSE(Planner::appendMotionPointQueue(motion_points, motion_points_append, current_time));
+        ASSERT_FALSE(Planner::appendMotionPointQueue(motion_points, makePlan(motion_points_append), current_time));
+    }
+
+    TEST(MotionPointInterpolatorTests, testInterpolateMotionPoints)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        MotionPointStamped begin_message;
+        begin_message.header.stamp = current_time;
+        begin_message.header.frame_id = "map";
+        begin_message.motion_point.pose.position.x = 1.0;
+        begin_message.motion_point.pose.position.y = 2.0;
+        begin_message.motion_point.pose.position.z = 3.0;
+        begin_message.motion_point.twist.linear.x = 4.0;
+        begin_message.motion_point.twist.linear.y = 5.0;
+        begin_message.motion_point.twist.linear.z = 6.0;
+        begin_message.motion_point.twist.angular.z = 7.0;
+        begin_message.motion_point.accel.linear.x = 8.0;
+        begin_message.motion_point.accel.linear.y = 9.0;
+        begin_message.motion_point.accel.linear.z = 10.0;
+
+        // Conversion keeps every field the controller follows
+        TrajectorySample begin = TrajectorySample::fromMessage(begin_message);
+        MotionPointStamped round_trip;
+        begin.toMessage(round_trip);
+        EXPECT_EQ(round_trip.header.stamp, current_time);
+        EXPECT_EQ(round_trip.motion_point.pose.position.x, 1.0);
+        EXPECT_EQ(round_trip.motion_point.pose.position.y, 2.0);
+        EXPECT_EQ(round_trip.motion_point.pose.position.z, 3.0);
+        EXPECT_EQ(round_trip.motion_point.twist.linear.x, 4.0);
+        EXPECT_EQ(round_trip.motion_point.twist.linear.y, 5.0);
+        EXPECT_EQ(round_trip.motion_point.twist.linear.z, 6.0);
+        EXPECT_EQ(round_trip.motion_point.twist.angular.z, 7.0);
+        EXPECT_EQ(round_trip.motion_point.accel.linear.x, 8.0);
+        EXPECT_EQ(round_trip.motion_point.accel.linear.y, 9.0);
+        EXPECT_EQ(round_trip.motion_point.accel.linear.z, 10.0);
+
+        // Every field is interpolated linearly in time
+        TrajectorySample end = begin;
+        end.stamp_ns += 2000000000;
+        for(int32_t i = 0; i < TrajectorySample::kSize; i++)
+        {
+            end.values[i] = -begin.values[i];
+        }
+
+        TrajectorySample interpolated;
+        int64_t time_ns = begin.stamp_ns + 500000000;
+        ASSERT_TRUE(Planner::interpolateMotionPoints(begin, end, interpolated, time_ns));
+        EXPECT_EQ(interpolated.stamp_ns, time_ns);
+        for(int32_t i = 0; i < TrajectorySample::kSize; i++)
+        {
+            EXPECT_DOUBLE_EQ(interpolated.values[i], 0.5 * begin.values[i]);
+        }
+
+        ASSERT_TRUE(Planner::interpolateMotionPoints(begin, end, interpolated, end.stamp_ns));
+        for(int32_t i = 0; i < TrajectorySample::kSize; i++)
+        {
+            EXPECT_DOUBLE_EQ(interpolated.values[i], end.values[i]);
+        }
+
+        // Times outside of the two samples are rejected
+        EXPECT_FALSE(Planner::interpolateMotionPoints(begin, end, interpolated, begin.stamp_ns - 1));
+        EXPECT_FALSE(Planner::interpolateMotionPoints(begin, end, interpolated, end.stamp_ns + 1));
+        EXPECT_FALSE(Planner::interpolateMotionPoints(end, begin, interpolated, time_ns));
+    }
+
+    // Sample of a trajectory at time seconds after stamp 0, yaw rate is
+    // left at zero
+    template <class Trajectory>
+    TrajectorySample sampleTrajectory(Trajectory trajectory, double time)
+    {
+        TrajectorySample sample;
+        sample.vector().setZero();
+        sample.stamp_ns = std::llround(time * 1e9);
+        for(int32_t axis = 0; axis < 3; axis++)
+        {
+            trajectory(axis,
+                       time,
+                       sample.values[TrajectorySample::kPositionX + axis],
+                       sample.values[TrajectorySample::kVelocityX + axis],
+                       sample.values[TrajectorySample::kAccelX + axis]);
+        }
+        return sample;
+    }
+
+    TEST(MotionPointInterpolatorTests, testInterpolateMotionPointsHermite)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        EXPECT_EQ(Planner::interpolationModeFromName("linear"), InterpolationMode::LINEAR);
+        EXPECT_EQ(Planner::interpolationModeFromName("cubic"), InterpolationMode::CUBIC);
+        EXPECT_EQ(Planner::interpolationModeFromName("quintic"), InterpolationMode::QUINTIC);
+        EXPECT_EQ(Planner::interpolationModeFromName("bogus"), InterpolationMode::LINEAR);
+
+        // Quintic and cubic in time with different coefficients on each axis
+        auto quintic = [](int32_t axis, double t, double& p, double& v, double& a) {
+            const double c[6] = {1.0 + axis, -2.0, 3.0 - axis, 0.5, -4.0 + axis, 2.0};
+            p = c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+            v = c[1] + t * (2 * c[2] + t * (3 * c[3] + t * (4 * c[4] + t * 5 * c[5])));
+            a = 2 * c[2] + t * (6 * c[3] + t * (12 * c[4] + t * 20 * c[5]));
+        };
+        auto cubic = [](int32_t axis, double t, double& p, double& v, double& a) {
+            const double c[4] = {-1.0, 0.5 * axis, 2.0, -3.0 + axis};
+            p = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+            v = c[1] + t * (2 * c[2] + t * 3 * c[3]);
+            a = 2 * c[2] + t * 6 * c[3];
+        };
+
+        // Each mode reproduces a polynomial of its order exactly from its
+        // two ends, yaw rate is still interpolated linearly
+        TrajectorySample begin = sampleTrajectory(quintic, 0.25);
+        TrajectorySample end = sampleTrajectory(quintic, 0.75);
+        begin.values[TrajectorySample::kYawRate] = 1.0;
+        end.values[TrajectorySample::kYawRate] = 3.0;
+        for(double time = 0.25; time <= 0.75; time += 0.05)
+        {
+            TrajectorySample expected = sampleTrajectory(quintic, time);
+            TrajectorySample interpolated;
+            ASSERT_TRUE(Planner::interpolateMotionPoints(
+                            begin, end, interpolated, expected.stamp_ns,
+                            InterpolationMode::QUINTIC));
+            EXPECT_EQ(interpolated.stamp_ns, expected.stamp_ns);
+            for(int32_t i = 0; i < TrajectorySample::kYawRate; i++)
+            {
+                EXPECT_NEAR(interpolated.values[i], expected.values[i], 1e-9);
+            }
+            EXPECT_NEAR(interpolated.values[TrajectorySample::kYawRate],
+                        1.0 + 4.0 * (time - 0.25), 1e-9);
+        }
+
+        begin = sampleTrajectory(cubic, 0.25);
+        end = sampleTrajectory(cubic, 0.75);
+        for(double time = 0.25; time <= 0.75; time += 0.05)
+        {
+            TrajectorySample expected = sampleTrajectory(cubic, time);
+            TrajectorySample interpolated;
+            ASSERT_TRUE(Planner::interpolateMotionPoints(
+                            begin, end, interpolated, expected.stamp_ns,
+                            InterpolationMode::CUBIC));
+            for(int32_t i = 0; i < TrajectorySample::kYawRate; i++)
+            {
+                EXPECT_NEAR(interpolated.values[i], expected.values[i], 1e-9);
+            }
+        }
+
+        // Two samples at the same time give the first one
+        TrajectorySample interpolated;
+        ASSERT_TRUE(Planner::interpolateMotionPoints(
+                        begin, begin, interpolated, begin.stamp_ns,
+                        InterpolationMode::QUINTIC));
+        for(int32_t i = 0; i < TrajectorySample::kSize; i++)
+        {
+            EXPECT_EQ(interpolated.values[i], begin.values[i]);
+        }
+        EXPECT_FALSE(Planner::interpolateMotionPoints(
+                        begin, end, interpolated, end.stamp_ns + 1,
+                        InterpolationMode::CUBIC));
+
+        // On a smooth trajectory sampled 5 times as coarsely, quintic
+        // tracks position, velocity and acceleration at least as well as
+        // linear does, and cubic does for position and velocity
+        auto smooth = [](int32_t axis, double t, double& p, double& v, double& a) {
+            const double w = 2.0 + axis;
+            p = std::sin(w * t);
+            v = w * std::cos(w * t);
+            a = -w * w * std::sin(w * t);
+        };
+        // Largest error in position, velocity and acceleration over one
+        // second sampled every timestep and interpolated every ms
+        auto max_errors = [&smooth](double timestep, InterpolationMode mode, double errors[3]) {
+            errors[0] = errors[1] = errors[2] = 0.0;
+            for(int32_t ms = 0; ms <= 1000; ms++)
+            {
+                const double time = ms * 1e-3;
+                const double segment = std::floor(time / timestep);
+                TrajectorySample segment_begin = sampleTrajectory(smooth, segment * timestep);
+                TrajectorySample segment_end = sampleTrajectory(smooth, (segment + 1) * timestep);
+                TrajectorySample expected = sampleTrajectory(smooth, time);
+
+                TrajectorySample segment_interpolated;
+                ASSERT_TRUE(Planner::interpolateMotionPoints(
+                                segment_begin, segment_end, segment_interpolated,
+                                expected.stamp_ns, mode));
+                for(int32_t i = 0; i < TrajectorySample::kYawRate; i++)
+                {
+                    double& error = errors[(i - TrajectorySample::kPositionX) / 3];
+                    error = std::max(error, std::abs(segment_interpolated.values[i] - expected.values[i]));
+                }
+            }
+        };
+        double linear_errors[3];
+        double cubic_errors[3];
+        double quintic_errors[3];
+        max_errors(0.02, InterpolationMode::LINEAR, linear_errors);
+        max_errors(0.1, InterpolationMode::CUBIC, cubic_errors);
+        max_errors(0.1, InterpolationMode::QUINTIC, quintic_errors);
+        for(int32_t order = 0; order < 3; order++)
+        {
+            EXPECT_LE(quintic_errors[order], linear_errors[order]);
+        }
+        EXPECT_LE(cubic_errors[0], linear_errors[0]);
+        EXPECT_LE(cubic_errors[1], linear_errors[1]);
+    }
+
+    TEST(MotionPointInterpolatorTests, testMotionPointQueueWraparound)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        // Run a queue with room for 8 targets through several laps of its
+        // storage, the way it is used in flight: append a plan overlapping
+        // the end of the last one then trim up to the current time
+        Iarc7Motion::MotionPointQueue motion_points(8);
+        MotionPointStampedArray first_point(1);
+        first_point[0].header.stamp = current_time;
+        ASSERT_TRUE(motion_points.push_back(makePlan(first_point), 0, 1));
+
+        MotionPointQueue::PlanConstPtr last_plan;
+        for(int32_t plan = 1; plan < 20; plan++)
+        {
+            // Plans are 5 points 1 second apart, the next starting 3 seconds
+            // after this one, so the tail of each plan is replaced
+            Iarc7Motion::MotionPointStampedArray new_motion_points;
+            for(int32_t i = 0; i < 5; i++)
+            {
+                MotionPointStamped motion_point;
+                motion_point.header.stamp = current_time + ros::Duration(3 * plan + i);
+                motion_point.motion_point.pose.position.x = 3 * plan + i;
+                new_motion_points.push_back(motion_point);
+            }
+            MotionPointQueue::PlanConstPtr new_plan = makePlan(new_motion_points);
+
+            ros::Time time = current_time + ros::Duration(3 * plan + 0.5);
+            ASSERT_TRUE(Planner::appendMotionPointQueue(motion_points, new_plan, time));
+
+            // The new plan is queued in place behind what is left of the
+            // last one
+            EXPECT_EQ(new_plan.use_count(), 2);
+            EXPECT_EQ(&motion_points.back(), &new_plan->motion_points.back());
+            if(plan > 1)
+            {
+                ASSERT_EQ(motion_points.numPlans(), 2);
+                ASSERT_EQ(motion_points.size(), 8);
+                EXPECT_EQ(motion_points[2].header.stamp,
+                          current_time + ros::Duration(3 * plan - 1));
+                EXPECT_EQ(motion_points[3].header.stamp,
+                          current_time + ros::Duration(3 * plan));
+            }
+
+            ASSERT_TRUE(Planner::trimMotionPointQueue(motion_points, time));
+
+            // One point before the current time and the rest of the plan,
+            // the last plan has been released
+            ASSERT_EQ(motion_points.numPlans(), 1);
+            ASSERT_EQ(motion_points.size(), 5);
+            if(last_plan)
+            {
+                EXPECT_EQ(last_plan.use_count(), 1);
+            }
+            for(size_t i = 0; i < motion_points.size(); i++)
+            {
+                EXPECT_EQ(motion_points[i].header.stamp,
+                          current_time + ros::Duration(3 * plan + i));
+                EXPECT_EQ(motion_points[i].motion_point.pose.position.x, 3 * plan + i);
+            }
+            EXPECT_EQ(motion_points.front().header.stamp,
+                      current_time + ros::Duration(3 * plan));
+            EXPECT_EQ(motion_points.back().header.stamp,
+                      current_time + ros::Duration(3 * plan + 4));
+
+            TrajectorySample interpolated;
+            ASSERT_TRUE(Planner::interpolateMotionPoints(
+                            TrajectorySample::fromMessage(motion_points[0]),
+                            TrajectorySample::fromMessage(motion_points[1]),
+                            interpolated,
+                            time.toNSec()));
+            EXPECT_DOUBLE_EQ(interpolated.values[TrajectorySample::kPositionX],
+                             3 * plan + 0.5);
+
+            last_plan = new_plan;
+        }
+
+        // Trimming everything but the last point works from any offset
+        ASSERT_TRUE(Planner::trimMotionPointQueue(motion_points, current_time + ros::Duration(100.0)));
+        ASSERT_EQ(motion_points.size(), 1);
+        EXPECT_EQ(motion_points[0].header.stamp, current_time + ros::Duration(3 * 19 + 4));
+
+        // Clearing releases the last plan
+        motion_points.clear();
+        EXPECT_EQ(motion_points.numPlans(), 0);
+        EXPECT_EQ(last_plan.use_count(), 1);
+    }
+
+    TEST(MotionPointInterpolatorTests, testAppendMotionPointQueueOverflow)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        EXPECT_EQ(Planner::queueCapacity(2.0, 0.02), 102);
+        EXPECT_EQ(Planner::queueCapacity(0.2, 0.02), 12);
+
+        Iarc7Motion::MotionPointQueue motion_points(Planner::queueCapacity(0.5, 0.1));
+        ASSERT_EQ(motion_points.capacity(), 7);
+
+        Iarc7Motion::MotionPointStampedArray new_motion_points;
+        for(int32_t i = 0; i < 10; i++)
+        {
+            MotionPointStamped motion_point;
+            motion_point.header.stamp = current_time + ros::Duration(0.1 * i);
+            new_motion_points.push_back(motion_point);
+        }
+
+        // A plan longer than the queue is cut off at the queue's capacity
+        EXPECT_FALSE(Planner::appendMotionPointQueue(motion_points, makePlan(new_motion_points), current_time));
+        ASSERT_EQ(motion_points.size(), 7);
+        EXPECT_EQ(motion_points.back().header.stamp, current_time + ros::Duration(0.6));
+
+        // Once trimmed the queue takes a replacement plan again
+        new_motion_points.resize(5);
+        ASSERT_TRUE(Planner::trimMotionPointQueue(motion_points, current_time + ros::Duration(0.25)));
+        EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, makePlan(new_motion_points), current_time + ros::Duration(0.25)));
+        ASSERT_EQ(motion_points.size(), 3);
+        EXPECT_EQ(motion_points.front().header.stamp, current_time + ros::Duration(0.2));
+        EXPECT_EQ(motion_points.back().header.stamp, current_time + ros::Duration(0.4));
+
+        // Plans one after another, none replacing any of the last, fill it
+        // up the same way
+        std::vector<MotionPointQueue::PlanConstPtr> plans;
+        for(int32_t plan = 0; plan < 3; plan++)
+        {
+            Iarc7Motion::MotionPointStampedArray plan_motion_points;
+            for(int32_t i = 0; i < 2; i++)
+            {
+                MotionPointStamped motion_point;
+                motion_point.header.stamp = current_time + ros::Duration(1 + plan + 0.5 * i);
+                plan_motion_points.push_back(motion_point);
+            }
+            plans.push_back(makePlan(plan_motion_points));
+        }
+
+        for(int32_t plan = 0; plan < 2; plan++)
+        {
+            EXPECT_TRUE(Planner::appendMotionPointQueue(motion_points, plans[plan], current_time + ros::Duration(0.25)));
+        }
+        EXPECT_FALSE(Planner::appendMotionPointQueue(motion_points, plans[2], current_time + ros::Duration(0.25)));
+        ASSERT_EQ(motion_points.size(), 7);
+        EXPECT_EQ(motion_points.back().header.stamp, current_time + ros::Duration(2.5));
+        EXPECT_EQ(plans[2].use_count(), 1);
+    }
+
+    TEST(MotionPointInterpolatorTests, testPlanHandoffStress)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time start_time(ros::Time::now());
+
+        // Every plan samples the same trajectory, x equal to the seconds
+        // since start_time, so any interpolated target can be checked no
+        // matter which plans it came from
+        const int32_t num_plans = 100000;
+        const int32_t plan_points = 20;
+        const ros::Duration plan_period(0.001);
+        const ros::Duration point_spacing(0.01);
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        Iarc7Motion::MotionPointQueue motion_points(Planner::queueCapacity(1.0, 0.01));
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+        MotionPointStampedArray first_point(1);
+        first_point[0].header.stamp = start_time;
+        ASSERT_TRUE(motion_points.push_back(makePlan(first_point), 0, 1));
+
+        // Publishes plans as fast as the control thread takes them
+        std::atomic<bool> producer_done(false);
+        int32_t full_count = 0;
+        std::thread producer([&]() {
+            for(int32_t plan = 0; plan < num_plans; plan++)
+            {
+                PendingPlan pending_plan;
+                pending_plan.time = start_time + plan_period * plan;
+
+                MotionPointStampedArray new_motion_points(plan_points);
+                for(int32_t i = 0; i < plan_points; i++)
+                {
+                    new_motion_points[i].header.stamp = pending_plan.time + point_spacing * i;
+                    new_motion_points[i].motion_point.pose.position.x
+                        = (new_motion_points[i].header.stamp - start_time).toSec();
+                }
+                pending_plan.plan = makePlan(new_motion_points);
+
+                while(!pending_plans.push(pending_plan))
+                {
+                    full_count++;
+                    std::this_thread::yield();
+                }
+            }
+            producer_done = true;
+        });
+
+        // Samples targets in between taking plans, the way the control loop
+        // does. Yields between ticks like the control loop sleeps, otherwise
+        // on a single core the producer would hardly run.
+        ros::Time time = start_time;
+        int32_t samples = 0;
+        bool done = false;
+        while(!done)
+        {
+            std::this_thread::yield();
+            done = producer_done;
+            ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, time, motion_points, polynomial_targets, plan_splice, generator, InterpolationMode::LINEAR));
+
+            for(size_t i = 1; i < motion_points.size(); i++)
+            {
+                ASSERT_LT(motion_points[i-1].header.stamp, motion_points[i].header.stamp);
+            }
+
+            // Sample partway into the newest plan
+            ros::Time latest = motion_points.back().header.stamp - ros::Duration(0.1);
+            if(latest > time)
+            {
+                time = latest;
+            }
+            if(!(time > motion_points.front().header.stamp))
+            {
+                continue;
+            }
+
+            ASSERT_TRUE(Planner::trimMotionPointQueue(motion_points, time));
+            ASSERT_GE(motion_points.size(), 2);
+
+            TrajectorySample interpolated;
+            ASSERT_TRUE(Planner::interpolateMotionPoints(
+                            TrajectorySample::fromMessage(motion_points[0]),
+                            TrajectorySample::fromMessage(motion_points[1]),
+                            interpolated,
+                            time.toNSec()));
+            ASSERT_NEAR(interpolated.values[TrajectorySample::kPositionX],
+                        (time - start_time).toSec(),
+                        1e-9);
+            samples++;
+        }
+        producer.join();
+
+        // Every plan made it through, the queue ends with the last one
+        EXPECT_TRUE(pending_plans.empty());
+        EXPECT_FALSE(polynomial_targets.trajectory);
+        EXPECT_EQ(motion_points.back().header.stamp,
+                  start_time + plan_period * (num_plans - 1) + point_spacing * (plan_points - 1));
+        EXPECT_GT(samples, 0);
+        RecordProperty("samples", samples);
+        RecordProperty("handoff_full_count", full_count);
+    }
+
+    // Segment starting at start seconds after time lasting duration seconds,
+    // with position x following x and yaw rate following yaw_rate
+    iarc7_motion::PolynomialTrajectorySegment makeSegment(
+            const ros::Time& time,
+            double start,
+            double duration,
+            const std::vector<double>& x,
+            const std::vector<double>& yaw_rate = std::vector<double>())
+    {
+        iarc7_motion::PolynomialTrajectorySegment segment;
+        segment.start_time = time + ros::Duration(start);
+        segment.duration = duration;
+        segment.x = x;
+        segment.y = {1.0};
+        segment.z = {2.0};
+        segment.yaw_rate = yaw_rate;
+        return segment;
+    }
+
+    TEST(MotionPointInterpolatorTests, testPolynomialTrajectory)
+    {
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        // x = t^3 - 2t + 1 for a second, then x = 3 - t for a second
+        iarc7_motion::PolynomialTrajectory message;
+        message.segments.push_back(makeSegment(current_time, 0.0, 1.0, {1.0, 0.0, -2.0, 1.0}, {0.5}));
+        message.segments.push_back(makeSegment(current_time, 1.0, 1.0, {-1.0, 3.0}));
+
+        PolynomialTrajectory trajectory;
+        ASSERT_TRUE(trajectory.fromMessage(message));
+        EXPECT_EQ(trajectory.startNs(), static_cast<int64_t>(current_time.toNSec()));
+        EXPECT_EQ(trajectory.endNs(), static_cast<int64_t>((current_time + ros::Duration(2.0)).toNSec()));
+
+        // Velocity and acceleration are the derivatives of position
+        TrajectorySample sample;
+        int64_t time_ns = (current_time + ros::Duration(0.5)).toNSec();
+        ASSERT_TRUE(trajectory.sample(time_ns, sample));
+        EXPECT_EQ(sample.stamp_ns, time_ns);
+        EXPECT_NEAR(sample.values[TrajectorySample::kPositionX], 0.125 - 1.0 + 1.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kVelocityX], 0.75 - 2.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kAccelX], 3.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kPositionY], 1.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kVelocityY], 0.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kAccelY], 0.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kPositionZ], 2.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kYawRate], 0.5, 1e-9);
+
+        // The second segment starts over at t = 0 and has no yaw rate
+        time_ns = (current_time + ros::Duration(1.25)).toNSec();
+        ASSERT_TRUE(trajectory.sample(time_ns, sample));
+        EXPECT_NEAR(sample.values[TrajectorySample::kPositionX], 2.75, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kVelocityX], -1.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kAccelX], 0.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kYawRate], 0.0, 1e-9);
+
+        // The end of the last segment is held
+        time_ns = (current_time + ros::Duration(5.0)).toNSec();
+        ASSERT_TRUE(trajectory.sample(time_ns, sample));
+        EXPECT_EQ(sample.stamp_ns, time_ns);
+        EXPECT_NEAR(sample.values[TrajectorySample::kPositionX], 2.0, 1e-9);
+        EXPECT_NEAR(sample.values[TrajectorySample::kVelocityX], -1.0, 1e-9);
+
+        // Nothing before the first segment
+        EXPECT_FALSE(trajectory.sample(trajectory.startNs() - 1, sample));
+
+        // Invalid messages are rejected
+        iarc7_motion::PolynomialTrajectory invalid;
+        EXPECT_FALSE(trajectory.fromMessage(invalid));
+        EXPECT_TRUE(trajectory.empty());
+
+        invalid = message;
+        invalid.segments[1].start_time = invalid.segments[0].start_time;
+        EXPECT_FALSE(trajectory.fromMessage(invalid));
+
+        invalid = message;
+        invalid.segments[0].duration = 0.0;
+        EXPECT_FALSE(trajectory.fromMessage(invalid));
+
+        invalid = message;
+        invalid.segments[0].z.clear();
+        EXPECT_FALSE(trajectory.fromMessage(invalid));
+
+        invalid = message;
+        invalid.segments[0].x.assign(Polynomial::kMaxCoefficients + 1, 1.0);
+        EXPECT_FALSE(trajectory.fromMessage(invalid));
+        EXPECT_TRUE(trajectory.empty());
+    }
+
+    TEST(MotionPointInterpolatorTests, testPolynomialTargets)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        // Dense plan with x = 10 + t for 10 seconds
+        Iarc7Motion::MotionPointStampedArray dense_motion_points;
+        for(int32_t i = 0; i <= 10; i++)
+        {
+            MotionPointStamped motion_point;
+            motion_point.header.stamp = current_time + ros::Duration(i);
+            motion_point.motion_point.pose.position.x = 10.0 + i;
+            dense_motion_points.push_back(motion_point);
+        }
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        Iarc7Motion::MotionPointQueue motion_points(128);
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        Iarc7Motion::TargetCursor cursor;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+
+        PendingPlan pending_plan;
+        pending_plan.plan = makePlan(dense_motion_points);
+        pending_plan.time = current_time;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+
+        // Trajectory from 2 to 4 seconds with x equal to the seconds since
+        // current_time
+        iarc7_motion::PolynomialTrajectory message;
+        message.segments.push_back(makeSegment(current_time, 2.0, 2.0, {1.0, 2.0}));
+        std::shared_ptr<PolynomialTrajectory> trajectory = std::make_shared<PolynomialTrajectory>();
+        ASSERT_TRUE(trajectory->fromMessage(message));
+
+        pending_plan = PendingPlan();
+        pending_plan.polynomial_plan = trajectory;
+        pending_plan.time = current_time;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+
+        // The trajectory replaces the dense plan from its start
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, current_time, motion_points, polynomial_targets, plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(polynomial_targets.trajectory, trajectory);
+        ASSERT_EQ(motion_points.size(), 2);
+        EXPECT_EQ(motion_points.back().header.stamp, current_time + ros::Duration(1.0));
+
+        TrajectorySample target;
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           current_time + ros::Duration(0.5),
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 10.5, 1e-9);
+
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           current_time + ros::Duration(2.5),
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 2.5, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 1.0, 1e-9);
+        EXPECT_EQ(motion_points.size(), 1);
+
+        // A dense plan starting partway through takes over where it starts
+        Iarc7Motion::MotionPointStampedArray later_motion_points(2);
+        later_motion_points[0].header.stamp = current_time + ros::Duration(3.0);
+        later_motion_points[0].motion_point.pose.position.x = 20.0;
+        later_motion_points[1].header.stamp = current_time + ros::Duration(4.0);
+        later_motion_points[1].motion_point.pose.position.x = 21.0;
+        pending_plan = PendingPlan();
+        pending_plan.plan = makePlan(later_motion_points);
+        pending_plan.time = current_time + ros::Duration(2.5);
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, current_time, motion_points, polynomial_targets, plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(polynomial_targets.end_ns,
+                  static_cast<int64_t>((current_time + ros::Duration(3.0)).toNSec()));
+
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           current_time + ros::Duration(2.75),
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 2.75, 1e-9);
+        EXPECT_EQ(motion_points.size(), 3);
+
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           current_time + ros::Duration(3.5),
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 20.5, 1e-9);
+        EXPECT_FALSE(polynomial_targets.trajectory);
+        EXPECT_EQ(trajectory.use_count(), 1);
+
+        // A dense plan starting before the trajectory replaces all of it
+        pending_plan = PendingPlan();
+        pending_plan.polynomial_plan = trajectory;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        pending_plan = PendingPlan();
+        pending_plan.plan = makePlan(dense_motion_points);
+        pending_plan.time = current_time;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, current_time, motion_points, polynomial_targets, plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_FALSE(polynomial_targets.trajectory);
+    }
+
+    TEST(MotionPointInterpolatorTests, testVelocityGoal)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        ros::Time current_time(ros::Time::now());
+
+        // Hovering at (1, 2, 3) from current_time
+        Iarc7Motion::MotionPointStampedArray hover_motion_points(2);
+        for(int32_t i = 0; i < 2; i++)
+        {
+            hover_motion_points[i].header.stamp = current_time + ros::Duration(i);
+            hover_motion_points[i].motion_point.pose.position.x = 1.0;
+            hover_motion_points[i].motion_point.pose.position.y = 2.0;
+            hover_motion_points[i].motion_point.pose.position.z = 3.0;
+        }
+
+        Iarc7Motion::MotionPointQueue motion_points(128);
+        ASSERT_TRUE(motion_points.push_back(makePlan(hover_motion_points), 0, 2));
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        Iarc7Motion::TargetCursor cursor;
+        VelocityProfileSettings settings;
+        const VelocityProfileGenerator generator(settings);
+
+        // Moving in x from half a second in, with the height reset to 4
+        iarc7_motion::VelocityGoal goal;
+        goal.header.stamp = current_time + ros::Duration(0.5);
+        goal.target_velocity.x = 1.0;
+        goal.start_position.x = std::numeric_limits<double>::quiet_NaN();
+        goal.start_position.y = std::numeric_limits<double>::quiet_NaN();
+        goal.start_position.z = 4.0;
+        goal.start_velocity.x = std::numeric_limits<double>::quiet_NaN();
+        goal.start_velocity.y = std::numeric_limits<double>::quiet_NaN();
+        goal.start_velocity.z = std::numeric_limits<double>::quiet_NaN();
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        PendingPlan pending_plan;
+        pending_plan.velocity_goal = boost::make_shared<iarc7_motion::VelocityGoal>(goal);
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, current_time, motion_points, polynomial_targets, plan_splice,
+                                               generator, InterpolationMode::LINEAR));
+        ASSERT_TRUE(polynomial_targets.trajectory);
+        EXPECT_EQ(polynomial_targets.trajectory->startNs(),
+                  static_cast<int64_t>(goal.header.stamp.toNSec()));
+
+        // The profile takes over at the goal's stamp from the hover
+        TrajectorySample target;
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           goal.header.stamp,
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 1.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionY], 2.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionZ], 4.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 0.0, 1e-9);
+
+        // And reaches the target velocity
+        const ros::Time reached = goal.header.stamp
+            + ros::Duration(1.0 / settings.acceleration + settings.acceleration / settings.jerk);
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice, reached,
+                                           InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 1.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kAccelX], 0.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityY], 0.0, 1e-9);
+
+        // A goal stamped before the oldest queued motion point starts from
+        // that motion point instead
+        goal.header.stamp = current_time - ros::Duration(1.0);
+        goal.start_position.z = std::numeric_limits<double>::quiet_NaN();
+        ASSERT_TRUE(Planner::applyVelocityGoal(motion_points, polynomial_targets, plan_splice, generator,
+                                               InterpolationMode::LINEAR, goal));
+        EXPECT_EQ(polynomial_targets.trajectory->startNs(),
+                  static_cast<int64_t>(current_time.toNSec()));
+        ASSERT_TRUE(polynomial_targets.trajectory->sample(
+                        polynomial_targets.trajectory->startNs(), target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 1.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionZ], 3.0, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 0.0, 1e-9);
+
+        // Invalid goals are dropped
+        goal.acceleration = -1.0;
+        EXPECT_FALSE(Planner::applyVelocityGoal(motion_points, polynomial_targets, plan_splice, generator,
+                                                InterpolationMode::LINEAR, goal));
+    }
+    TEST(MotionPointInterpolatorTests, testFutureVelocityGoal)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time current_time(ros::Time::now());
+
+        // Dense plan moving at 1 m/s in x, a motion point every 20 ms
+        Iarc7Motion::MotionPointStampedArray line_motion_points(100);
+        for(size_t i = 0; i < line_motion_points.size(); i++)
+        {
+            line_motion_points[i].header.stamp = current_time + ros::Duration(0.02 * i);
+            line_motion_points[i].motion_point.pose.position.x = 0.02 * i;
+            line_motion_points[i].motion_point.twist.linear.x = 1.0;
+        }
+
+        Iarc7Motion::MotionPointQueue motion_points(128);
+        ASSERT_TRUE(motion_points.push_back(makePlan(line_motion_points),
+                                            0,
+                                            line_motion_points.size()));
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        Iarc7Motion::TargetCursor cursor;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+
+        // Speeding up to 2 m/s from half a second ahead of the control loop
+        iarc7_motion::VelocityGoal goal;
+        goal.header.stamp = current_time + ros::Duration(0.5);
+        goal.target_velocity.x = 2.0;
+        goal.start_position.x = std::numeric_limits<double>::quiet_NaN();
+        goal.start_position.y = std::numeric_limits<double>::quiet_NaN();
+        goal.start_position.z = std::numeric_limits<double>::quiet_NaN();
+        goal.start_velocity.x = std::numeric_limits<double>::quiet_NaN();
+        goal.start_velocity.y = std::numeric_limits<double>::quiet_NaN();
+        goal.start_velocity.z = std::numeric_limits<double>::quiet_NaN();
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        PendingPlan pending_plan;
+        pending_plan.velocity_goal = boost::make_shared<iarc7_motion::VelocityGoal>(goal);
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, current_time, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::LINEAR));
+
+        // The motion points up to the goal's stamp are still there
+        EXPECT_EQ(motion_points.front().header.stamp, current_time);
+
+        // Every control tick until the profile starts still has a target.
+        // The motion points before the goal's stamp are followed, then the
+        // profile speeds up from the plan.
+        for(int i = 0; i < 70; i++)
+        {
+            const double t = 0.01 * i;
+            TrajectorySample target;
+            ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                               current_time + ros::Duration(t),
+                                               InterpolationMode::LINEAR, cursor, target))
+                << "at " << t;
+            if(i <= 48)
+            {
+                EXPECT_NEAR(target.values[TrajectorySample::kPositionX], t, 1e-9);
+                EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 1.0, 1e-9);
+            }
+            else if(i > 50)
+            {
+                EXPECT_GT(target.values[TrajectorySample::kVelocityX], 1.0);
+            }
+        }
+    }
+
+    // Plan with x = x0 + v (t - t0) for t0 + start to t0 + end seconds,
+    // with points spaced 0.1 seconds apart
+    MotionPointQueue::PlanConstPtr makeLinePlan(const ros::Time& t0,
+                                                double start,
+                                                double end,
+                                                double x0,
+                                                double v)
+    {
+        MotionPointStampedArray motion_points;
+        for(double t = start; t <= end + 1e-9; t += 0.1)
+        {
+            MotionPointStamped motion_point;
+            motion_point.header.stamp = t0 + ros::Duration(t);
+            motion_point.motion_point.pose.position.x = x0 + v * t;
+            motion_point.motion_point.twist.linear.x = v;
+            motion_points.push_back(motion_point);
+        }
+        return makePlan(motion_points);
+    }
+
+    TEST(MotionPointInterpolatorTests, testTakePlansWithoutSampling)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time t0(ros::Time::now());
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        Iarc7Motion::MotionPointQueue motion_points(Planner::queueCapacity(2.0, 0.1));
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+        ASSERT_TRUE(motion_points.push_back(makeLinePlan(t0, 0.0, 0.0, 0.0, 0.0), 0, 1));
+
+        // A new plan every tick while something else flies the quad, many
+        // more than the handoff holds, each offset from the last in x
+        const int num_ticks = 100;
+        ros::Time time;
+        for(int i = 0; i < num_ticks; i++)
+        {
+            time = t0 + ros::Duration(0.1 * i);
+
+            PendingPlan pending_plan;
+            pending_plan.plan = makeLinePlan(t0, 0.1 * i, 0.1 * i + 1.0, i, 1.0);
+            pending_plan.time = time;
+            ASSERT_TRUE(pending_plans.push(pending_plan));
+
+            ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, time, motion_points,
+                                                   polynomial_targets, plan_splice,
+                                                   generator, InterpolationMode::LINEAR));
+            Planner::trimTargets(motion_points, polynomial_targets, time);
+            ASSERT_LE(motion_points.numPlans(), 2u);
+        }
+
+        // The newest plan is the one followed
+        Iarc7Motion::TargetCursor cursor;
+        TrajectorySample target;
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           time, InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX],
+                    num_ticks - 1 + (time - t0).toSec(),
+                    1e-9);
+    }
+
+    TEST(MotionPointInterpolatorTests, testPlanSplice)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time t0(ros::Time::now());
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        Iarc7Motion::MotionPointQueue motion_points(128);
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        Iarc7Motion::TargetCursor cursor;
+        plan_splice.blend_duration_ns = 200000000;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+
+        // Nothing is being followed yet, so the first plan is not a splice
+        PendingPlan pending_plan;
+        pending_plan.plan = makeLinePlan(t0, 0.0, 2.0, 0.0, 1.0);
+        pending_plan.time = t0;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, t0, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(plan_splice.metrics.splices, 0);
+
+        TrajectorySample target;
+        ros::Time time = t0 + ros::Duration(0.5);
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           time, InterpolationMode::LINEAR, cursor, target));
+        plan_splice.last_target_ns = time.toNSec();
+
+        // Plan jumping ahead and speeding up, x = 2t from half a second
+        time = t0 + ros::Duration(0.55);
+        pending_plan.plan = makeLinePlan(t0, 0.5, 2.0, 0.0, 2.0);
+        pending_plan.time = time;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, time, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(plan_splice.metrics.splices, 1);
+        EXPECT_NEAR(plan_splice.metrics.last_position_jump, 0.55, 1e-9);
+        EXPECT_NEAR(plan_splice.metrics.last_velocity_jump, 1.0, 1e-9);
+        EXPECT_NEAR(plan_splice.metrics.last_accel_jump, 0.0, 1e-9);
+        EXPECT_NEAR(plan_splice.metrics.max_position_jump, 0.55, 1e-9);
+
+        // The targets carry on from the old plan and blend into the new
+        // one without jumping
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           time, InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 0.55, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 1.0, 1e-9);
+        double last_x = target.values[TrajectorySample::kPositionX];
+        for(int32_t i = 1; i <= 200; i++)
+        {
+            ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                               time + ros::Duration(0.001 * i),
+                                               InterpolationMode::LINEAR, cursor, target));
+            const double x = target.values[TrajectorySample::kPositionX];
+            EXPECT_GT(x, last_x);
+            EXPECT_LT(x - last_x, 0.01);
+            last_x = x;
+        }
+
+        // And follow the new plan once the blend is over
+        time += ros::Duration(0.25);
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           time, InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 1.6, 1e-9);
+        EXPECT_NEAR(target.values[TrajectorySample::kVelocityX], 2.0, 1e-9);
+        plan_splice.last_target_ns = time.toNSec();
+
+        // Without blending the jump is still recorded
+        plan_splice.blend_duration_ns = 0;
+        pending_plan.plan = makeLinePlan(t0, 0.7, 2.0, 1.0, 2.0);
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, time, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(plan_splice.metrics.splices, 2);
+        EXPECT_NEAR(plan_splice.metrics.last_position_jump, 1.0, 1e-9);
+        EXPECT_NEAR(plan_splice.metrics.max_position_jump, 1.0, 1e-9);
+        ASSERT_TRUE(Planner::sampleTargets(motion_points, polynomial_targets, plan_splice,
+                                           time, InterpolationMode::LINEAR, cursor, target));
+        EXPECT_NEAR(target.values[TrajectorySample::kPositionX], 2.6, 1e-9);
+
+        // Plans arriving after the controller stopped following the targets
+        // are not splices
+        time += ros::Duration(1.0);
+        pending_plan.plan = makeLinePlan(t0, 1.7, 2.0, 0.0, 2.0);
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, time, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::LINEAR));
+        EXPECT_EQ(plan_splice.metrics.splices, 2);
+    }
+    TEST(MotionPointInterpolatorTests, testTargetLookahead)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time t0(ros::Time::now());
+
+        Iarc7Motion::PlanHandoff pending_plans;
+        Iarc7Motion::MotionPointQueue motion_points(128);
+        Iarc7Motion::PolynomialTargets polynomial_targets;
+        Iarc7Motion::PlanSplice plan_splice;
+        const VelocityProfileGenerator generator((VelocityProfileSettings()));
+
+        // Dense plan x = t, a trajectory of two segments from 0.5 to 1.5
+        // seconds, then a dense plan x = 2t taking over from there
+        iarc7_motion::PolynomialTrajectory message;
+        message.segments.push_back(makeSegment(t0, 0.5, 0.5, {1.0, 0.0, 0.5}));
+        message.segments.push_back(makeSegment(t0, 1.0, 0.5, {-1.0, 1.0}, {0.25}));
+        std::shared_ptr<PolynomialTrajectory> trajectory = std::make_shared<PolynomialTrajectory>();
+        ASSERT_TRUE(trajectory->fromMessage(message));
+
+        PendingPlan pending_plan;
+        pending_plan.plan = makeLinePlan(t0, 0.0, 2.0, 0.0, 1.0);
+        pending_plan.time = t0;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        pending_plan = PendingPlan();
+        pending_plan.polynomial_plan = trajectory;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        pending_plan = PendingPlan();
+        pending_plan.plan = makeLinePlan(t0, 1.5, 3.0, 0.0, 2.0);
+        pending_plan.time = t0;
+        ASSERT_TRUE(pending_plans.push(pending_plan));
+        ASSERT_TRUE(Planner::applyPendingPlans(pending_plans, t0, motion_points, polynomial_targets,
+                                               plan_splice, generator, InterpolationMode::CUBIC));
+
+        // Batch sampled in one sweep matches each time looked up on its own
+        std::vector<ros::Time> times;
+        for(double t = 0.0; t < 3.5; t += 0.013)
+        {
+            times.push_back(t0 + ros::Duration(t));
+        }
+        Iarc7Motion::TargetCursor cursor;
+        std::vector<TrajectorySample> targets;
+        ASSERT_TRUE(Planner::peekTargets(motion_points, polynomial_targets, plan_splice,
+                                         times, InterpolationMode::CUBIC, cursor, targets));
+        ASSERT_EQ(targets.size(), times.size());
+        for(size_t i = 0; i < times.size(); i++)
+        {
+            Iarc7Motion::TargetCursor single_cursor;
+            TrajectorySample target;
+            ASSERT_TRUE(Planner::peekTargets(motion_points, polynomial_targets, plan_splice,
+                                             times[i], InterpolationMode::CUBIC,
+                                             single_cursor, target));
+            EXPECT_EQ(target.stamp_ns, targets[i].stamp_ns);
+            for(int j = 0; j < TrajectorySample::kSize; j++)
+            {
+                EXPECT_NEAR(target.values[j], targets[i].values[j], 1e-12);
+            }
+        }
+        EXPECT_EQ(cursor.motion_point, motion_points.size());
+        EXPECT_EQ(cursor.segment, 1);
+
+        // Nothing was trimmed
+        EXPECT_EQ(motion_points.front().header.stamp, t0);
+
+        // Any hint finds the same motion point and segment
+        for(size_t i = 0; i < times.size(); i++)
+        {
+            const size_t index = motion_points.lowerBound(times[i]);
+            TrajectorySample expected;
+            const bool in_trajectory = trajectory->sample(times[i].toNSec(), expected);
+            for(size_t hint = 0; hint < motion_points.size() + 3; hint++)
+            {
+                ASSERT_EQ(motion_points.lowerBound(times[i], hint), index);
+
+                TrajectorySample sample;
+                size_t segment = hint;
+                ASSERT_EQ(trajectory->sample(times[i].toNSec(), sample, segment), in_trajectory);
+                if(in_trajectory)
+                {
+                    EXPECT_EQ(segment, times[i] < t0 + ros::Duration(1.0) ? 0 : 1);
+                    EXPECT_EQ(sample.values[TrajectorySample::kPositionX],
+                              expected.values[TrajectorySample::kPositionX]);
+                }
+            }
+        }
+
+        // Times out of order are rejected, the ones before are filled in
+        std::swap(times[5], times[6]);
+        EXPECT_FALSE(Planner::peekTargets(motion_points, polynomial_targets, plan_splice,
+                                          times, InterpolationMode::CUBIC, cursor, targets));
+        EXPECT_EQ(targets.size(), 6);
+    }
+    TEST(MotionPointInterpolatorTests, testRandomPlans)
+    {
+        typedef Iarc7Motion::MotionPointInterpolator Planner;
+
+        ros::Time::init();
+        const ros::Time start_time(ros::Time::now());
+
+        // Plans overlapping each other and the current time by random
+        // amounts, some with duplicate or out of order stamps, are checked
+        // against appending and trimming a plain std::vector. A small queue
+        // makes it overflow now and then.
+        for(uint32_t seed = 0; seed < 20; seed++)
+        {
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+            Iarc7Motion::PlanHandoff pending_plans;
+            Iarc7Motion::MotionPointQueue motion_points(32);
+            Iarc7Motion::PolynomialTargets polynomial_targets;
+            Iarc7Motion::PlanSplice plan_splice;
+            Iarc7Motion::TargetCursor cursor;
+            const VelocityProfileGenerator profile_generator((VelocityProfileSettings()));
+
+            MotionPointStampedArray first_point(1);
+            first_point[0].header.stamp = start_time;
+            ASSERT_TRUE(motion_points.push_back(makePlan(first_point), 0, 1));
+            MotionPointStampedArray reference = first_point;
+
+            ros::Time time = start_time;
+            for(int32_t step = 0; step < 2000; step++)
+            {
+                time += ros::Duration(0.05 * uniform(generator));
+
+                if(uniform(generator) < 0.3)
+                {
+                    // Up to 20 points spaced up to 0.1 seconds apart,
+                    // starting from half a second ago to a second from now
+                    const int32_t num_points = 1 + static_cast<int32_t>(20 * uniform(generator));
+                    MotionPointStampedArray new_motion_points(num_points);
+                    ros::Time stamp = time + ros::Duration(1.5 * uniform(generator) - 0.5);
+                    for(int32_t i = 0; i < num_points; i++)
+                    {
+                        new_motion_points[i].header.stamp = stamp;
+                        new_motion_points[i].motion_point.pose.position.x = uniform(generator);
+                        stamp += ros::Duration(0.001 + 0.1 * uniform(generator));
+                    }
+
+                    bool valid = true;
+                    const double corruption = uniform(generator);
+                    if(num_points > 1 && corruption < 0.1)
+                    {
+                        new_motion_points[1].header.stamp = new_motion_points[0].header.stamp;
+                        valid = false;
+                    }
+                    else if(num_points > 1 && corruption < 0.2)
+                    {
+                        std::swap(new_motion_points[0].header.stamp,
+                                  new_motion_points[num_points - 1].header.stamp);
+                        valid = false;
+                    }
+
+                    // Invalid plans are rejected before they are queued
+                    const MotionPointQueue::PlanConstPtr plan = makePlan(new_motion_points);
+                    ASSERT_EQ(Planner::handOffMotionPointArray(pending_plans, plan, time), valid);
+                    // Only fails when the queue is full
+                    const bool appended = Planner::applyPendingPlans(
+                            pending_plans, time, motion_points, polynomial_targets,
+                            plan_splice, profile_generator, InterpolationMode::LINEAR);
+                    ASSERT_TRUE(appended
+                                || motion_points.size() == motion_points.capacity());
+
+                    if(valid)
+                    {
+                        // Same as appendMotionPointQueue, keeping the point
+                        // before time and replacing the targets after it
+                        auto stampLess = [](const MotionPointStamped& motion_point,
+                                            const ros::Time& time) {
+                            return motion_point.header.stamp < time;
+                        };
+                        auto first = std::lower_bound(new_motion_points.begin(),
+                                                      new_motion_points.end(),
+                                                      time,
+                                                      stampLess);
+                        if(first != new_motion_points.begin())
+                        {
+                            first--;
+                        }
+                        reference.erase(std::lower_bound(reference.begin(),
+                                                         reference.end(),
+                                                         first->header.stamp,
+                                                         stampLess),
+                                        reference.end());
+
+                        // An overflowing plan is cut off at the queue's
+                        // capacity after the targets it replaces are
+                        // dropped
+                        const size_t room = motion_points.capacity() - reference.size();
+                        const size_t kept = std::min<size_t>(room, new_motion_points.end() - first);
+                        reference.insert(reference.end(), first, first + kept);
+                    }
+                }
+
+                TrajectorySample target;
+                const bool sampled = Planner::sampleTargets(motion_points,
+                                                            polynomial_targets,
+                                                            plan_splice,
+                                                            time,
+                                                            InterpolationMode::LINEAR,
+                                                            cursor,
+                                                            target);
+
+                // Same as trimMotionPointQueue
+                auto next = std::lower_bound(
+                        reference.begin(),
+                        reference.end(),
+                        time,
+                        [](const MotionPointStamped& motion_point, const ros::Time& time) {
+                            return motion_point.header.stamp < time;
+                        });
+                if(reference.front().header.stamp < time)
+                {
+                    reference.erase(reference.begin(), std::prev(next));
+                    next = reference.begin() + 1;
+                }
+
+                // The queue is sorted, bounded and holds the same targets
+                ASSERT_EQ(motion_points.size(), reference.size());
+                ASSERT_LE(motion_points.size(), motion_points.capacity());
+                for(size_t i = 0; i < reference.size(); i++)
+                {
+                    ASSERT_EQ(motion_points[i].header.stamp, reference[i].header.stamp);
+                    ASSERT_EQ(motion_points[i].motion_point.pose.position.x,
+                              reference[i].motion_point.pose.position.x);
+                    if(i > 0)
+                    {
+                        ASSERT_LT(motion_points[i - 1].header.stamp,
+                                  motion_points[i].header.stamp);
+                    }
+                }
+
+                // There is a target whenever the queue starts at or before
+                // time, and it is between the targets either side of it
+                ASSERT_EQ(sampled, !(time < reference.front().header.stamp));
+                if(sampled && next != reference.end() && next != reference.begin())
+                {
+                    const double x0 = std::prev(next)->motion_point.pose.position.x;
+                    const double x1 = next->motion_point.pose.position.x;
+                    ASSERT_GE(target.values[TrajectorySample::kPositionX],
+                              std::min(x0, x1) - 1e-12);
+                    ASSERT_LE(target.values[TrajectorySample::kPositionX],
+                              std::max(x0, x1) + 1e-12);
+                }
+            }
+        }
     }
 }
 
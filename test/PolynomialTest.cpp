@@ -0,0 +1,98 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/Polynomial.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+
+namespace Iarc7Motion
+{
+    // Same coefficients as param/thrust_models/thrust_model_1.9.yaml
+    const double kThrustToVoltage[] = {5.8088274948944845,
+                                       -12.279167938928392,
+                                       17.316436473713267,
+                                       1.1308578342038291};
+
+    // Sum of powers, the form ThrustModel used before Horner's scheme
+    double powerSum(const double* coefficients, int size, double x)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < size; i++) {
+            sum += coefficients[i] * std::pow(x, size - 1 - i);
+        }
+        return sum;
+    }
+
+    TEST(PolynomialTests, testMatchesPowerSum)
+    {
+        Polynomial polynomial;
+        ASSERT_TRUE(polynomial.setCoefficients(kThrustToVoltage, 4));
+        EXPECT_EQ(polynomial.size(), 4);
+
+        for (double x = -1.0; x <= 2.0; x += 0.001) {
+            EXPECT_NEAR(polynomial(x), powerSum(kThrustToVoltage, 4, x), 1e-12);
+        }
+    }
+
+    TEST(PolynomialTests, testConstantAndLinear)
+    {
+        const double constant[] = {3.5};
+        const double linear[] = {2.0, -1.0};
+
+        Polynomial polynomial;
+        ASSERT_TRUE(polynomial.setCoefficients(constant, 1));
+        EXPECT_EQ(polynomial(0.0), 3.5);
+        EXPECT_EQ(polynomial(100.0), 3.5);
+
+        ASSERT_TRUE(polynomial.setCoefficients(linear, 2));
+        EXPECT_EQ(polynomial(0.0), -1.0);
+        EXPECT_EQ(polynomial(2.0), 3.0);
+    }
+
+    TEST(PolynomialTests, testRejectsBadSizes)
+    {
+        double coefficients[Polynomial::kMaxCoefficients + 1] = {1.0};
+
+        Polynomial polynomial;
+        ASSERT_TRUE(polynomial.setCoefficients(kThrustToVoltage, 4));
+        EXPECT_FALSE(polynomial.setCoefficients(coefficients, 0));
+        EXPECT_FALSE(polynomial.setCoefficients(coefficients,
+                                                Polynomial::kMaxCoefficients + 1));
+
+        // A rejected update leaves the polynomial as it was
+        EXPECT_EQ(polynomial.size(), 4);
+        EXPECT_NEAR(polynomial(0.5), powerSum(kThrustToVoltage, 4, 0.5), 1e-12);
+
+        EXPECT_TRUE(polynomial.setCoefficients(coefficients,
+                                               Polynomial::kMaxCoefficients));
+    }
+
+    TEST(PolynomialTests, testBatchMatchesScalar)
+    {
+        Polynomial polynomial;
+        ASSERT_TRUE(polynomial.setCoefficients(kThrustToVoltage, 4));
+
+        // Not a multiple of the lane count, so the last points are
+        // evaluated one at a time
+        const int num_points = 1001;
+        std::vector<double> xs(num_points);
+        std::vector<double> results(num_points);
+        for (int i = 0; i < num_points; i++) {
+            xs[i] = -0.5 + 0.002 * i;
+        }
+
+        polynomial.evaluate(xs.data(), results.data(), num_points);
+        for (int i = 0; i < num_points; i++) {
+            EXPECT_EQ(results[i], polynomial(xs[i])) << "at " << xs[i];
+        }
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,143 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/QuadVelocityController.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
+#include "iarc7_motion/ThrustModel.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include "AllocationCounter.hpp"
+
+#include <cmath>
+#include <string>
+
+#include <ros/ros.h>
+
+#include "iarc7_msgs/MotionPointStamped.h"
+#include "iarc7_msgs/OrientationThrottleStamped.h"
+
+namespace Iarc7Motion
+{
+    // Gains only need to keep the command finite, allocations don't depend
+    // on them
+    double throttle_pid[6] = {5.0, 0.5, 0.5, 0.5, -0.5, 10.0};
+    double pitch_pid[6] = {3.0, 0.3, 0.3, 0.5, -0.5, 10.0};
+    double roll_pid[6] = {3.0, 0.3, 0.3, 0.5, -0.5, 10.0};
+    double position_p[3] = {1.0, 1.0, 5.0};
+    const double yaw_p = 0.4;
+
+    // Hovering 1 m up, high enough for the xy loops to run
+    StateSnapshot makeState(const ros::Time& stamp, double t)
+    {
+        StateSnapshot state;
+        state.stamp = stamp;
+        state.odometry << 0.1 * std::sin(t), 0.1 * std::cos(t), 0.0,
+                          0.0,               0.0,               1.0;
+        state.accel.setValue(0.0, 0.0, 0.05 * std::sin(t));
+        state.battery_voltage = 16.0;
+        state.level_quad_to_quad.rotation.w = 1.0;
+        state.map_to_center_of_lift.translation.z = 1.1;
+        state.map_to_center_of_lift.rotation.w = 1.0;
+        state.map_to_level_quad.translation.z = 1.0;
+        state.map_to_level_quad.rotation.w = 1.0;
+        return state;
+    }
+
+    // Runs a controller with the given mixer at 100 Hz and checks that
+    // no update after the first allocates
+    void expectUpdateDoesNotAllocate(const std::string& xy_mixer)
+    {
+        ros::NodeHandle private_nh("~");
+        private_nh.setParam("xy_mixer", xy_mixer);
+
+        VerticalThrustModel thrust_model(private_nh, "thrust_model");
+        ThrustModel thrust_model_side;
+        if (xy_mixer == "6dof") {
+            thrust_model_side.loadModel(private_nh, "thrust_model_side");
+        }
+
+        QuadVelocityController controller(throttle_pid,
+                                          pitch_pid,
+                                          roll_pid,
+                                          position_p,
+                                          yaw_p,
+                                          thrust_model,
+                                          thrust_model_side,
+                                          private_nh);
+
+        iarc7_msgs::MotionPointStamped setpoint;
+        setpoint.motion_point.pose.position.z = 1.0;
+        setpoint.motion_point.twist.linear.x = 0.5;
+        controller.setTargetVelocity(setpoint);
+
+        const ros::Time start(100.0);
+        iarc7_msgs::OrientationThrottleStamped uav_command;
+
+        // Warm up anything set up on first use, the first update also
+        // initializes the PID loops
+        for (int i = 1; i <= 2; i++) {
+            const double t = 0.01 * i;
+            ASSERT_TRUE(controller.update(makeState(start + ros::Duration(t), t),
+                                          uav_command));
+        }
+
+        AllocationCounter allocations;
+        double sum = 0.0;
+        for (int i = 3; i < 200; i++) {
+            const double t = 0.01 * i;
+            ASSERT_TRUE(controller.update(makeState(start + ros::Duration(t), t),
+                                          uav_command));
+            sum += uav_command.throttle
+                 + uav_command.data.pitch
+                 + uav_command.data.roll
+                 + uav_command.planar.front_throttle;
+        }
+        EXPECT_EQ(allocations.count(), 0u);
+        EXPECT_TRUE(std::isfinite(sum));
+    }
+
+    TEST(QuadVelocityControllerTests, testGetThrustModelReturnsPendingModel)
+    {
+        ros::NodeHandle private_nh("~");
+        private_nh.setParam("xy_mixer", std::string("4dof"));
+
+        VerticalThrustModel thrust_model(private_nh, "thrust_model");
+        ThrustModel thrust_model_side;
+        QuadVelocityController controller(throttle_pid,
+                                          pitch_pid,
+                                          roll_pid,
+                                          position_p,
+                                          yaw_p,
+                                          thrust_model,
+                                          thrust_model_side,
+                                          private_nh);
+
+        // Adaptation is disabled in these params, so the correction set
+        // here identifies the model
+        VerticalThrustModel corrected_model = thrust_model;
+        corrected_model.setVoltageCorrection(1.5, 0.25);
+
+        // Not updated since, so the model is still pending
+        controller.setThrustModel(corrected_model);
+        VerticalThrustModel returned_model = controller.getThrustModel();
+        EXPECT_EQ(returned_model.getVoltageScale(), 1.5);
+        EXPECT_EQ(returned_model.getVoltageOffset(), 0.25);
+    }
+
+    TEST(QuadVelocityControllerTests, test4dofUpdateDoesNotAllocate)
+    {
+        expectUpdateDoesNotAllocate("4dof");
+    }
+
+    TEST(QuadVelocityControllerTests, test6dofUpdateDoesNotAllocate)
+    {
+        expectUpdateDoesNotAllocate("6dof");
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "quad_velocity_controller_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/StateInterpolator.hpp"
+#include "iarc7_motion/StateSnapshot.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include "AllocationCounter.hpp"
+
+#include <cmath>
+#include <string>
+
+#include <ros/ros.h>
+#include "tf2_ros/buffer.h"
+#include "tf2_ros/transform_listener.h"
+
+#include "geometry_msgs/AccelWithCovarianceStamped.h"
+#include "geometry_msgs/TransformStamped.h"
+#include "iarc7_msgs/Float64Stamped.h"
+#include "nav_msgs/Odometry.h"
+#include "tf2_msgs/TFMessage.h"
+
+namespace Iarc7Motion
+{
+    // Number of each estimate published, 10 ms apart
+    const int kNumMessages = 50;
+    const double kMessagePeriod = 0.01;
+
+    nav_msgs::Odometry makeOdometry(double t)
+    {
+        nav_msgs::Odometry msg;
+        msg.header.frame_id = "map";
+        msg.child_frame_id = "level_quad";
+        msg.twist.twist.linear.x = 1.0 * t;
+        msg.twist.twist.linear.y = 2.0 * t;
+        msg.twist.twist.linear.z = 3.0 * t;
+        msg.pose.pose.position.x = 4.0 * t;
+        msg.pose.pose.position.y = 5.0 * t;
+        msg.pose.pose.position.z = 6.0 * t;
+        return msg;
+    }
+
+    geometry_msgs::TransformStamped makeTransform(const ros::Time& stamp,
+                                                  const std::string& parent,
+                                                  const std::string& child,
+                                                  double z)
+    {
+        geometry_msgs::TransformStamped transform;
+        transform.header.stamp = stamp;
+        transform.header.frame_id = parent;
+        transform.child_frame_id = child;
+        transform.transform.translation.z = z;
+        transform.transform.rotation.w = 1.0;
+        return transform;
+    }
+
+    // Waits up to a few seconds for publisher to be connected
+    bool waitForSubscriber(const ros::Publisher& publisher)
+    {
+        const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+        while (ros::ok() && publisher.getNumSubscribers() == 0) {
+            if (ros::WallTime::now() > deadline) {
+                return false;
+            }
+            ros::WallDuration(0.01).sleep();
+        }
+        return true;
+    }
+
+    TEST(StateInterpolatorTests, testOdometryFromMessage)
+    {
+        const OdometryVector odometry = odometryFromMessage(makeOdometry(1.0));
+        for (int i = 0; i < 6; i++) {
+            EXPECT_EQ(odometry[i], i + 1.0);
+        }
+    }
+
+    TEST(StateInterpolatorTests, testSnapshotDoesNotAllocate)
+    {
+        ros::NodeHandle nh;
+        ros::NodeHandle private_nh("~");
+
+        ros::Publisher odometry_publisher
+            = nh.advertise<nav_msgs::Odometry>("odometry/filtered", kNumMessages);
+        ros::Publisher accel_publisher
+            = nh.advertise<geometry_msgs::AccelWithCovarianceStamped>("accel/filtered",
+                                                                      kNumMessages);
+        ros::Publisher battery_publisher
+            = nh.advertise<iarc7_msgs::Float64Stamped>("motor_battery", kNumMessages);
+        ros::Publisher tf_publisher
+            = nh.advertise<tf2_msgs::TFMessage>("/tf", kNumMessages);
+
+        ros::AsyncSpinner spinner(1);
+        spinner.start();
+
+        StateInterpolator state_interpolator(nh, private_nh);
+        ASSERT_TRUE(waitForSubscriber(odometry_publisher));
+        ASSERT_TRUE(waitForSubscriber(accel_publisher));
+        ASSERT_TRUE(waitForSubscriber(battery_publisher));
+        ASSERT_TRUE(waitForSubscriber(tf_publisher));
+
+        // The quad climbing at 1 m/s, every estimate and transform at the
+        // same stamps
+        const ros::Time start = ros::Time::now();
+        ros::Time last_stamp;
+        for (int i = 0; i < kNumMessages; i++) {
+            const double t = kMessagePeriod * i;
+            last_stamp = start + ros::Duration(t);
+
+            nav_msgs::Odometry odometry = makeOdometry(t);
+            odometry.header.stamp = last_stamp;
+            odometry_publisher.publish(odometry);
+
+            geometry_msgs::AccelWithCovarianceStamped accel;
+            accel.header.stamp = last_stamp;
+            accel.accel.accel.linear.z = 1.0;
+            accel_publisher.publish(accel);
+
+            iarc7_msgs::Float64Stamped battery;
+            battery.header.stamp = last_stamp;
+            battery.data = 16.0 - t;
+            battery_publisher.publish(battery);
+
+            tf2_msgs::TFMessage tf;
+            tf.transforms.push_back(makeTransform(last_stamp, "map", "level_quad", t));
+            tf.transforms.push_back(makeTransform(last_stamp, "level_quad", "quad", 0.0));
+            tf.transforms.push_back(makeTransform(last_stamp, "quad", "center_of_lift", 0.1));
+            tf_publisher.publish(tf);
+        }
+
+        ASSERT_TRUE(state_interpolator.waitUntilReady());
+
+        // Wait for everything published to arrive
+        tf2_ros::Buffer tf_buffer;
+        tf2_ros::TransformListener tf_listener(tf_buffer);
+        ASSERT_TRUE(tf_buffer.canTransform("map", "center_of_lift", last_stamp, ros::Duration(5.0)));
+        const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+        while (state_interpolator.getLastUpdateTime() < last_stamp) {
+            ASSERT_LT(ros::WallTime::now(), deadline);
+            ros::WallDuration(0.01).sleep();
+        }
+        ros::WallDuration(0.1).sleep();
+
+        // Control ticks every 3.5 ms between the published stamps, after
+        // one to warm up anything set up on first use
+        StateSnapshot state;
+        ros::Time time = start + ros::Duration(0.05);
+        ASSERT_TRUE(state_interpolator.getSnapshot(time, state));
+
+        AllocationCounter allocations;
+        double sum = 0.0;
+        for (int i = 0; i < 100; i++) {
+            time += ros::Duration(0.0035);
+            ASSERT_TRUE(state_interpolator.getSnapshot(time, state));
+            sum += state.odometry.sum()
+                 + state.accel.z()
+                 + state.battery_voltage
+                 + state.map_to_center_of_lift.translation.z;
+        }
+        EXPECT_EQ(allocations.count(), 0u);
+        EXPECT_TRUE(std::isfinite(sum));
+
+        // The snapshot holds the state at the last tick
+        const double t = (time - start).toSec();
+        EXPECT_NEAR(state.odometry[5], 6.0 * t, 1e-6);
+        EXPECT_NEAR(state.accel.z(), 1.0, 1e-9);
+        EXPECT_NEAR(state.battery_voltage, 16.0 - t, 1e-6);
+        EXPECT_NEAR(state.map_to_level_quad.translation.z, t, 1e-6);
+        EXPECT_NEAR(state.map_to_center_of_lift.translation.z, t + 0.1, 1e-6);
+
+        spinner.stop();
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "state_interpolator_test");
+  return RUN_ALL_TESTS();
+}
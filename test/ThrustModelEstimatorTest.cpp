@@ -0,0 +1,170 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/ThrustModelEstimator.hpp"
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/StaticThrustModel.hpp"
+
+// Generated at configure time from param/thrust_models/thrust_model_1.9.yaml
+#include "iarc7_motion/TestThrustModelData.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+namespace Iarc7Motion
+{
+    const double kTestModelMass = 2.85;
+    const double kTickTime = 1.0 / 60.0;
+
+    // Motors that need more voltage than the model says, as with worn
+    // props or a sagging battery
+    const double kTrueScale = 1.08;
+    const double kTrueOffset = 0.3;
+
+    TEST(ThrustModelEstimatorTests, testConvergesToScaleAndOffset)
+    {
+        ThrustModelEstimator estimator((ThrustModelEstimatorSettings()));
+
+        for (int i = 0; i < 60 * 120; i++) {
+            double model_voltage = 10.0 + 2.0 * std::sin(0.05 * i)
+                                        + 0.5 * std::sin(0.31 * i);
+            double applied_voltage = kTrueScale * model_voltage + kTrueOffset;
+            ASSERT_TRUE(estimator.update(kTickTime, model_voltage, applied_voltage));
+        }
+
+        EXPECT_NEAR(estimator.getScale(), kTrueScale, 1e-3);
+        EXPECT_NEAR(estimator.getOffset(), kTrueOffset, 1e-2);
+    }
+
+    TEST(ThrustModelEstimatorTests, testCorrectionIsBounded)
+    {
+        ThrustModelEstimatorSettings settings;
+        ThrustModelEstimator estimator(settings);
+
+        for (int i = 0; i < 60 * 60; i++) {
+            double model_voltage = 10.0 + 2.0 * std::sin(0.05 * i);
+            ASSERT_TRUE(estimator.update(kTickTime, model_voltage, 3.0 * model_voltage + 5.0));
+        }
+
+        EXPECT_LE(estimator.getScale(), 1.0 + settings.max_scale_error);
+        EXPECT_LE(estimator.getOffset(), settings.max_offset);
+    }
+
+    TEST(ThrustModelEstimatorTests, testRejectsBadSamples)
+    {
+        ThrustModelEstimator estimator((ThrustModelEstimatorSettings()));
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+
+        EXPECT_FALSE(estimator.update(0.0, 10.0, 11.0));
+        EXPECT_FALSE(estimator.update(-kTickTime, 10.0, 11.0));
+        EXPECT_FALSE(estimator.update(kTickTime, nan, 11.0));
+        EXPECT_FALSE(estimator.update(kTickTime, 10.0, nan));
+
+        EXPECT_EQ(estimator.getScale(), 1.0);
+        EXPECT_EQ(estimator.getOffset(), 0.0);
+    }
+
+    TEST(ThrustModelEstimatorTests, testVoltageCorrection)
+    {
+        ThrustModel model;
+        model.loadModel(StaticThrustModel<TestThrustModelData>::getContents(),
+                        kTestModelMass);
+        StaticThrustModel<TestThrustModelData> compiled_model;
+        compiled_model.loadModel(kTestModelMass);
+
+        ThrustModel uncorrected_model = model;
+
+        const double hover_thrust = model.thrustForAcceleration(9.8, 4);
+        const double hover_voltage = model.get_voltage_for_thrust(hover_thrust);
+        const double step_voltage = uncorrected_model.voltageFromThrust(9.8, 4, 0.0);
+
+        model.setVoltageCorrection(kTrueScale, kTrueOffset);
+        compiled_model.setVoltageCorrection(kTrueScale, kTrueOffset);
+
+        // Steady state
+        EXPECT_NEAR(model.get_voltage_for_thrust(hover_thrust),
+                    kTrueScale * hover_voltage + kTrueOffset,
+                    1e-12);
+
+        // Step from zero thrust, then holding the thrust
+        EXPECT_NEAR(model.voltageFromThrust(9.8, 4, 0.0),
+                    kTrueScale * step_voltage + kTrueOffset,
+                    1e-12);
+        EXPECT_NEAR(compiled_model.voltageFromThrust(9.8, 4, 0.0),
+                    kTrueScale * step_voltage + kTrueOffset,
+                    1e-9);
+        EXPECT_NEAR(model.voltageFromThrust(9.8, 4, 0.0),
+                    kTrueScale * hover_voltage + kTrueOffset,
+                    1e-12);
+        EXPECT_NEAR(compiled_model.voltageFromThrust(9.8, 4, 0.0),
+                    kTrueScale * hover_voltage + kTrueOffset,
+                    1e-9);
+
+        // Copies carry the correction
+        ThrustModel copy = model;
+        EXPECT_EQ(copy.getVoltageScale(), kTrueScale);
+        EXPECT_EQ(copy.getVoltageOffset(), kTrueOffset);
+
+        // The motors stay off when the model turns them off
+        EXPECT_EQ(model.voltageFromThrust(0.0, 4, 0.0), 0.0);
+        EXPECT_EQ(compiled_model.voltageFromThrust(0.0, 4, 0.0), 0.0);
+    }
+
+    // Hovers a simulated quad whose motors don't match the model, the way
+    // QuadVelocityController feeds the estimator, and checks the corrected
+    // model commands the voltage the motors actually need
+    TEST(ThrustModelEstimatorTests, testLearnsHoverVoltage)
+    {
+        ThrustModel model;
+        model.loadModel(StaticThrustModel<TestThrustModelData>::getContents(),
+                        kTestModelMass);
+        const ThrustModel uncorrected_model = model;
+        ThrustModelEstimator estimator((ThrustModelEstimatorSettings()));
+
+        // Thrust the real motors produce at a voltage, found by inverting
+        // the mismatched motors on the model's steady state curve
+        auto true_accel = [&](double voltage) {
+            double model_voltage = (voltage - kTrueOffset) / kTrueScale;
+            double low = 0.0;
+            double high = 2.0;
+            for (int i = 0; i < 60; i++) {
+                double mid = 0.5 * (low + high);
+                if (uncorrected_model.get_voltage_for_thrust(mid) < model_voltage) {
+                    low = mid;
+                } else {
+                    high = mid;
+                }
+            }
+            return low / model.thrustForAcceleration(1.0, 4);
+        };
+
+        // Small altitude corrections around hover
+        for (int i = 0; i < 60 * 60; i++) {
+            double commanded_accel = 9.8 + 0.4 * std::sin(0.2 * i);
+            double commanded_voltage = model.get_voltage_for_thrust(
+                    model.thrustForAcceleration(commanded_accel, 4));
+
+            double measured_accel = true_accel(commanded_voltage);
+            double model_voltage = (model.get_voltage_for_thrust(
+                                        model.thrustForAcceleration(measured_accel, 4))
+                                    - model.getVoltageOffset())
+                                 / model.getVoltageScale();
+
+            ASSERT_TRUE(estimator.update(kTickTime, model_voltage, commanded_voltage));
+            model.setVoltageCorrection(estimator.getScale(), estimator.getOffset());
+        }
+
+        const double hover_thrust = model.thrustForAcceleration(9.8, 4);
+        const double needed_voltage = kTrueScale * uncorrected_model.get_voltage_for_thrust(hover_thrust)
+                                    + kTrueOffset;
+        EXPECT_NEAR(model.get_voltage_for_thrust(hover_thrust), needed_voltage, 0.02);
+        EXPECT_NEAR(true_accel(model.get_voltage_for_thrust(hover_thrust)), 9.8, 0.05);
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,99 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/ThrustModelReplay.hpp"
+#include "iarc7_motion/ThrustModelYaml.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Iarc7Motion
+{
+    // Thrust stand log and the model fit to it, IARC7_MOTION_SOURCE_DIR is
+    // set in CMakeLists.txt
+    const std::string kDynamicDir = std::string(IARC7_MOTION_SOURCE_DIR)
+                                  + "/scripts/thrust_model_v2/Dynamic/";
+    const std::string kModelPath = kDynamicDir
+        + "DynamicModelData/EmaxDynamic/6x4.5x2_dynamic_prop_back_r1.txt.output.yaml";
+    const std::string kLogPath = kDynamicDir
+        + "EmaxFullTest/dynamic_6x4.5x2_prop_back_r1.txt";
+
+    TEST(ThrustModelReplayTests, testLoadLogSkipsBadLinesAndRepeats)
+    {
+        const std::string path = "thrust_model_replay_test.txt";
+        {
+            std::ofstream file(path);
+            file << "ignored before START\n"
+                 << "START\n"
+                 << "0.100, 1000000, 0, 0, 12.0, 0, 0, 10, 1000000, 0, 0, 0, 0\n"
+                 << "0.100, 1000000, 0, 0, 12.0, 0, 0, 20, 1010000, 0, 0, 0, 0\n"
+                 << "RESPONSE START\n"
+                 << "0.5\n"
+                 << "0.200, 1020000, 0, 0, 12.0, 0, 0, 20\n"
+                 << "0.300, 1030000, 0, 0, 12.0, 0, 0, 20, 1020000\n"
+                 << "STOP\n"
+                 << "START\n"
+                 << "0.400, 2000000, 0, 0, 11.0, 0, 0, 30, 2000000\n"
+                 << "STOP\n"
+                 << "START\n"
+                 << "0.500, 3000000, 0, 0, 11.0, 0, 0, 30, 3000000\n"
+                 << "0.600, 3010000, 0, 0, 11.0, 0, 0, 30, 3000000\n"
+                 << "STOP\n";
+        }
+
+        std::vector<ThrustModelReplay::Segment> segments;
+        ASSERT_TRUE(ThrustModelReplay::loadLog(path, segments));
+        std::remove(path.c_str());
+
+        // The one sample segment is dropped, nothing can be predicted from it
+        ASSERT_EQ(segments.size(), 2);
+
+        ASSERT_EQ(segments[0].size(), 2);
+        EXPECT_DOUBLE_EQ(segments[0][0].time, 1.0);
+        EXPECT_DOUBLE_EQ(segments[0][0].throttle, 10.0);
+        EXPECT_DOUBLE_EQ(segments[0][1].thrust, 0.3);
+        EXPECT_DOUBLE_EQ(segments[0][1].battery_voltage, 12.0);
+        EXPECT_DOUBLE_EQ(segments[0][1].throttle_time, 1.02);
+
+        ASSERT_EQ(segments[1].size(), 2);
+        EXPECT_DOUBLE_EQ(segments[1][1].time, 3.01);
+
+        EXPECT_FALSE(ThrustModelReplay::loadLog(path, segments));
+    }
+
+    // Regression bounds on the model's error against its own thrust stand
+    // log, a bit above what thrust_model_accuracy reports for it
+    TEST(ThrustModelReplayTests, testRecordedStepResponseAccuracy)
+    {
+        ThrustModelYaml::Model yaml_model;
+        ASSERT_TRUE(ThrustModelYaml::load(kModelPath, yaml_model));
+
+        ThrustModel model;
+        model.loadModel(yaml_model.contents(), 1.0);
+
+        std::vector<ThrustModelReplay::Segment> segments;
+        ASSERT_TRUE(ThrustModelReplay::loadLog(kLogPath, segments));
+
+        ThrustModelReplay::Result result = ThrustModelReplay::replay(model, segments);
+
+        EXPECT_GT(result.dynamic_thrust.samples, 4000);
+        EXPECT_LT(result.dynamic_thrust.rms, 0.045);
+        EXPECT_LT(std::abs(result.dynamic_thrust.mean), 0.01);
+        EXPECT_LT(result.dynamic_thrust.p95, 0.085);
+
+        EXPECT_GT(result.steady_voltage.samples, 1500);
+        EXPECT_LT(result.steady_voltage.rms, 0.21);
+        EXPECT_LT(result.steady_voltage.p95, 0.31);
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,645 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/ThrustModel.hpp"
+#include "iarc7_motion/StaticThrustModel.hpp"
+
+// Generated at configure time from param/thrust_models/thrust_model_1.9.yaml
+#include "iarc7_motion/TestThrustModelData.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include "AllocationCounter.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+
+namespace Iarc7Motion
+{
+    // Unique file in /tmp for a test to write to, so tests running at the
+    // same time don't collide. Removed when this goes out of scope.
+    class TempFile
+    {
+    public:
+        TempFile() : path_("/tmp/iarc7_motion_thrust_model_XXXXXX")
+        {
+            const int fd = mkstemp(&path_[0]);
+            if (fd >= 0) {
+                ::close(fd);
+            } else {
+                path_.clear();
+            }
+        }
+
+        ~TempFile()
+        {
+            if (!path_.empty()) {
+                std::remove(path_.c_str());
+            }
+        }
+
+        TempFile(const TempFile& rhs) = delete;
+        TempFile& operator=(const TempFile& rhs) = delete;
+
+        // Empty if the file couldn't be created
+        const std::string& path() const
+        {
+            return path_;
+        }
+
+    private:
+        std::string path_;
+    };
+
+    // Builds a thrust model parameter tree shaped like
+    // param/thrust_models/*.yaml, where the thrust reached after one
+    // response period decays toward a quadratic static thrust curve
+    XmlRpc::XmlRpcValue makeModelParams()
+    {
+        const int num_thrust_points = 10;
+        const int num_voltage_points = 10;
+        const double thrust_max = 2.5;
+        const double voltage_max = 12.6;
+
+        XmlRpc::XmlRpcValue model;
+        model["response_lag"] = 0.02;
+        model["small_thrust_epsilon"] = 0.01;
+        model["thrust_to_voltage"][0] = -0.5;
+        model["thrust_to_voltage"][1] = 2.0;
+        model["thrust_to_voltage"][2] = 5.0;
+        model["thrust_to_voltage"][3] = 0.5;
+
+        XmlRpc::XmlRpcValue& voltage_to_jerk = model["voltage_to_jerk"];
+        voltage_to_jerk["thrust_min"] = 0;
+        voltage_to_jerk["thrust_max"] = thrust_max;
+        voltage_to_jerk["voltage_min"] = 0;
+        voltage_to_jerk["voltage_max"] = voltage_max;
+
+        for (int i = 0; i < num_thrust_points; i++) {
+            double start_thrust = i * thrust_max / (num_thrust_points - 1);
+            voltage_to_jerk["mapping"][i][0] = start_thrust;
+            for (int j = 0; j < num_voltage_points; j++) {
+                double voltage = j * voltage_max / (num_voltage_points - 1);
+                double static_thrust = 0.016 * voltage * voltage;
+                voltage_to_jerk["mapping"][i][1][j][0] = voltage;
+                voltage_to_jerk["mapping"][i][1][j][1] =
+                    0.5 * start_thrust + 0.5 * static_thrust;
+            }
+        }
+
+        return model;
+    }
+
+    TEST(ThrustModelTests, testLookupTableMatchesScan)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+        ThrustModel thrust_model;
+        thrust_model.loadModel(params, 2.9);
+        thrust_model.buildLookupTable(64, 256);
+
+        double max_error;
+        double max_error_start;
+        double max_error_desired;
+        thrust_model.checkLookupTable(max_error,
+                                      max_error_start,
+                                      max_error_desired);
+        EXPECT_LT(max_error, 0.05) << "at start thrust " << max_error_start
+                                   << " desired thrust " << max_error_desired;
+    }
+
+    TEST(ThrustModelTests, testVoltageFromThrustDoesNotAllocate)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+
+        ThrustModel scan_model;
+        scan_model.loadModel(params, 2.9);
+
+        ThrustModel table_model = scan_model;
+        table_model.buildLookupTable(64, 256);
+
+        // Alternate between small and large steps so both the static
+        // and dynamic branches are taken
+        const double accelerations[] = {9.8, 9.81, 12.0, 4.0, 0.0, 30.0, 9.8};
+
+        AllocationCounter allocations;
+        for (int i = 0; i < 1000; i++) {
+            for (double acceleration : accelerations) {
+                double scan_voltage = scan_model.voltageFromThrust(
+                        acceleration, 4, 0.0);
+                double table_voltage = table_model.voltageFromThrust(
+                        acceleration, 4, 0.0);
+                ASSERT_TRUE(std::isfinite(scan_voltage));
+                ASSERT_TRUE(std::isfinite(table_voltage));
+            }
+        }
+        EXPECT_EQ(allocations.count(), 0u);
+    }
+
+    TEST(ThrustModelTests, testMixerThrustModelsDoNotAllocate)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+
+        ThrustModel thrust_model;
+        thrust_model.loadModel(params, 2.9);
+        thrust_model.buildLookupTable(64, 256);
+
+        // Same calls QuadVelocityController::update makes per tick in
+        // 6dof mode
+        ThrustModel thrust_model_side(thrust_model);
+        double side_start_thrusts[4] = {};
+
+        AllocationCounter allocations;
+        double throttle_sum = 0.0;
+        for (int i = 0; i < 1000; i++) {
+            double x_accel = 2.0 * std::sin(0.01 * i);
+            double y_accel = 2.0 * std::cos(0.01 * i);
+            double z_accel = 9.8 + std::sin(0.03 * i);
+
+            const double side_accels[4] = {std::max(-x_accel, 0.0),
+                                           std::max(x_accel, 0.0),
+                                           std::max(-y_accel, 0.0),
+                                           std::max(y_accel, 0.0)};
+            double side_voltages[4];
+            thrust_model_side.voltagesFromThrusts(side_accels,
+                                                  1,
+                                                  0.5,
+                                                  side_start_thrusts,
+                                                  side_voltages,
+                                                  4);
+            for (double side_voltage : side_voltages) {
+                throttle_sum += side_voltage;
+            }
+            throttle_sum += thrust_model.voltageFromThrust(z_accel, 4, 0.5);
+        }
+        EXPECT_EQ(allocations.count(), 0u);
+        EXPECT_TRUE(std::isfinite(throttle_sum));
+    }
+
+    // Runs num_motors motors at height through a batched model and through
+    // one model copy per motor, and checks they command the same voltages
+    void checkBatchMatchesCopies(const ThrustModel& model,
+                                 int num_motors,
+                                 double height = 0.0)
+    {
+        std::vector<ThrustModel> copies(num_motors, model);
+        std::vector<double> start_thrusts(num_motors, 0.0);
+        std::vector<double> accelerations(num_motors);
+        std::vector<double> voltages(num_motors);
+
+        for (int i = 0; i < 500; i++) {
+            for (int k = 0; k < num_motors; k++) {
+                // Mix of small and large steps, including zero thrust
+                accelerations[k] = std::max(
+                        8.0 * std::sin(0.05 * i + k) + 3.0 * std::sin(0.7 * i * k),
+                        0.0);
+            }
+
+            model.voltagesFromThrusts(accelerations.data(),
+                                      1,
+                                      height,
+                                      start_thrusts.data(),
+                                      voltages.data(),
+                                      num_motors);
+
+            for (int k = 0; k < num_motors; k++) {
+                ASSERT_NEAR(voltages[k],
+                            copies[k].voltageFromThrust(accelerations[k], 1, height),
+                            1e-9) << "motor " << k << " step " << i;
+            }
+        }
+    }
+
+    TEST(ThrustModelTests, testBatchedVoltagesMatchPerMotorModels)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+
+        ThrustModel scan_model;
+        scan_model.loadModel(params, 2.9);
+
+        ThrustModel table_model = scan_model;
+        table_model.buildLookupTable(64, 256);
+
+        // Quad side motors, a hex, and more motors than one batch holds
+        for (int num_motors : {4, 6, 11}) {
+            checkBatchMatchesCopies(scan_model, num_motors);
+            checkBatchMatchesCopies(table_model, num_motors);
+        }
+    }
+
+    TEST(ThrustModelTests, testCopiesShareTablesAndKeepOwnState)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+        ThrustModel thrust_model;
+        thrust_model.loadModel(params, 2.9);
+        thrust_model.buildLookupTable(64, 256);
+
+        AllocationCounter allocations;
+        ThrustModel copy(thrust_model);
+        EXPECT_EQ(allocations.count(), 0u);
+        EXPECT_EQ(copy.getData(), thrust_model.getData());
+
+        // Driving one copy must not move the other's start thrust
+        ThrustModel reference(thrust_model);
+        copy.voltageFromThrust(4.0, 4, 0.0);
+        EXPECT_EQ(thrust_model.voltageFromThrust(12.0, 4, 0.0),
+                  reference.voltageFromThrust(12.0, 4, 0.0));
+    }
+
+    TEST(ThrustModelTests, testSetDataKeepsStartThrust)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+        ThrustModel scan_model;
+        scan_model.loadModel(params, 2.9);
+        ThrustModel table_model(scan_model);
+        table_model.buildLookupTable(64, 256);
+
+        // Swap tables under a running model, the next step must be taken
+        // from where the motor already was
+        ThrustModel thrust_model(scan_model);
+        thrust_model.voltageFromThrust(4.0, 4, 0.0);
+        thrust_model.setData(table_model.getData());
+
+        table_model.voltageFromThrust(4.0, 4, 0.0);
+        EXPECT_EQ(thrust_model.voltageFromThrust(12.0, 4, 0.0),
+                  table_model.voltageFromThrust(12.0, 4, 0.0));
+    }
+
+    TEST(ThrustModelTests, testBinaryModelFileRoundTrip)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+        ThrustModel yaml_model;
+        yaml_model.loadModel(params, 2.9);
+
+        const TempFile temp_file;
+        const std::string& path = temp_file.path();
+        ASSERT_FALSE(path.empty());
+        ThrustModelFile::Contents contents = yaml_model.getContents();
+        contents.source_checksum = 0x0123456789abcdefULL;
+        ASSERT_TRUE(ThrustModelFile::write(path, contents));
+
+        ThrustModelFile::MappedFile file;
+        ASSERT_TRUE(file.open(path));
+        EXPECT_EQ(file.contents().source_checksum, contents.source_checksum);
+        ThrustModel file_model;
+        file_model.loadModel(file.contents(), 2.9);
+        file.close();
+
+        const double accelerations[] = {9.8, 9.81, 12.0, 4.0, 0.0, 30.0, 9.8};
+        for (double acceleration : accelerations) {
+            EXPECT_EQ(yaml_model.voltageFromThrust(acceleration, 4, 0.0),
+                      file_model.voltageFromThrust(acceleration, 4, 0.0));
+        }
+    }
+
+    TEST(ThrustModelTests, testCorruptBinaryModelFileIsRejected)
+    {
+        XmlRpc::XmlRpcValue params = makeModelParams();
+        ThrustModel model;
+        model.loadModel(params, 2.9);
+
+        const TempFile temp_file;
+        const std::string& path = temp_file.path();
+        ASSERT_FALSE(path.empty());
+        ASSERT_TRUE(ThrustModelFile::write(path, model.getContents()));
+
+        // Flip the bits of one byte of the last end thrust
+        std::fstream stream(path, std::ios::in | std::ios::out | std::ios::binary);
+        stream.seekg(-1, std::ios::end);
+        char last_byte = stream.get();
+        stream.seekp(-1, std::ios::end);
+        stream.put(~last_byte);
+        stream.close();
+
+        ThrustModelFile::MappedFile file;
+        EXPECT_FALSE(file.open(path));
+    }
+
+    TEST(ThrustModelTests, testSourceChecksum)
+    {
+        const TempFile temp_file;
+        const std::string& path = temp_file.path();
+        ASSERT_FALSE(path.empty());
+
+        // Longer than one read buffer
+        const std::string source(10000, 'a');
+        {
+            std::ofstream stream(path);
+            stream << source;
+        }
+        uint64_t checksum;
+        ASSERT_TRUE(ThrustModelFile::sourceChecksum(path, checksum));
+        uint64_t same_checksum;
+        ASSERT_TRUE(ThrustModelFile::sourceChecksum(path, same_checksum));
+        EXPECT_EQ(checksum, same_checksum);
+
+        // Any edit changes it
+        {
+            std::ofstream stream(path);
+            stream << source.substr(0, 5000) << 'b' << source.substr(5001);
+        }
+        uint64_t edited_checksum;
+        ASSERT_TRUE(ThrustModelFile::sourceChecksum(path, edited_checksum));
+        EXPECT_NE(checksum, edited_checksum);
+
+        EXPECT_FALSE(ThrustModelFile::sourceChecksum(path + ".missing", checksum));
+    }
+
+    const double kTestModelMass = 2.85;
+
+    // Runtime loaded model scanning the mapping, the default without a
+    // lookup table
+    struct RuntimeScanThrustModel : public ThrustModel
+    {
+        RuntimeScanThrustModel() {
+            loadModel(StaticThrustModel<TestThrustModelData>::getContents(),
+                      kTestModelMass);
+        }
+    };
+
+    struct CompiledThrustModel : public StaticThrustModel<TestThrustModelData>
+    {
+        CompiledThrustModel() {
+            loadModel(kTestModelMass);
+        }
+    };
+
+    // Thrust reached from start_thrust when voltage is applied, found by
+    // interpolating the mapping in the forward direction
+    double endThrust(const ThrustModelFile::Contents& model,
+                     double start_thrust,
+                     double voltage)
+    {
+        const int cols = model.num_voltage_points;
+        double increment = (model.thrust_max - model.thrust_min)
+                         / (model.num_thrust_points - 1);
+        int row = std::min(std::max(static_cast<int>(std::floor(start_thrust / increment)), 0),
+                           model.num_thrust_points - 2);
+        double fraction = (start_thrust - model.start_thrusts[row])
+                        / (model.start_thrusts[row+1] - model.start_thrusts[row]);
+
+        int col = 0;
+        while (col < cols - 2 && model.voltages[col+1] < voltage) {
+            col++;
+        }
+        double voltage_fraction = (voltage - model.voltages[col])
+                                / (model.voltages[col+1] - model.voltages[col]);
+
+        auto row_thrust = [&](int i) {
+            const double* thrusts = &model.end_thrusts[i * cols];
+            return thrusts[col] + voltage_fraction * (thrusts[col+1] - thrusts[col]);
+        };
+        return row_thrust(row) + fraction * (row_thrust(row+1) - row_thrust(row));
+    }
+
+    // Accuracy tests every thrust model implementation has to pass
+    template <class Model>
+    class ThrustModelAccuracyTests : public ::testing::Test
+    {
+    };
+
+    typedef ::testing::Types<RuntimeScanThrustModel, CompiledThrustModel> ThrustModelTypes;
+    TYPED_TEST_CASE(ThrustModelAccuracyTests, ThrustModelTypes);
+
+    TYPED_TEST(ThrustModelAccuracyTests, testDynamicVoltageReachesDesiredThrust)
+    {
+        const ThrustModelFile::Contents contents
+            = StaticThrustModel<TestThrustModelData>::getContents();
+        const double thrust_per_accel = kTestModelMass / 9.81 / 4.0;
+
+        for (double start_accel = 2.0; start_accel < 12.0; start_accel += 0.37) {
+            for (double desired_accel = 1.0; desired_accel < 14.0; desired_accel += 0.29) {
+                double start_thrust = start_accel * thrust_per_accel;
+                double desired_thrust = desired_accel * thrust_per_accel;
+                if (std::abs(desired_thrust - start_thrust)
+                        < contents.small_thrust_epsilon) {
+                    continue;
+                }
+
+                TypeParam model;
+                model.voltageFromThrust(start_accel, 4, 0.0);
+                double voltage = model.voltageFromThrust(desired_accel, 4, 0.0);
+
+                ASSERT_GE(voltage, contents.voltage_min);
+                ASSERT_LE(voltage, contents.voltage_max);
+                if (voltage > contents.voltage_min && voltage < contents.voltage_max) {
+                    EXPECT_NEAR(endThrust(contents, start_thrust, voltage),
+                                desired_thrust,
+                                1e-9)
+                        << "from start thrust " << start_thrust;
+                } else if (voltage == contents.voltage_min) {
+                    EXPECT_GE(endThrust(contents, start_thrust, voltage),
+                              desired_thrust - 1e-9);
+                } else {
+                    EXPECT_LE(endThrust(contents, start_thrust, voltage),
+                              desired_thrust + 1e-9);
+                }
+            }
+        }
+    }
+
+    TYPED_TEST(ThrustModelAccuracyTests, testSteadyStateVoltageMatchesPolynomial)
+    {
+        const ThrustModelFile::Contents contents
+            = StaticThrustModel<TestThrustModelData>::getContents();
+        const double thrust_per_accel = kTestModelMass / 9.81 / 4.0;
+
+        TypeParam model;
+        for (double accel = 2.0; accel < 12.0; accel += 0.01) {
+            double voltage = model.voltageFromThrust(accel, 4, 0.0);
+            if (std::abs(accel - 2.0) < 1e-12) {
+                continue;
+            }
+
+            double thrust = accel * thrust_per_accel;
+            double expected = 0.0;
+            for (int i = 0; i < contents.num_coefficients; i++) {
+                expected += contents.thrust_to_voltage[i]
+                          * std::pow(thrust, contents.num_coefficients - 1 - i);
+            }
+            EXPECT_NEAR(voltage, expected, 1e-9);
+        }
+    }
+
+    TYPED_TEST(ThrustModelAccuracyTests, testVoltageFromThrustDoesNotAllocate)
+    {
+        TypeParam model;
+
+        AllocationCounter allocations;
+        double voltage_sum = 0.0;
+        for (int i = 0; i < 1000; i++) {
+            voltage_sum += model.voltageFromThrust(9.8 + 4.0 * std::sin(0.1 * i), 4, 0.0);
+        }
+        EXPECT_EQ(allocations.count(), 0u);
+        EXPECT_TRUE(std::isfinite(voltage_sum));
+    }
+
+    TEST(ThrustModelTests, testPredictThrustMatchesForwardInterpolation)
+    {
+        RuntimeScanThrustModel model;
+        const ThrustModelFile::Contents contents = model.getContents();
+        const double start_max = contents.start_thrusts[contents.num_thrust_points - 1];
+        const double voltage_min = contents.voltages[0];
+        const double voltage_max = contents.voltages[contents.num_voltage_points - 1];
+
+        for (double start_thrust = 0.0; start_thrust <= start_max; start_thrust += 0.013) {
+            for (double voltage = voltage_min; voltage <= voltage_max; voltage += 0.047) {
+                EXPECT_NEAR(model.predictThrust(start_thrust, voltage),
+                            endThrust(contents, start_thrust, voltage),
+                            1e-9);
+            }
+
+            // Voltages past the mapping are clamped to its edges
+            EXPECT_EQ(model.predictThrust(start_thrust, voltage_max + 1.0),
+                      model.predictThrust(start_thrust, voltage_max));
+            EXPECT_EQ(model.predictThrust(start_thrust, voltage_min - 1.0),
+                      model.predictThrust(start_thrust, voltage_min));
+        }
+    }
+
+    TEST(ThrustModelTests, testCompiledModelMatchesRuntimeModel)
+    {
+        RuntimeScanThrustModel runtime_model;
+        CompiledThrustModel compiled_model;
+
+        for (int i = 0; i < 5000; i++) {
+            double accel = 9.8 + 6.0 * std::sin(0.07 * i) + 3.0 * std::sin(0.31 * i);
+            EXPECT_NEAR(runtime_model.voltageFromThrust(accel, 4, 0.0),
+                        compiled_model.voltageFromThrust(accel, 4, 0.0),
+                        1e-9);
+        }
+    }
+
+    // The 1.9 model with ground effect added, thrust is 30% higher at the
+    // lowest height and gone by the highest
+    struct GroundEffectTestThrustModelData : public TestThrustModelData
+    {
+        static constexpr int num_height_points = 3;
+        static constexpr double height_min = 0.1;
+        static constexpr double height_max = 0.5;
+
+        static constexpr std::array<double, 3> thrust_ratios()
+        {
+            return {{1.3, 1.1, 1.0}};
+        }
+    };
+
+    TEST(ThrustModelTests, testGroundEffectRatioInterpolation)
+    {
+        ThrustModel model;
+        model.loadModel(StaticThrustModel<GroundEffectTestThrustModelData>::getContents(),
+                        kTestModelMass);
+        typedef StaticThrustModel<GroundEffectTestThrustModelData> Compiled;
+
+        const double heights[] = {-1.0, 0.0, 0.1, 0.2, 0.3, 0.4, 0.5, 2.0};
+        const double ratios[] = {1.3, 1.3, 1.3, 1.2, 1.1, 1.05, 1.0, 1.0};
+        for (int i = 0; i < 8; i++) {
+            EXPECT_NEAR(model.groundEffectRatio(heights[i]), ratios[i], 1e-12)
+                << "at height " << heights[i];
+            EXPECT_NEAR(Compiled::groundEffectRatio(heights[i]), ratios[i], 1e-12)
+                << "at height " << heights[i];
+        }
+
+        // Models without ground effect are unaffected by height
+        RuntimeScanThrustModel plain_model;
+        EXPECT_EQ(plain_model.groundEffectRatio(0.0), 1.0);
+        EXPECT_EQ(StaticThrustModel<TestThrustModelData>::groundEffectRatio(0.0), 1.0);
+    }
+
+    TEST(ThrustModelTests, testGroundEffectScalesThrust)
+    {
+        const ThrustModelFile::Contents contents
+            = StaticThrustModel<GroundEffectTestThrustModelData>::getContents();
+
+        ThrustModel loaded_scan_model;
+        loaded_scan_model.loadModel(contents, kTestModelMass);
+        ThrustModel loaded_table_model = loaded_scan_model;
+        loaded_table_model.buildLookupTable(64, 256);
+
+        // At a fixed height the model behaves like the same props far from
+        // the ground asked for the free air equivalent of each thrust
+        const double heights[] = {0.0, 0.15, 0.3, 0.45};
+        for (double height : heights) {
+            ThrustModel scan_model = loaded_scan_model;
+            ThrustModel table_model = loaded_table_model;
+            StaticThrustModel<GroundEffectTestThrustModelData> compiled_model;
+            compiled_model.loadModel(kTestModelMass);
+            ThrustModel free_air_scan_model = loaded_scan_model;
+            ThrustModel free_air_table_model = loaded_table_model;
+            double ratio = scan_model.groundEffectRatio(height);
+
+            // Steps stay well above small_thrust_epsilon, which is compared
+            // against the actual thrusts rather than the free air ones
+            for (int i = 0; i < 200; i++) {
+                double accel = 9.8 + (i % 2 ? 3.0 : -3.0) + std::sin(0.13 * i);
+
+                double scan_voltage = scan_model.voltageFromThrust(accel, 4, height);
+                EXPECT_NEAR(scan_voltage,
+                            free_air_scan_model.voltageFromThrust(accel / ratio, 4, 1.0),
+                            1e-9);
+                EXPECT_NEAR(table_model.voltageFromThrust(accel, 4, height),
+                            free_air_table_model.voltageFromThrust(accel / ratio, 4, 1.0),
+                            1e-9);
+                EXPECT_NEAR(compiled_model.voltageFromThrust(accel, 4, height),
+                            scan_voltage,
+                            1e-9);
+            }
+        }
+
+        // Holding the same thrust takes less voltage closer to the ground
+        ThrustModel model = loaded_scan_model;
+        model.voltageFromThrust(9.8, 4, 0.0);
+        double ground_voltage = model.voltageFromThrust(9.8, 4, 0.0);
+        double free_air_voltage = model.voltageFromThrust(9.8, 4, 1.0);
+        EXPECT_LT(ground_voltage, free_air_voltage);
+    }
+
+    TEST(ThrustModelTests, testBatchedVoltagesApplyGroundEffect)
+    {
+        const ThrustModelFile::Contents contents
+            = StaticThrustModel<GroundEffectTestThrustModelData>::getContents();
+
+        ThrustModel scan_model;
+        scan_model.loadModel(contents, kTestModelMass);
+        ThrustModel table_model = scan_model;
+        table_model.buildLookupTable(64, 256);
+
+        for (double height : {0.0, 0.15, 0.45}) {
+            checkBatchMatchesCopies(scan_model, 4, height);
+            checkBatchMatchesCopies(table_model, 4, height);
+        }
+    }
+
+    TEST(ThrustModelTests, testGroundEffectBinaryModelFileRoundTrip)
+    {
+        const ThrustModelFile::Contents contents
+            = StaticThrustModel<GroundEffectTestThrustModelData>::getContents();
+
+        const TempFile temp_file;
+        const std::string& path = temp_file.path();
+        ASSERT_FALSE(path.empty());
+        ASSERT_TRUE(ThrustModelFile::write(path, contents));
+
+        ThrustModelFile::MappedFile file;
+        ASSERT_TRUE(file.open(path));
+        const ThrustModelFile::Contents& read = file.contents();
+        ASSERT_EQ(read.num_height_points, 3);
+        EXPECT_EQ(read.height_min, 0.1);
+        EXPECT_EQ(read.height_max, 0.5);
+        for (int i = 0; i < 3; i++) {
+            EXPECT_EQ(read.thrust_ratios[i], contents.thrust_ratios[i]);
+        }
+
+        ThrustModel model;
+        model.loadModel(read, kTestModelMass);
+        file.close();
+
+        EXPECT_NEAR(model.groundEffectRatio(0.2), 1.2, 1e-12);
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,213 @@
+// Bring in my package's API, which is what I'm testing
+#include "iarc7_motion/VelocityProfileGenerator.hpp"
+
+// Bring in gtest
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+namespace Iarc7Motion
+{
+    const int64_t kStartNs = 1000000000000;
+    const int64_t kStepNs = 1000000;
+
+    TrajectorySample makeStart(const Eigen::Vector3d& position,
+                               const Eigen::Vector3d& velocity,
+                               const Eigen::Vector3d& accel)
+    {
+        TrajectorySample start;
+        start.vector().setZero();
+        start.stamp_ns = kStartNs;
+        Eigen::Map<Eigen::Vector3d>(start.values + TrajectorySample::kPositionX) = position;
+        Eigen::Map<Eigen::Vector3d>(start.values + TrajectorySample::kVelocityX) = velocity;
+        Eigen::Map<Eigen::Vector3d>(start.values + TrajectorySample::kAccelX) = accel;
+        return start;
+    }
+
+    Eigen::Vector3d axes(const TrajectorySample& sample, int first)
+    {
+        return Eigen::Vector3d(sample.values + first);
+    }
+
+    // Samples trajectory every ms from its start to its end and checks the
+    // targets are continuous and follow each other, the magnitudes of the
+    // acceleration and jerk stay within the limits, and the target velocity
+    // is held for hold_duration before the targets come to rest. Returns
+    // the time the target velocity is reached in seconds.
+    double checkProfile(const PolynomialTrajectory& trajectory,
+                        const TrajectorySample& start,
+                        const Eigen::Vector3d& target_velocity,
+                        double max_accel,
+                        double max_jerk,
+                        double hold_duration)
+    {
+        TrajectorySample last;
+        EXPECT_TRUE(trajectory.sample(trajectory.startNs(), last));
+        EXPECT_TRUE(axes(last, TrajectorySample::kPositionX)
+                        .isApprox(axes(start, TrajectorySample::kPositionX), 1e-12));
+        EXPECT_TRUE(axes(last, TrajectorySample::kVelocityX)
+                        .isApprox(axes(start, TrajectorySample::kVelocityX), 1e-12));
+
+        double reached = -1.0;
+        const double dt = kStepNs * 1e-9;
+        for (int64_t time_ns = trajectory.startNs() + kStepNs;
+             time_ns <= trajectory.endNs();
+             time_ns += kStepNs) {
+            TrajectorySample sample;
+            EXPECT_TRUE(trajectory.sample(time_ns, sample));
+
+            const Eigen::Vector3d accel = axes(sample, TrajectorySample::kAccelX);
+            const Eigen::Vector3d last_accel = axes(last, TrajectorySample::kAccelX);
+            const Eigen::Vector3d velocity = axes(sample, TrajectorySample::kVelocityX);
+            const Eigen::Vector3d last_velocity = axes(last, TrajectorySample::kVelocityX);
+
+            EXPECT_LE(accel.norm(), max_accel + 1e-9);
+            EXPECT_LE(((accel - last_accel) / dt).norm(), max_jerk + 1e-6);
+            // Trapezoid rule steps, exact up to the jerk changing within
+            // the step
+            EXPECT_LT((velocity - last_velocity - 0.5 * dt * (accel + last_accel)).norm(),
+                      max_jerk * dt * dt);
+            EXPECT_LT((axes(sample, TrajectorySample::kPositionX)
+                           - axes(last, TrajectorySample::kPositionX)
+                           - 0.5 * dt * (velocity + last_velocity)).norm(),
+                      max_jerk * dt * dt * dt);
+
+            if (reached < 0.0 && (velocity - target_velocity).norm() < 1e-9) {
+                reached = (time_ns - trajectory.startNs()) * 1e-9;
+            }
+            last = sample;
+        }
+
+        // Holds the target velocity once it is reached
+        EXPECT_GE(reached, 0.0);
+        TrajectorySample held;
+        EXPECT_TRUE(trajectory.sample(
+                trajectory.startNs() + std::llround((reached + hold_duration - 2e-3) * 1e9),
+                held));
+        EXPECT_LT((axes(held, TrajectorySample::kVelocityX) - target_velocity).norm(), 1e-9);
+        EXPECT_LT(axes(held, TrajectorySample::kAccelX).norm(), 1e-9);
+
+        // Ends at rest, and the targets past the end agree with that
+        TrajectorySample end;
+        TrajectorySample after_end;
+        EXPECT_TRUE(trajectory.sample(trajectory.endNs(), end));
+        EXPECT_TRUE(trajectory.sample(trajectory.endNs() + 1000000000, after_end));
+        EXPECT_EQ(axes(end, TrajectorySample::kVelocityX).norm(), 0.0);
+        EXPECT_EQ(axes(end, TrajectorySample::kAccelX).norm(), 0.0);
+        EXPECT_EQ(axes(after_end, TrajectorySample::kPositionX),
+                  axes(end, TrajectorySample::kPositionX));
+        EXPECT_LT((axes(end, TrajectorySample::kPositionX)
+                       - axes(last, TrajectorySample::kPositionX)).norm(),
+                  1e-9);
+        return reached;
+    }
+
+    TEST(VelocityProfileGeneratorTests, testFromRest)
+    {
+        VelocityProfileSettings settings;
+        settings.acceleration = 1.0;
+        settings.jerk = 10.0;
+        VelocityProfileGenerator generator(settings);
+
+        const TrajectorySample start = makeStart(Eigen::Vector3d(1.0, 2.0, 1.5),
+                                                 Eigen::Vector3d::Zero(),
+                                                 Eigen::Vector3d::Zero());
+        const Eigen::Vector3d target(2.0, -1.0, 0.0);
+
+        PolynomialTrajectory trajectory;
+        ASSERT_TRUE(generator.generate(start, target, 0.0, 0.0, trajectory));
+        EXPECT_EQ(trajectory.startNs(), kStartNs);
+
+        // Fastest S-curve: the change at full acceleration plus one jerk
+        // ramp, then the target is held, then the same back to rest
+        const double expected = target.norm() / settings.acceleration
+                              + settings.acceleration / settings.jerk;
+        EXPECT_NEAR((trajectory.endNs() - kStartNs) * 1e-9,
+                    2.0 * expected + settings.hold_duration,
+                    1e-6);
+        const double reached = checkProfile(trajectory, start, target,
+                                            settings.acceleration, settings.jerk,
+                                            settings.hold_duration);
+        EXPECT_NEAR(reached, expected, 2e-3);
+
+        // The acceleration stays along the velocity change
+        TrajectorySample sample;
+        ASSERT_TRUE(trajectory.sample(kStartNs + 500000000, sample));
+        const Eigen::Vector3d accel = axes(sample, TrajectorySample::kAccelX);
+        EXPECT_NEAR(accel.normalized().dot(target.normalized()), 1.0, 1e-9);
+        EXPECT_NEAR(accel.norm(), settings.acceleration, 1e-9);
+    }
+
+    TEST(VelocityProfileGeneratorTests, testFromMoving)
+    {
+        const VelocityProfileSettings settings;
+        VelocityProfileGenerator generator(settings);
+
+        // Accelerating away from the target, and a small change that never
+        // reaches the acceleration limit
+        const TrajectorySample starts[2] = {
+            makeStart(Eigen::Vector3d::Zero(),
+                      Eigen::Vector3d(1.0, 0.0, 0.5),
+                      Eigen::Vector3d(0.5, 0.0, 0.2)),
+            makeStart(Eigen::Vector3d(0.0, 0.0, 1.0),
+                      Eigen::Vector3d(0.0, 0.05, 0.0),
+                      Eigen::Vector3d::Zero())
+        };
+        const Eigen::Vector3d targets[2] = {Eigen::Vector3d(-1.0, 0.0, 0.5),
+                                            Eigen::Vector3d(0.0, 0.0, 0.0)};
+
+        for (int i = 0; i < 2; i++) {
+            PolynomialTrajectory trajectory;
+            ASSERT_TRUE(generator.generate(starts[i], targets[i], 2.0, 20.0, trajectory));
+            // The z axis of the first only settles its acceleration, its
+            // share comes out of the others'
+            EXPECT_GE(checkProfile(trajectory, starts[i], targets[i],
+                                   2.0, 20.0, settings.hold_duration),
+                      0.0);
+        }
+    }
+
+    TEST(VelocityProfileGeneratorTests, testLimits)
+    {
+        VelocityProfileSettings settings;
+        settings.max_acceleration = 2.0;
+        settings.max_jerk = 20.0;
+        VelocityProfileGenerator generator(settings);
+
+        const TrajectorySample start = makeStart(Eigen::Vector3d::Zero(),
+                                                 Eigen::Vector3d::Zero(),
+                                                 Eigen::Vector3d::Zero());
+        const Eigen::Vector3d target(4.0, 0.0, 0.0);
+
+        // Requests above the maximum are clamped to it
+        PolynomialTrajectory trajectory;
+        ASSERT_TRUE(generator.generate(start, target, 10.0, 100.0, trajectory));
+        checkProfile(trajectory, start, target, 2.0, 20.0, settings.hold_duration);
+        EXPECT_NEAR((trajectory.endNs() - kStartNs) * 1e-9,
+                    2.0 * (4.0 / 2.0 + 2.0 / 20.0) + settings.hold_duration,
+                    1e-6);
+
+        // Already at rest at the target the velocity is just held
+        ASSERT_TRUE(generator.generate(start, Eigen::Vector3d::Zero(), 0.0, 0.0, trajectory));
+        EXPECT_EQ(trajectory.endNs() - kStartNs,
+                  std::llround(settings.hold_duration * 1e9));
+
+        // Invalid requests leave the trajectory empty
+        EXPECT_FALSE(generator.generate(start, target, -1.0, 0.0, trajectory));
+        EXPECT_TRUE(trajectory.empty());
+        EXPECT_FALSE(generator.generate(
+            start,
+            Eigen::Vector3d(std::numeric_limits<double>::quiet_NaN(), 0.0, 0.0),
+            0.0,
+            0.0,
+            trajectory));
+        EXPECT_TRUE(trajectory.empty());
+    }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}